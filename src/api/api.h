@@ -34,6 +34,8 @@ extern const luaL_Reg lovrCollider[];
 extern const luaL_Reg lovrCurve[];
 extern const luaL_Reg lovrCylinderShape[];
 extern const luaL_Reg lovrDistanceJoint[];
+extern const luaL_Reg lovrDrawList[];
+extern const luaL_Reg lovrDrawListThread[];
 extern const luaL_Reg lovrFont[];
 extern const luaL_Reg lovrHingeJoint[];
 extern const luaL_Reg lovrMat4[];
@@ -45,6 +47,7 @@ extern const luaL_Reg lovrModelData[];
 extern const luaL_Reg lovrQuat[];
 extern const luaL_Reg lovrRandomGenerator[];
 extern const luaL_Reg lovrRasterizer[];
+extern const luaL_Reg lovrScene[];
 extern const luaL_Reg lovrShader[];
 extern const luaL_Reg lovrShaderBlock[];
 extern const luaL_Reg lovrSliderJoint[];
@@ -93,6 +96,7 @@ extern StringEntry ShaderTypes[];
 extern StringEntry ShapeTypes[];
 extern StringEntry SourceTypes[];
 extern StringEntry StencilActions[];
+extern StringEntry StereoModes[];
 extern StringEntry TextureFormats[];
 extern StringEntry TextureTypes[];
 extern StringEntry TimeUnits[];
@@ -114,6 +118,7 @@ typedef struct {
 
 #define luax_len(L, i) (int) lua_objlen(L, i)
 #define luax_registertype(L, T) _luax_registertype(L, #T, lovr ## T, lovr ## T ## Destroy)
+#define luax_registertypeas(L, T, functions) _luax_registertype(L, #T, functions, lovr ## T ## Destroy)
 #define luax_totype(L, i, T) (T*) _luax_totype(L, i, hash64(#T, strlen(#T)))
 #define luax_checktype(L, i, T) (T*) _luax_checktype(L, i, hash64(#T, strlen(#T)), #T)
 #define luax_pushtype(L, T, o) _luax_pushtype(L, #T, hash64(#T, strlen(#T)), o)
@@ -158,11 +163,13 @@ void* luax_readfile(const char* filename, size_t* bytesRead);
 
 #ifdef LOVR_ENABLE_GRAPHICS
 struct Attachment;
+struct Model;
 struct Texture;
 struct Uniform;
 int luax_checkuniform(lua_State* L, int index, const struct Uniform* uniform, void* dest, const char* debug);
 int luax_optmipmap(lua_State* L, int index, struct Texture* texture);
 void luax_readattachments(lua_State* L, int index, struct Attachment* attachments, int* count);
+uint32_t luax_checkanimation(lua_State* L, int index, struct Model* model);
 #endif
 
 #ifdef LOVR_ENABLE_MATH
@@ -1,6 +1,14 @@
 #include "api.h"
 #include "data/modelData.h"
 
+static int l_lovrModelDataCompressAnimations(lua_State* L) {
+  ModelData* modelData = luax_checktype(L, 1, ModelData);
+  float tolerance = luax_optfloat(L, 2, .001f);
+  lovrModelDataCompressAnimations(modelData, tolerance);
+  return 0;
+}
+
 const luaL_Reg lovrModelData[] = {
+  { "compressAnimations", l_lovrModelDataCompressAnimations },
   { NULL, NULL }
 };
@@ -2,9 +2,11 @@
 #include "graphics/graphics.h"
 #include "graphics/buffer.h"
 #include "graphics/canvas.h"
+#include "graphics/drawList.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
 #include "graphics/model.h"
+#include "graphics/scene.h"
 #include "graphics/shader.h"
 #include "data/blob.h"
 #include "data/modelData.h"
@@ -159,6 +161,14 @@ StringEntry StencilActions[] = {
   { 0 }
 };
 
+StringEntry StereoModes[] = {
+  [STEREO_NONE] = ENTRY("none"),
+  [STEREO_INSTANCED] = ENTRY("instanced"),
+  [STEREO_MULTIVIEW] = ENTRY("multiview"),
+  [STEREO_AUTO] = ENTRY("auto"),
+  { 0 }
+};
+
 StringEntry TextureFormats[] = {
   [FORMAT_RGB] = ENTRY("rgb"),
   [FORMAT_RGBA] = ENTRY("rgba"),
@@ -298,7 +308,32 @@ static void stencilCallback(void* userdata) {
   lua_call(L, 0, 0);
 }
 
+// Calls the function on the top of the stack in protected mode and leaves the error (or nil) in its
+// place, so state set up around the callback can be restored before the error is rethrown
+static void protectedCallback(void* userdata) {
+  lua_State* L = userdata;
+  luaL_checktype(L, -1, LUA_TFUNCTION);
+  if (lua_pcall(L, 0, 0, 0) == 0) {
+    lua_pushnil(L);
+  }
+}
+
 // Must be released when done
+typedef struct {
+  uint32_t count;
+  TextureData* slices[];
+} TextureSlices;
+
+// Releases the TextureSlices userdata on the top of the stack (also used as its __gc)
+static int luax_releaseslices(lua_State* L) {
+  TextureSlices* slices = lua_touserdata(L, -1);
+  for (uint32_t i = 0; i < slices->count; i++) {
+    lovrRelease(TextureData, slices->slices[i]);
+  }
+  slices->count = 0;
+  return 0;
+}
+
 static TextureData* luax_checktexturedata(lua_State* L, int index, bool flip) {
   TextureData* textureData = luax_totype(L, index, TextureData);
 
@@ -369,7 +404,11 @@ static int l_lovrGraphicsCreateWindow(lua_State* L) {
   flags.vsync = lua_tointeger(L, -1);
   lua_pop(L, 1);
 
-  lovrGraphicsCreateWindow(&flags);
+  lua_getfield(L, 1, "stereo");
+  StereoMode stereo = luax_checkenum(L, -1, StereoModes, "auto", "StereoMode");
+  lua_pop(L, 1);
+
+  lovrGraphicsCreateWindow(&flags, stereo);
   luax_atexit(L, lovrGraphicsDestroy); // The lua_State that creates the window shall be the one to destroy it
   lovrRelease(TextureData, textureData);
   return 0;
@@ -424,15 +463,24 @@ static int l_lovrGraphicsGetFeatures(lua_State* L) {
   lua_setfield(L, -2, "compute");
   lua_pushboolean(L, features->dxt);
   lua_setfield(L, -2, "dxt");
+  lua_pushboolean(L, features->indirect);
+  lua_setfield(L, -2, "indirect");
   lua_pushboolean(L, features->instancedStereo);
   lua_setfield(L, -2, "instancedstereo");
   lua_pushboolean(L, features->multiview);
   lua_setfield(L, -2, "multiview");
+  lua_pushboolean(L, features->parallelCompile);
+  lua_setfield(L, -2, "parallelcompile");
   lua_pushboolean(L, features->timers);
   lua_setfield(L, -2, "timers");
   return 1;
 }
 
+static int l_lovrGraphicsGetStereoMode(lua_State* L) {
+  luax_pushenum(L, StereoModes, lovrGraphicsGetStereoMode());
+  return 1;
+}
+
 static int l_lovrGraphicsGetLimits(lua_State* L) {
   const GpuLimits* limits = lovrGraphicsGetLimits();
   lua_newtable(L);
@@ -454,7 +502,7 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
     luaL_checktype(L, 1, LUA_TTABLE);
     lua_settop(L, 1);
   } else {
-    lua_createtable(L, 0, 7);
+    lua_createtable(L, 0, 16);
   }
 
   lovrGraphicsFlush();
@@ -473,6 +521,24 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
   lua_setfield(L, 1, "buffermemory");
   lua_pushinteger(L, stats->textureMemory);
   lua_setfield(L, 1, "texturememory");
+  lua_pushinteger(L, stats->streamWraps);
+  lua_setfield(L, 1, "streamwraps");
+  lua_pushinteger(L, stats->streamStalls);
+  lua_setfield(L, 1, "streamstalls");
+  lua_pushinteger(L, stats->streamMemory);
+  lua_setfield(L, 1, "streammemory");
+  lua_pushinteger(L, stats->culledDraws);
+  lua_setfield(L, 1, "culleddraws");
+  lua_pushinteger(L, stats->pipelineChanges);
+  lua_setfield(L, 1, "pipelinechanges");
+  lua_pushinteger(L, stats->bufferBinds);
+  lua_setfield(L, 1, "bufferbinds");
+  lua_pushinteger(L, stats->textureBinds);
+  lua_setfield(L, 1, "texturebinds");
+  lua_pushinteger(L, stats->uniformUploads);
+  lua_setfield(L, 1, "uniformuploads");
+  lua_pushinteger(L, stats->bytesStreamed);
+  lua_setfield(L, 1, "bytesstreamed");
   return 1;
 }
 
@@ -624,6 +690,16 @@ static int l_lovrGraphicsSetFont(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsIsFrustumCullingEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsFrustumCullingEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetFrustumCullingEnabled(lua_State* L) {
+  lovrGraphicsSetFrustumCullingEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
 static int l_lovrGraphicsGetLineWidth(lua_State* L) {
   lua_pushnumber(L, lovrGraphicsGetLineWidth());
   return 1;
@@ -658,6 +734,16 @@ static int l_lovrGraphicsSetShader(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsIsSortingEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsSortingEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetSortingEnabled(lua_State* L) {
+  lovrGraphicsSetSortingEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
 static int l_lovrGraphicsGetStencilTest(lua_State* L) {
   CompareMode mode;
   int value;
@@ -984,6 +1070,80 @@ static int l_lovrGraphicsStencil(lua_State* L) {
   return 0;
 }
 
+// Proxy geometry only needs to be depth tested, so color and depth writes are turned off for it
+static int l_lovrGraphicsOcclude(lua_State* L) {
+  const char* label = luaL_checkstring(L, 1);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 2);
+  bool r, g, b, a, depthWrite;
+  CompareMode depthTest;
+  lovrGraphicsGetColorMask(&r, &g, &b, &a);
+  lovrGraphicsGetDepthTest(&depthTest, &depthWrite);
+  lovrGraphicsSetColorMask(false, false, false, false);
+  lovrGraphicsSetDepthTest(depthTest, false);
+  bool visible = lovrGraphicsOcclude(label, protectedCallback, L);
+  lovrGraphicsSetColorMask(r, g, b, a);
+  lovrGraphicsSetDepthTest(depthTest, depthWrite);
+  if (!lua_isnil(L, -1)) {
+    return lua_error(L);
+  }
+  lua_pushboolean(L, visible);
+  return 1;
+}
+
+static int l_lovrGraphicsConditional(lua_State* L) {
+  const char* label = luaL_checkstring(L, 1);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_settop(L, 2);
+  lovrGraphicsConditional(label, protectedCallback, L);
+
+  // The function is still on the stack if the draws were skipped
+  if (!lua_isnil(L, 2) && !lua_isfunction(L, 2)) {
+    return lua_error(L);
+  }
+  return 0;
+}
+
+// Takes a list of tables, each holding a Model followed by (animation, time, weight) triples
+static int l_lovrGraphicsAnimate(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  uint32_t count = luax_len(L, 1);
+  ModelAnimationJob* jobs = lua_newuserdata(L, count * sizeof(ModelAnimationJob));
+
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    lovrAssert(lua_istable(L, -1), "Expected a table for each Model to animate");
+    int index = lua_gettop(L);
+    uint32_t length = luax_len(L, index);
+    ModelAnimationJob* job = &jobs[i];
+
+    lua_rawgeti(L, index, 1);
+    job->model = luax_checktype(L, -1, Model);
+    lua_pop(L, 1);
+
+    job->animationCount = (length - 1) / 3;
+    lovrAssert(job->animationCount <= MAX_BLEND_ANIMATIONS, "Too many animations to blend (max is %d)", MAX_BLEND_ANIMATIONS);
+    for (uint32_t j = 0; j < job->animationCount; j++) {
+      lua_rawgeti(L, index, 2 + 3 * j);
+      lua_rawgeti(L, index, 3 + 3 * j);
+      lua_rawgeti(L, index, 4 + 3 * j);
+      job->animations[j] = luax_checkanimation(L, -3, job->model);
+      job->times[j] = luax_checkfloat(L, -2);
+      job->weights[j] = luax_checkfloat(L, -1);
+      lua_pop(L, 3);
+    }
+
+    for (uint32_t j = 0; j < i; j++) {
+      lovrAssert(jobs[j].model != job->model, "A Model can only be animated once per call");
+    }
+
+    lua_pop(L, 1);
+  }
+
+  lovrModelAnimateMany(jobs, count);
+  return 0;
+}
+
 static int l_lovrGraphicsFill(lua_State* L) {
   Texture* texture = lua_isnoneornil(L, 1) ? NULL : luax_checktype(L, 1, Texture);
   float u = luax_optfloat(L, 2, 0.f);
@@ -1003,6 +1163,54 @@ static int l_lovrGraphicsCompute(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsBeginCapture(lua_State* L) {
+  lovrGraphicsBeginCapture();
+  return 0;
+}
+
+static int l_lovrGraphicsEndCapture(lua_State* L) {
+  Mesh* mesh = lovrGraphicsEndCapture();
+  luax_pushtype(L, Mesh, mesh);
+  lovrRelease(Mesh, mesh);
+  return 1;
+}
+
+static int l_lovrGraphicsStartRecording(lua_State* L) {
+  lovrGraphicsStartRecording();
+  return 0;
+}
+
+static int l_lovrGraphicsStopRecording(lua_State* L) {
+  size_t size;
+  void* data = lovrGraphicsStopRecording(&size);
+  Blob* blob = lovrBlobCreate(data, size, "Recording");
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(Blob, blob);
+  return 1;
+}
+
+static int l_lovrGraphicsReplay(lua_State* L) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  ReplayStats stats;
+  lovrGraphicsReplay(blob->data, blob->size, &stats);
+  lua_createtable(L, 0, 7);
+  lua_pushinteger(L, stats.frames);
+  lua_setfield(L, -2, "frames");
+  lua_pushinteger(L, stats.requests);
+  lua_setfield(L, -2, "requests");
+  lua_pushinteger(L, stats.batches);
+  lua_setfield(L, -2, "batches");
+  lua_pushinteger(L, stats.draws);
+  lua_setfield(L, -2, "draws");
+  lua_pushinteger(L, stats.recordedDraws);
+  lua_setfield(L, -2, "recordeddraws");
+  lua_pushnumber(L, (double) stats.bytes);
+  lua_setfield(L, -2, "bytes");
+  lua_pushnumber(L, stats.time);
+  lua_setfield(L, -2, "time");
+  return 1;
+}
+
 // Types
 
 static void luax_checkuniformtype(lua_State* L, int index, UniformType* baseType, int* components) {
@@ -1113,7 +1321,7 @@ static int l_lovrGraphicsNewCanvas(lua_State* L) {
   Canvas* canvas = lovrCanvasCreate(width, height, flags);
 
   if (anonymous) {
-    bool multiview = flags.stereo && lovrGraphicsGetFeatures()->multiview;
+    bool multiview = flags.stereo && lovrGraphicsGetStereoMode() == STEREO_MULTIVIEW;
     TextureType textureType = multiview ? TEXTURE_ARRAY : TEXTURE_2D;
     uint32_t depth = multiview ? 2 : 1;
     Texture* texture = lovrTextureCreate(textureType, NULL, 0, true, flags.mipmaps, flags.msaa);
@@ -1135,6 +1343,13 @@ static int l_lovrGraphicsNewCanvas(lua_State* L) {
   return 1;
 }
 
+static int l_lovrGraphicsNewDrawList(lua_State* L) {
+  DrawList* list = lovrDrawListCreate();
+  luax_pushtype(L, DrawList, list);
+  lovrRelease(DrawList, list);
+  return 1;
+}
+
 static int l_lovrGraphicsNewFont(lua_State* L) {
   Rasterizer* rasterizer = luax_totype(L, 1, Rasterizer);
 
@@ -1283,14 +1498,6 @@ static int l_lovrGraphicsNewMesh(lua_State* L) {
     });
   }
 
-  lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) {
-    .buffer = lovrGraphicsGetIdentityBuffer(),
-    .type = U8,
-    .components = 1,
-    .divisor = 1,
-    .integer = true
-  });
-
   if (dataIndex) {
     AttributeData data = { .raw = lovrBufferMap(vertexBuffer, 0) };
 
@@ -1344,13 +1551,29 @@ static int l_lovrGraphicsNewModel(lua_State* L) {
     lovrRetain(modelData);
   }
 
-  Model* model = lovrModelCreate(modelData);
+  bool atlas = false;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "atlas");
+    atlas = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  Model* model = lovrModelCreate(modelData, atlas);
   luax_pushtype(L, Model, model);
   lovrRelease(ModelData, modelData);
   lovrRelease(Model, model);
   return 1;
 }
 
+static int l_lovrGraphicsNewScene(lua_State* L) {
+  Mesh* mesh = luax_checktype(L, 1, Mesh);
+  uint32_t capacity = luaL_checkinteger(L, 2);
+  Scene* scene = lovrSceneCreate(mesh, capacity);
+  luax_pushtype(L, Scene, scene);
+  lovrRelease(Scene, scene);
+  return 1;
+}
+
 static const char* luax_checkshadersource(lua_State* L, int index, int *outLength) {
   if (lua_isnoneornil(L, index)) {
     return NULL;
@@ -1574,6 +1797,7 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
   bool mipmaps = true;
   TextureFormat format = FORMAT_RGBA;
   int msaa = 0;
+  bool stream = false;
 
   if (hasFlags) {
     lua_getfield(L, index, "linear");
@@ -1595,6 +1819,10 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
     lua_getfield(L, index, "msaa");
     msaa = lua_isnil(L, -1) ? msaa : luaL_checkinteger(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, index, "stream");
+    stream = lua_toboolean(L, -1);
+    lua_pop(L, 1);
   }
 
   Texture* texture = lovrTextureCreate(type, NULL, 0, srgb, mipmaps, msaa);
@@ -1615,14 +1843,35 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
       }
     }
 
+    // The slices are held by a userdata so they get released if loading one of them throws
+    TextureSlices* slices = NULL;
+    if (stream) {
+      slices = lua_newuserdata(L, sizeof(TextureSlices) + depth * sizeof(TextureData*));
+      slices->count = 0;
+      lua_newtable(L);
+      lua_pushcfunction(L, luax_releaseslices);
+      lua_setfield(L, -2, "__gc");
+      lua_setmetatable(L, -2);
+    }
+
     for (int i = 0; i < depth; i++) {
       lua_rawgeti(L, 1, i + 1);
       TextureData* textureData = luax_checktexturedata(L, -1, type != TEXTURE_CUBE);
       if (i == 0) {
         lovrTextureAllocate(texture, textureData->width, textureData->height, depth, textureData->format);
       }
-      lovrTextureReplacePixels(texture, textureData, 0, 0, i, 0);
-      lovrRelease(TextureData, textureData);
+      if (stream) {
+        slices->slices[slices->count++] = textureData;
+      } else {
+        lovrTextureReplacePixels(texture, textureData, 0, 0, i, 0);
+        lovrRelease(TextureData, textureData);
+      }
+      lua_pop(L, 1);
+    }
+
+    if (stream) {
+      lovrTextureStream(texture, slices->slices, depth);
+      luax_releaseslices(L);
       lua_pop(L, 1);
     }
   }
@@ -1646,6 +1895,7 @@ static const luaL_Reg lovrGraphics[] = {
   { "tock", l_lovrGraphicsTock },
   { "getFeatures", l_lovrGraphicsGetFeatures },
   { "getLimits", l_lovrGraphicsGetLimits },
+  { "getStereoMode", l_lovrGraphicsGetStereoMode },
   { "getStats", l_lovrGraphicsGetStats },
 
   // State
@@ -1670,12 +1920,16 @@ static const luaL_Reg lovrGraphics[] = {
   { "setDepthTest", l_lovrGraphicsSetDepthTest },
   { "getFont", l_lovrGraphicsGetFont },
   { "setFont", l_lovrGraphicsSetFont },
+  { "isFrustumCullingEnabled", l_lovrGraphicsIsFrustumCullingEnabled },
+  { "setFrustumCullingEnabled", l_lovrGraphicsSetFrustumCullingEnabled },
   { "getLineWidth", l_lovrGraphicsGetLineWidth },
   { "setLineWidth", l_lovrGraphicsSetLineWidth },
   { "getPointSize", l_lovrGraphicsGetPointSize },
   { "setPointSize", l_lovrGraphicsSetPointSize },
   { "getShader", l_lovrGraphicsGetShader },
   { "setShader", l_lovrGraphicsSetShader },
+  { "isSortingEnabled", l_lovrGraphicsIsSortingEnabled },
+  { "setSortingEnabled", l_lovrGraphicsSetSortingEnabled },
   { "getStencilTest", l_lovrGraphicsGetStencilTest },
   { "setStencilTest", l_lovrGraphicsSetStencilTest },
   { "getWinding", l_lovrGraphicsGetWinding },
@@ -1710,15 +1964,25 @@ static const luaL_Reg lovrGraphics[] = {
   { "skybox", l_lovrGraphicsSkybox },
   { "print", l_lovrGraphicsPrint },
   { "stencil", l_lovrGraphicsStencil },
+  { "occlude", l_lovrGraphicsOcclude },
+  { "conditional", l_lovrGraphicsConditional },
+  { "animate", l_lovrGraphicsAnimate },
   { "fill", l_lovrGraphicsFill },
   { "compute", l_lovrGraphicsCompute },
+  { "beginCapture", l_lovrGraphicsBeginCapture },
+  { "endCapture", l_lovrGraphicsEndCapture },
+  { "startRecording", l_lovrGraphicsStartRecording },
+  { "stopRecording", l_lovrGraphicsStopRecording },
+  { "replay", l_lovrGraphicsReplay },
 
   // Types
   { "newCanvas", l_lovrGraphicsNewCanvas },
+  { "newDrawList", l_lovrGraphicsNewDrawList },
   { "newFont", l_lovrGraphicsNewFont },
   { "newMaterial", l_lovrGraphicsNewMaterial },
   { "newMesh", l_lovrGraphicsNewMesh },
   { "newModel", l_lovrGraphicsNewModel },
+  { "newScene", l_lovrGraphicsNewScene },
   { "newShader", l_lovrGraphicsNewShader },
   { "newComputeShader", l_lovrGraphicsNewComputeShader },
   { "newShaderBlock", l_lovrGraphicsNewShaderBlock },
@@ -1727,23 +1991,53 @@ static const luaL_Reg lovrGraphics[] = {
   { NULL, NULL }
 };
 
+// Threads don't have a conf or a window, they only get what they need to record DrawLists
+static const luaL_Reg lovrGraphicsThread[] = {
+  { "newDrawList", l_lovrGraphicsNewDrawList },
+  { NULL, NULL }
+};
+
 int luaopen_lovr_graphics(lua_State* L) {
+  luax_pushconf(L);
+  bool main = lua_istable(L, -1);
+  lua_pop(L, 1);
+
   lua_newtable(L);
-  luaL_register(L, NULL, lovrGraphics);
-  luax_registertype(L, Canvas);
-  luax_registertype(L, Font);
-  luax_registertype(L, Material);
-  luax_registertype(L, Mesh);
-  luax_registertype(L, Model);
-  luax_registertype(L, Shader);
-  luax_registertype(L, ShaderBlock);
-  luax_registertype(L, Texture);
+  luaL_register(L, NULL, main ? lovrGraphics : lovrGraphicsThread);
+  if (main) {
+    luax_registertype(L, Canvas);
+    luax_registertype(L, DrawList);
+    luax_registertype(L, Font);
+    luax_registertype(L, Material);
+    luax_registertype(L, Mesh);
+    luax_registertype(L, Model);
+    luax_registertype(L, Scene);
+    luax_registertype(L, Shader);
+    luax_registertype(L, ShaderBlock);
+    luax_registertype(L, Texture);
+  } else {
+    // Objects still need their types on threads so they can come in over Channels and be drawn into
+    // DrawLists, but their methods could touch GL, so they don't get any
+    luax_registertypeas(L, Canvas, NULL);
+    luax_registertypeas(L, DrawList, lovrDrawListThread);
+    luax_registertypeas(L, Font, NULL);
+    luax_registertypeas(L, Material, NULL);
+    luax_registertypeas(L, Mesh, NULL);
+    luax_registertypeas(L, Model, NULL);
+    luax_registertypeas(L, Scene, NULL);
+    luax_registertypeas(L, Shader, NULL);
+    luax_registertypeas(L, ShaderBlock, NULL);
+    luax_registertypeas(L, Texture, NULL);
+  }
   lovrGraphicsInit();
 
-  luax_pushconf(L);
-  lua_pushcfunction(L, l_lovrGraphicsCreateWindow);
-  lua_getfield(L, -2, "window");
-  lua_call(L, 1, 0);
-  lua_pop(L, 1);
+  if (main) {
+    luax_pushconf(L);
+    lua_pushcfunction(L, l_lovrGraphicsCreateWindow);
+    lua_getfield(L, -2, "window");
+    lua_call(L, 1, 0);
+    lua_pop(L, 1);
+  }
+
   return 1;
 }
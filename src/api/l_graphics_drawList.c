@@ -0,0 +1,94 @@
+#include "api.h"
+#include "graphics/drawList.h"
+#include "graphics/graphics.h"
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/model.h"
+
+static int l_lovrDrawListDraw(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  float transform[16];
+  Mesh* mesh = luax_totype(L, 2, Mesh);
+  Model* model = mesh ? NULL : luax_checktype(L, 2, Model);
+  int index = luax_readmat4(L, 3, transform, 1);
+  uint32_t instances = luaL_optinteger(L, index, 1);
+  if (mesh) {
+    lovrDrawListMesh(list, mesh, transform, instances);
+  } else {
+    lovrDrawListModel(list, model, transform, instances);
+  }
+  return 0;
+}
+
+static int l_lovrDrawListClear(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  lovrDrawListClear(list);
+  return 0;
+}
+
+static int l_lovrDrawListGetCount(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  lua_pushinteger(L, lovrDrawListGetCount(list));
+  return 1;
+}
+
+static int l_lovrDrawListGetColor(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  Color color = lovrDrawListGetColor(list);
+  lua_pushnumber(L, color.r);
+  lua_pushnumber(L, color.g);
+  lua_pushnumber(L, color.b);
+  lua_pushnumber(L, color.a);
+  return 4;
+}
+
+static int l_lovrDrawListSetColor(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  Color color;
+  luax_readcolor(L, 2, &color);
+  lovrDrawListSetColor(list, color);
+  return 0;
+}
+
+static int l_lovrDrawListGetMaterial(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  luax_pushtype(L, Material, lovrDrawListGetMaterial(list));
+  return 1;
+}
+
+static int l_lovrDrawListSetMaterial(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  Material* material = lua_isnoneornil(L, 2) ? NULL : luax_checktype(L, 2, Material);
+  lovrDrawListSetMaterial(list, material);
+  return 0;
+}
+
+static int l_lovrDrawListSubmit(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  lovrGraphicsSubmit(list);
+  return 0;
+}
+
+const luaL_Reg lovrDrawList[] = {
+  { "draw", l_lovrDrawListDraw },
+  { "clear", l_lovrDrawListClear },
+  { "getCount", l_lovrDrawListGetCount },
+  { "getColor", l_lovrDrawListGetColor },
+  { "setColor", l_lovrDrawListSetColor },
+  { "getMaterial", l_lovrDrawListGetMaterial },
+  { "setMaterial", l_lovrDrawListSetMaterial },
+  { "submit", l_lovrDrawListSubmit },
+  { NULL, NULL }
+};
+
+// Threads without the GL context can record DrawLists, but only the main thread can submit them
+const luaL_Reg lovrDrawListThread[] = {
+  { "draw", l_lovrDrawListDraw },
+  { "clear", l_lovrDrawListClear },
+  { "getCount", l_lovrDrawListGetCount },
+  { "getColor", l_lovrDrawListGetColor },
+  { "setColor", l_lovrDrawListSetColor },
+  { "getMaterial", l_lovrDrawListGetMaterial },
+  { "setMaterial", l_lovrDrawListSetMaterial },
+  { NULL, NULL }
+};
@@ -4,7 +4,7 @@
 #include "data/modelData.h"
 #include "core/maf.h"
 
-static uint32_t luax_checkanimation(lua_State* L, int index, Model* model) {
+uint32_t luax_checkanimation(lua_State* L, int index, Model* model) {
   switch (lua_type(L, index)) {
     case LUA_TSTRING: {
       size_t length;
@@ -24,8 +24,14 @@ static int l_lovrModelDraw(lua_State* L) {
   float transform[16];
   int index = luax_readmat4(L, 2, transform, 1);
   int instances = luaL_optinteger(L, index, 1);
-  lovrModelDraw(model, transform, instances);
-  return 0;
+  if (lua_isnoneornil(L, index + 1)) {
+    lovrModelDraw(model, transform, instances, NULL);
+    return 0;
+  }
+  uint32_t lod = luaL_checkinteger(L, index + 1) - 1;
+  lovrModelDraw(model, transform, instances, &lod);
+  lua_pushinteger(L, lod + 1);
+  return 1;
 }
 
 static int l_lovrModelAnimate(lua_State* L) {
@@ -37,6 +43,22 @@ static int l_lovrModelAnimate(lua_State* L) {
   return 0;
 }
 
+static int l_lovrModelBlend(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  uint32_t animations[MAX_BLEND_ANIMATIONS];
+  float times[MAX_BLEND_ANIMATIONS];
+  float weights[MAX_BLEND_ANIMATIONS];
+  uint32_t count = (lua_gettop(L) - 1) / 3;
+  lovrAssert(count <= MAX_BLEND_ANIMATIONS, "Too many animations to blend (max is %d)", MAX_BLEND_ANIMATIONS);
+  for (uint32_t i = 0; i < count; i++) {
+    animations[i] = luax_checkanimation(L, 2 + 3 * i, model);
+    times[i] = luax_checkfloat(L, 3 + 3 * i);
+    weights[i] = luax_checkfloat(L, 4 + 3 * i);
+  }
+  lovrModelBlend(model, count, animations, times, weights);
+  return 0;
+}
+
 static int l_lovrModelPose(lua_State* L) {
   Model* model = luax_checktype(L, 1, Model);
 
@@ -192,9 +214,24 @@ static int l_lovrModelGetAnimationDuration(lua_State* L) {
   return 1;
 }
 
+static int l_lovrModelAddLOD(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  Model* lod = luax_checktype(L, 2, Model);
+  float size = luax_checkfloat(L, 3);
+  lovrModelAddLOD(model, lod, size);
+  return 0;
+}
+
+static int l_lovrModelGetLOD(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushinteger(L, lovrModelGetLOD(model) + 1);
+  return 1;
+}
+
 const luaL_Reg lovrModel[] = {
   { "draw", l_lovrModelDraw },
   { "animate", l_lovrModelAnimate },
+  { "blend", l_lovrModelBlend },
   { "pose", l_lovrModelPose },
   { "getMaterial", l_lovrModelGetMaterial },
   { "getAABB", l_lovrModelGetAABB },
@@ -206,5 +243,7 @@ const luaL_Reg lovrModel[] = {
   { "getMaterialCount", l_lovrModelGetMaterialCount },
   { "getNodeCount", l_lovrModelGetNodeCount },
   { "getAnimationDuration", l_lovrModelGetAnimationDuration },
+  { "addLOD", l_lovrModelAddLOD },
+  { "getLOD", l_lovrModelGetLOD },
   { NULL, NULL }
 };
@@ -0,0 +1,120 @@
+#include "api.h"
+#include "graphics/graphics.h"
+#include "graphics/mesh.h"
+#include "graphics/scene.h"
+
+static uint32_t luax_checksceneindex(lua_State* L, int index, Scene* scene) {
+  uint32_t i = luaL_checkinteger(L, index) - 1;
+  lovrAssert(i < lovrSceneGetCount(scene), "Invalid Scene object index: %d", i + 1);
+  return i;
+}
+
+static int l_lovrSceneDraw(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lovrGraphicsDrawScene(scene);
+  return 0;
+}
+
+static int l_lovrSceneAdd(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  Mesh* mesh = lovrSceneGetMesh(scene);
+  float transform[16];
+  int index = luax_readmat4(L, 2, transform, 1);
+
+  uint32_t indexCount = lovrMeshGetIndexCount(mesh);
+  uint32_t defaultCount = indexCount > 0 ? indexCount : lovrMeshGetVertexCount(mesh);
+  uint32_t start = luaL_optinteger(L, index++, 1) - 1;
+  uint32_t count = luaL_optinteger(L, index++, defaultCount - start);
+
+  float bounds[4];
+  bool bounded = lua_isnumber(L, index);
+  if (bounded) {
+    for (int i = 0; i < 4; i++) {
+      bounds[i] = luax_checkfloat(L, index + i);
+    }
+  }
+
+  uint32_t i = lovrSceneAdd(scene, transform, lovrGraphicsGetColor(), start, count, bounded ? bounds : NULL);
+  lua_pushinteger(L, i + 1);
+  return 1;
+}
+
+static int l_lovrSceneClear(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lovrSceneClear(scene);
+  return 0;
+}
+
+static int l_lovrSceneGetCount(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lua_pushinteger(L, lovrSceneGetCount(scene));
+  return 1;
+}
+
+static int l_lovrSceneGetCapacity(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lua_pushinteger(L, lovrSceneGetCapacity(scene));
+  return 1;
+}
+
+static int l_lovrSceneGetMesh(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  luax_pushtype(L, Mesh, lovrSceneGetMesh(scene));
+  return 1;
+}
+
+static int l_lovrSceneSetTransform(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  uint32_t i = luax_checksceneindex(L, 2, scene);
+  float transform[16];
+  luax_readmat4(L, 3, transform, 1);
+  lovrSceneSetTransform(scene, i, transform);
+  return 0;
+}
+
+static int l_lovrSceneGetColor(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  uint32_t i = luax_checksceneindex(L, 2, scene);
+  Color color = lovrSceneGetColor(scene, i);
+  lua_pushnumber(L, color.r);
+  lua_pushnumber(L, color.g);
+  lua_pushnumber(L, color.b);
+  lua_pushnumber(L, color.a);
+  return 4;
+}
+
+static int l_lovrSceneSetColor(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  uint32_t i = luax_checksceneindex(L, 2, scene);
+  Color color;
+  luax_readcolor(L, 3, &color);
+  lovrSceneSetColor(scene, i, color);
+  return 0;
+}
+
+static int l_lovrSceneIsCullingEnabled(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lua_pushboolean(L, lovrSceneIsCullingEnabled(scene));
+  return 1;
+}
+
+static int l_lovrSceneSetCullingEnabled(lua_State* L) {
+  Scene* scene = luax_checktype(L, 1, Scene);
+  lovrSceneSetCullingEnabled(scene, lua_toboolean(L, 2));
+  return 0;
+}
+
+const luaL_Reg lovrScene[] = {
+  { "draw", l_lovrSceneDraw },
+  { "add", l_lovrSceneAdd },
+  { "clear", l_lovrSceneClear },
+  { "getCount", l_lovrSceneGetCount },
+  { "getCapacity", l_lovrSceneGetCapacity },
+  { "getMesh", l_lovrSceneGetMesh },
+  { "setTransform", l_lovrSceneSetTransform },
+  { "getColor", l_lovrSceneGetColor },
+  { "setColor", l_lovrSceneSetColor },
+  { "isCullingEnabled", l_lovrSceneIsCullingEnabled },
+  { "setCullingEnabled", l_lovrSceneSetCullingEnabled },
+  { NULL, NULL }
+};
@@ -204,10 +204,33 @@ static int l_lovrShaderHasBlock(lua_State* L) {
   return 1;
 }
 
-static int l_lovrShaderSend(lua_State* L) {
+static int l_lovrShaderGetUniformHandle(lua_State* L) {
   Shader* shader = luax_checktype(L, 1, Shader);
   const char* name = luaL_checkstring(L, 2);
-  const Uniform* uniform = lovrShaderGetUniform(shader, name);
+  UniformHandle handle = lovrShaderGetUniformHandle(shader, name);
+  if (handle == LOVR_UNIFORM_NONE) {
+    lua_pushnil(L);
+  } else {
+    lua_pushlightuserdata(L, (void*) lovrShaderGetUniformAt(shader, handle));
+  }
+  return 1;
+}
+
+static int l_lovrShaderSend(lua_State* L) {
+  Shader* shader = luax_checktype(L, 1, Shader);
+  UniformHandle handle;
+  if (lua_type(L, 2) == LUA_TLIGHTUSERDATA) {
+    // Handles point at the Uniform itself, so one from another Shader falls outside this one's list
+    uintptr_t address = (uintptr_t) lua_touserdata(L, 2);
+    uintptr_t base = (uintptr_t) lovrShaderGetUniformAt(shader, 0);
+    handle = base && address >= base ? (UniformHandle) ((address - base) / sizeof(Uniform)) : LOVR_UNIFORM_NONE;
+    const Uniform* uniform = lovrShaderGetUniformAt(shader, handle);
+    lovrAssert(uniform && (uintptr_t) uniform == address, "Uniform handle belongs to a different Shader");
+  } else {
+    handle = lovrShaderGetUniformHandle(shader, luaL_checkstring(L, 2));
+  }
+
+  const Uniform* uniform = lovrShaderGetUniformAt(shader, handle);
   if (!uniform) {
     lua_pushboolean(L, false);
     return 1;
@@ -218,13 +241,13 @@ static int l_lovrShaderSend(lua_State* L) {
     tempData.data = realloc(tempData.data, tempData.size);
   }
 
-  luax_checkuniform(L, 3, uniform, tempData.data, name);
+  luax_checkuniform(L, 3, uniform, tempData.data, uniform->name);
   switch (uniform->type) {
-    case UNIFORM_FLOAT: lovrShaderSetFloats(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components); break;
-    case UNIFORM_INT: lovrShaderSetInts(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components); break;
-    case UNIFORM_MATRIX: lovrShaderSetMatrices(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components * uniform->components); break;
-    case UNIFORM_SAMPLER: lovrShaderSetTextures(shader, uniform->name, tempData.data, 0, uniform->count); break;
-    case UNIFORM_IMAGE: lovrShaderSetImages(shader, uniform->name, tempData.data, 0, uniform->count); break;
+    case UNIFORM_FLOAT: lovrShaderSetFloatsAt(shader, handle, tempData.data, 0, uniform->count * uniform->components); break;
+    case UNIFORM_INT: lovrShaderSetIntsAt(shader, handle, tempData.data, 0, uniform->count * uniform->components); break;
+    case UNIFORM_MATRIX: lovrShaderSetMatricesAt(shader, handle, tempData.data, 0, uniform->count * uniform->components * uniform->components); break;
+    case UNIFORM_SAMPLER: lovrShaderSetTexturesAt(shader, handle, tempData.data, 0, uniform->count); break;
+    case UNIFORM_IMAGE: lovrShaderSetImagesAt(shader, handle, tempData.data, 0, uniform->count); break;
   }
   lua_pushboolean(L, true);
   return 1;
@@ -264,6 +287,7 @@ const luaL_Reg lovrShader[] = {
   { "getType", l_lovrShaderGetType },
   { "hasUniform", l_lovrShaderHasUniform },
   { "hasBlock", l_lovrShaderHasBlock },
+  { "getUniformHandle", l_lovrShaderGetUniformHandle },
   { "send", l_lovrShaderSend },
   { "sendBlock", l_lovrShaderSendBlock },
   { "sendImage", l_lovrShaderSendImage },
@@ -81,6 +81,12 @@ static int l_lovrTextureGetWrap(lua_State* L) {
   return 2;
 }
 
+static int l_lovrTextureIsStreaming(lua_State* L) {
+  Texture* texture = luax_checktype(L, 1, Texture);
+  lua_pushboolean(L, lovrTextureIsStreaming(texture));
+  return 1;
+}
+
 static int l_lovrTextureReplacePixels(lua_State* L) {
   Texture* texture = luax_checktype(L, 1, Texture);
   TextureData* textureData = luax_checktype(L, 2, TextureData);
@@ -129,6 +135,7 @@ const luaL_Reg lovrTexture[] = {
   { "getType", l_lovrTextureGetType },
   { "getWidth", l_lovrTextureGetWidth },
   { "getWrap", l_lovrTextureGetWrap },
+  { "isStreaming", l_lovrTextureIsStreaming },
   { "replacePixels", l_lovrTextureReplacePixels },
   { "setCompareMode", l_lovrTextureSetCompareMode },
   { "setFilter", l_lovrTextureSetFilter },
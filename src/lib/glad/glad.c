@@ -11,6 +11,8 @@
         GL_ARB_buffer_storage,
         GL_ARB_compute_shader,
         GL_ARB_fragment_layer_viewport,
+        GL_ARB_get_program_binary,
+        GL_ARB_multi_draw_indirect,
         GL_ARB_program_interface_query,
         GL_ARB_shader_image_load_store,
         GL_ARB_shader_storage_buffer_object,
@@ -20,6 +22,7 @@
         GL_EXT_texture_compression_s3tc,
         GL_EXT_texture_filter_anisotropic,
         GL_EXT_texture_sRGB,
+        GL_KHR_parallel_shader_compile,
         GL_OVR_multiview,
         GL_OVR_multiview2,
         GL_OVR_multiview_multisampled_render_to_texture
@@ -29,9 +32,9 @@
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=3.3,gles2=3.2" --generator="c" --spec="gl" --no-loader --local-files --extensions="GL_AMD_vertex_shader_viewport_index,GL_ARB_buffer_storage,GL_ARB_compute_shader,GL_ARB_fragment_layer_viewport,GL_ARB_program_interface_query,GL_ARB_shader_image_load_store,GL_ARB_shader_storage_buffer_object,GL_ARB_texture_storage,GL_ARB_viewport_array,GL_EXT_disjoint_timer_query,GL_EXT_texture_compression_s3tc,GL_EXT_texture_filter_anisotropic,GL_EXT_texture_sRGB,GL_OVR_multiview,GL_OVR_multiview2,GL_OVR_multiview_multisampled_render_to_texture"
+        --profile="core" --api="gl=3.3,gles2=3.2" --generator="c" --spec="gl" --no-loader --local-files --extensions="GL_AMD_vertex_shader_viewport_index,GL_ARB_buffer_storage,GL_ARB_compute_shader,GL_ARB_fragment_layer_viewport,GL_ARB_get_program_binary,GL_ARB_multi_draw_indirect,GL_ARB_program_interface_query,GL_ARB_shader_image_load_store,GL_ARB_shader_storage_buffer_object,GL_ARB_texture_storage,GL_ARB_viewport_array,GL_EXT_disjoint_timer_query,GL_EXT_texture_compression_s3tc,GL_EXT_texture_filter_anisotropic,GL_EXT_texture_sRGB,GL_KHR_parallel_shader_compile,GL_OVR_multiview,GL_OVR_multiview2,GL_OVR_multiview_multisampled_render_to_texture"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&api=gl%3D3.3&api=gles2%3D3.2&extensions=GL_AMD_vertex_shader_viewport_index&extensions=GL_ARB_buffer_storage&extensions=GL_ARB_compute_shader&extensions=GL_ARB_fragment_layer_viewport&extensions=GL_ARB_program_interface_query&extensions=GL_ARB_shader_image_load_store&extensions=GL_ARB_shader_storage_buffer_object&extensions=GL_ARB_texture_storage&extensions=GL_ARB_viewport_array&extensions=GL_EXT_disjoint_timer_query&extensions=GL_EXT_texture_compression_s3tc&extensions=GL_EXT_texture_filter_anisotropic&extensions=GL_EXT_texture_sRGB&extensions=GL_OVR_multiview&extensions=GL_OVR_multiview2&extensions=GL_OVR_multiview_multisampled_render_to_texture
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&api=gl%3D3.3&api=gles2%3D3.2&extensions=GL_AMD_vertex_shader_viewport_index&extensions=GL_ARB_buffer_storage&extensions=GL_ARB_compute_shader&extensions=GL_ARB_fragment_layer_viewport&extensions=GL_ARB_get_program_binary&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_program_interface_query&extensions=GL_ARB_shader_image_load_store&extensions=GL_ARB_shader_storage_buffer_object&extensions=GL_ARB_texture_storage&extensions=GL_ARB_viewport_array&extensions=GL_EXT_disjoint_timer_query&extensions=GL_EXT_texture_compression_s3tc&extensions=GL_EXT_texture_filter_anisotropic&extensions=GL_EXT_texture_sRGB&extensions=GL_KHR_parallel_shader_compile&extensions=GL_OVR_multiview&extensions=GL_OVR_multiview2&extensions=GL_OVR_multiview_multisampled_render_to_texture
 */
 
 #include <stdio.h>
@@ -641,6 +644,8 @@ int GLAD_GL_AMD_vertex_shader_viewport_index = 0;
 int GLAD_GL_ARB_buffer_storage = 0;
 int GLAD_GL_ARB_compute_shader = 0;
 int GLAD_GL_ARB_fragment_layer_viewport = 0;
+int GLAD_GL_ARB_get_program_binary = 0;
+int GLAD_GL_ARB_multi_draw_indirect = 0;
 int GLAD_GL_ARB_program_interface_query = 0;
 int GLAD_GL_ARB_shader_image_load_store = 0;
 int GLAD_GL_ARB_shader_storage_buffer_object = 0;
@@ -650,10 +655,14 @@ int GLAD_GL_EXT_disjoint_timer_query = 0;
 int GLAD_GL_EXT_texture_compression_s3tc = 0;
 int GLAD_GL_EXT_texture_filter_anisotropic = 0;
 int GLAD_GL_EXT_texture_sRGB = 0;
+int GLAD_GL_KHR_parallel_shader_compile = 0;
 int GLAD_GL_OVR_multiview = 0;
 int GLAD_GL_OVR_multiview2 = 0;
 int GLAD_GL_OVR_multiview_multisampled_render_to_texture = 0;
 PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = NULL;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR = NULL;
+PFNGLMULTIDRAWARRAYSINDIRECTPROC glad_glMultiDrawArraysIndirect = NULL;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = NULL;
 PFNGLGETPROGRAMRESOURCELOCATIONINDEXPROC glad_glGetProgramResourceLocationIndex = NULL;
 PFNGLSHADERSTORAGEBLOCKBINDINGPROC glad_glShaderStorageBlockBinding = NULL;
 PFNGLTEXSTORAGE1DPROC glad_glTexStorage1D = NULL;
@@ -1102,6 +1111,17 @@ static void load_GL_ARB_compute_shader(GLADloadproc load) {
 	glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
 	glad_glDispatchComputeIndirect = (PFNGLDISPATCHCOMPUTEINDIRECTPROC)load("glDispatchComputeIndirect");
 }
+static void load_GL_ARB_get_program_binary(GLADloadproc load) {
+	if(!GLAD_GL_ARB_get_program_binary) return;
+	glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+	glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+}
+static void load_GL_ARB_multi_draw_indirect(GLADloadproc load) {
+	if(!GLAD_GL_ARB_multi_draw_indirect) return;
+	glad_glMultiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC)load("glMultiDrawArraysIndirect");
+	glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+}
 static void load_GL_ARB_program_interface_query(GLADloadproc load) {
 	if(!GLAD_GL_ARB_program_interface_query) return;
 	glad_glGetProgramInterfaceiv = (PFNGLGETPROGRAMINTERFACEIVPROC)load("glGetProgramInterfaceiv");
@@ -1139,6 +1159,10 @@ static void load_GL_ARB_viewport_array(GLADloadproc load) {
 	glad_glGetFloati_v = (PFNGLGETFLOATI_VPROC)load("glGetFloati_v");
 	glad_glGetDoublei_v = (PFNGLGETDOUBLEI_VPROC)load("glGetDoublei_v");
 }
+static void load_GL_KHR_parallel_shader_compile(GLADloadproc load) {
+	if(!GLAD_GL_KHR_parallel_shader_compile) return;
+	glad_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+}
 static void load_GL_OVR_multiview(GLADloadproc load) {
 	if(!GLAD_GL_OVR_multiview) return;
 	glad_glFramebufferTextureMultiviewOVR = (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)load("glFramebufferTextureMultiviewOVR");
@@ -1149,6 +1173,8 @@ static int find_extensionsGL(void) {
 	GLAD_GL_ARB_buffer_storage = has_ext("GL_ARB_buffer_storage");
 	GLAD_GL_ARB_compute_shader = has_ext("GL_ARB_compute_shader");
 	GLAD_GL_ARB_fragment_layer_viewport = has_ext("GL_ARB_fragment_layer_viewport");
+	GLAD_GL_ARB_get_program_binary = has_ext("GL_ARB_get_program_binary");
+	GLAD_GL_ARB_multi_draw_indirect = has_ext("GL_ARB_multi_draw_indirect");
 	GLAD_GL_ARB_program_interface_query = has_ext("GL_ARB_program_interface_query");
 	GLAD_GL_ARB_shader_image_load_store = has_ext("GL_ARB_shader_image_load_store");
 	GLAD_GL_ARB_shader_storage_buffer_object = has_ext("GL_ARB_shader_storage_buffer_object");
@@ -1157,6 +1183,7 @@ static int find_extensionsGL(void) {
 	GLAD_GL_EXT_texture_compression_s3tc = has_ext("GL_EXT_texture_compression_s3tc");
 	GLAD_GL_EXT_texture_filter_anisotropic = has_ext("GL_EXT_texture_filter_anisotropic");
 	GLAD_GL_EXT_texture_sRGB = has_ext("GL_EXT_texture_sRGB");
+	GLAD_GL_KHR_parallel_shader_compile = has_ext("GL_KHR_parallel_shader_compile");
 	GLAD_GL_OVR_multiview = has_ext("GL_OVR_multiview");
 	GLAD_GL_OVR_multiview2 = has_ext("GL_OVR_multiview2");
 	free_exts();
@@ -1239,11 +1266,14 @@ int gladLoadGLLoader(GLADloadproc load) {
 	if (!find_extensionsGL()) return 0;
 	load_GL_ARB_buffer_storage(load);
 	load_GL_ARB_compute_shader(load);
+	load_GL_ARB_get_program_binary(load);
+	load_GL_ARB_multi_draw_indirect(load);
 	load_GL_ARB_program_interface_query(load);
 	load_GL_ARB_shader_image_load_store(load);
 	load_GL_ARB_shader_storage_buffer_object(load);
 	load_GL_ARB_texture_storage(load);
 	load_GL_ARB_viewport_array(load);
+	load_GL_KHR_parallel_shader_compile(load);
 	load_GL_OVR_multiview(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
@@ -1641,6 +1671,7 @@ static int find_extensionsGLES2(void) {
 	GLAD_GL_EXT_disjoint_timer_query = has_ext("GL_EXT_disjoint_timer_query");
 	GLAD_GL_EXT_texture_compression_s3tc = has_ext("GL_EXT_texture_compression_s3tc");
 	GLAD_GL_EXT_texture_filter_anisotropic = has_ext("GL_EXT_texture_filter_anisotropic");
+	GLAD_GL_KHR_parallel_shader_compile = has_ext("GL_KHR_parallel_shader_compile");
 	GLAD_GL_OVR_multiview = has_ext("GL_OVR_multiview");
 	GLAD_GL_OVR_multiview2 = has_ext("GL_OVR_multiview2");
 	GLAD_GL_OVR_multiview_multisampled_render_to_texture = has_ext("GL_OVR_multiview_multisampled_render_to_texture");
@@ -1707,6 +1738,7 @@ int gladLoadGLES2Loader(GLADloadproc load) {
 
 	if (!find_extensionsGLES2()) return 0;
 	load_GL_EXT_disjoint_timer_query(load);
+	load_GL_KHR_parallel_shader_compile(load);
 	load_GL_OVR_multiview(load);
 	load_GL_OVR_multiview_multisampled_render_to_texture(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
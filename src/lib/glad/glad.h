@@ -11,6 +11,8 @@
         GL_ARB_buffer_storage,
         GL_ARB_compute_shader,
         GL_ARB_fragment_layer_viewport,
+        GL_ARB_get_program_binary,
+        GL_ARB_multi_draw_indirect,
         GL_ARB_program_interface_query,
         GL_ARB_shader_image_load_store,
         GL_ARB_shader_storage_buffer_object,
@@ -20,6 +22,7 @@
         GL_EXT_texture_compression_s3tc,
         GL_EXT_texture_filter_anisotropic,
         GL_EXT_texture_sRGB,
+        GL_KHR_parallel_shader_compile,
         GL_OVR_multiview,
         GL_OVR_multiview2,
         GL_OVR_multiview_multisampled_render_to_texture
@@ -29,9 +32,9 @@
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=3.3,gles2=3.2" --generator="c" --spec="gl" --no-loader --local-files --extensions="GL_AMD_vertex_shader_viewport_index,GL_ARB_buffer_storage,GL_ARB_compute_shader,GL_ARB_fragment_layer_viewport,GL_ARB_program_interface_query,GL_ARB_shader_image_load_store,GL_ARB_shader_storage_buffer_object,GL_ARB_texture_storage,GL_ARB_viewport_array,GL_EXT_disjoint_timer_query,GL_EXT_texture_compression_s3tc,GL_EXT_texture_filter_anisotropic,GL_EXT_texture_sRGB,GL_OVR_multiview,GL_OVR_multiview2,GL_OVR_multiview_multisampled_render_to_texture"
+        --profile="core" --api="gl=3.3,gles2=3.2" --generator="c" --spec="gl" --no-loader --local-files --extensions="GL_AMD_vertex_shader_viewport_index,GL_ARB_buffer_storage,GL_ARB_compute_shader,GL_ARB_fragment_layer_viewport,GL_ARB_get_program_binary,GL_ARB_multi_draw_indirect,GL_ARB_program_interface_query,GL_ARB_shader_image_load_store,GL_ARB_shader_storage_buffer_object,GL_ARB_texture_storage,GL_ARB_viewport_array,GL_EXT_disjoint_timer_query,GL_EXT_texture_compression_s3tc,GL_EXT_texture_filter_anisotropic,GL_EXT_texture_sRGB,GL_KHR_parallel_shader_compile,GL_OVR_multiview,GL_OVR_multiview2,GL_OVR_multiview_multisampled_render_to_texture"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&api=gl%3D3.3&api=gles2%3D3.2&extensions=GL_AMD_vertex_shader_viewport_index&extensions=GL_ARB_buffer_storage&extensions=GL_ARB_compute_shader&extensions=GL_ARB_fragment_layer_viewport&extensions=GL_ARB_program_interface_query&extensions=GL_ARB_shader_image_load_store&extensions=GL_ARB_shader_storage_buffer_object&extensions=GL_ARB_texture_storage&extensions=GL_ARB_viewport_array&extensions=GL_EXT_disjoint_timer_query&extensions=GL_EXT_texture_compression_s3tc&extensions=GL_EXT_texture_filter_anisotropic&extensions=GL_EXT_texture_sRGB&extensions=GL_OVR_multiview&extensions=GL_OVR_multiview2&extensions=GL_OVR_multiview_multisampled_render_to_texture
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&api=gl%3D3.3&api=gles2%3D3.2&extensions=GL_AMD_vertex_shader_viewport_index&extensions=GL_ARB_buffer_storage&extensions=GL_ARB_compute_shader&extensions=GL_ARB_fragment_layer_viewport&extensions=GL_ARB_get_program_binary&extensions=GL_ARB_multi_draw_indirect&extensions=GL_ARB_program_interface_query&extensions=GL_ARB_shader_image_load_store&extensions=GL_ARB_shader_storage_buffer_object&extensions=GL_ARB_texture_storage&extensions=GL_ARB_viewport_array&extensions=GL_EXT_disjoint_timer_query&extensions=GL_EXT_texture_compression_s3tc&extensions=GL_EXT_texture_filter_anisotropic&extensions=GL_EXT_texture_sRGB&extensions=GL_KHR_parallel_shader_compile&extensions=GL_OVR_multiview&extensions=GL_OVR_multiview2&extensions=GL_OVR_multiview_multisampled_render_to_texture
 */
 
 
@@ -2923,6 +2926,8 @@ GLAPI PFNGLTEXSTORAGE3DMULTISAMPLEPROC glad_glTexStorage3DMultisample;
 #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
 #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
 #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR 0x9630
 #define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR 0x9632
 #define GL_MAX_VIEWS_OVR 0x9631
@@ -2953,6 +2958,20 @@ GLAPI int GLAD_GL_ARB_compute_shader;
 #define GL_ARB_fragment_layer_viewport 1
 GLAPI int GLAD_GL_ARB_fragment_layer_viewport;
 #endif
+#ifndef GL_ARB_get_program_binary
+#define GL_ARB_get_program_binary 1
+GLAPI int GLAD_GL_ARB_get_program_binary;
+#endif
+#ifndef GL_ARB_multi_draw_indirect
+#define GL_ARB_multi_draw_indirect 1
+GLAPI int GLAD_GL_ARB_multi_draw_indirect;
+typedef void (APIENTRYP PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode, const void *indirect, GLsizei drawcount, GLsizei stride);
+GLAPI PFNGLMULTIDRAWARRAYSINDIRECTPROC glad_glMultiDrawArraysIndirect;
+#define glMultiDrawArraysIndirect glad_glMultiDrawArraysIndirect
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+GLAPI PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect;
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#endif
 #ifndef GL_ARB_program_interface_query
 #define GL_ARB_program_interface_query 1
 GLAPI int GLAD_GL_ARB_program_interface_query;
@@ -3024,6 +3043,13 @@ GLAPI int GLAD_GL_EXT_texture_filter_anisotropic;
 #define GL_EXT_texture_sRGB 1
 GLAPI int GLAD_GL_EXT_texture_sRGB;
 #endif
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+GLAPI int GLAD_GL_KHR_parallel_shader_compile;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+GLAPI PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
 #ifndef GL_OVR_multiview
 #define GL_OVR_multiview 1
 GLAPI int GLAD_GL_OVR_multiview;
@@ -3080,6 +3106,13 @@ GLAPI int GLAD_GL_EXT_texture_compression_s3tc;
 #define GL_EXT_texture_filter_anisotropic 1
 GLAPI int GLAD_GL_EXT_texture_filter_anisotropic;
 #endif
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+GLAPI int GLAD_GL_KHR_parallel_shader_compile;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+GLAPI PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
 #ifndef GL_OVR_multiview
 #define GL_OVR_multiview 1
 GLAPI int GLAD_GL_OVR_multiview;
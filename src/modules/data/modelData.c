@@ -1,8 +1,12 @@
 #include "data/modelData.h"
 #include "data/blob.h"
 #include "data/textureData.h"
+#include "core/maf.h"
 #include "core/ref.h"
 #include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
 
 ModelData* lovrModelDataInit(ModelData* model, Blob* source, ModelDataIO* io) {
   if (lovrModelDataInitGltf(model, source, io)) {
@@ -26,6 +30,7 @@ void lovrModelDataDestroy(void* ref) {
   map_free(&model->animationMap);
   map_free(&model->materialMap);
   map_free(&model->nodeMap);
+  free(model->animationData);
   free(model->data);
 }
 
@@ -68,3 +73,264 @@ void lovrModelDataAllocate(ModelData* model) {
   map_init(&model->materialMap, model->materialCount);
   map_init(&model->nodeMap, model->nodeCount);
 }
+
+#define SQRT1_2 .70710678f
+
+// Rotations use the smallest three encoding: the largest component is dropped (and recovered from
+// the others since the quaternion is unit length), the other three are in [-sqrt(.5), sqrt(.5)] and
+// get 15 bits each.  The index of the dropped component goes in the low bits of the first two.
+static void quantizeRotation(float* q, uint16_t* out) {
+  uint32_t largest = 0;
+  for (uint32_t i = 1; i < 4; i++) {
+    if (fabsf(q[i]) > fabsf(q[largest])) {
+      largest = i;
+    }
+  }
+
+  float sign = q[largest] < 0.f ? -1.f : 1.f;
+  for (uint32_t i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      float x = sign * q[i] * SQRT1_2 + .5f;
+      x = CLAMP(x, 0.f, 1.f);
+      out[j++] = (uint16_t) (roundf(x * 32767.f)) << 1;
+    }
+  }
+
+  out[0] |= largest & 1;
+  out[1] |= largest >> 1;
+}
+
+static void dequantizeRotation(uint16_t* in, float* q) {
+  uint32_t largest = (in[0] & 1) | ((in[1] & 1) << 1);
+  float sum = 0.f;
+  for (uint32_t i = 0, j = 0; i < 4; i++) {
+    if (i != largest) {
+      q[i] = ((in[j++] >> 1) / 32767.f - .5f) * 2.f * SQRT1_2;
+      sum += q[i] * q[i];
+    }
+  }
+  q[largest] = sqrtf(MAX(1.f - sum, 0.f));
+}
+
+void lovrModelDataGetKeyframe(ModelAnimationChannel* channel, uint32_t index, float* value) {
+  if (!channel->quantized) {
+    size_t n = channel->property == PROP_ROTATION ? 4 : 3;
+    memcpy(value, channel->data + index * n, n * sizeof(float));
+  } else if (channel->property == PROP_ROTATION) {
+    dequantizeRotation(channel->quantized + 3 * index, value);
+  } else {
+    uint16_t* q = channel->quantized + 3 * index;
+    for (uint32_t i = 0; i < 3; i++) {
+      value[i] = channel->offset[i] + q[i] / 65535.f * channel->extent[i];
+    }
+  }
+}
+
+static float keyframeError(float* a, float* b, bool rotation) {
+  float sign = (rotation && a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.f) ? -1.f : 1.f;
+  float error = 0.f;
+  for (uint32_t i = 0; i < (rotation ? 4u : 3u); i++) {
+    error = MAX(error, fabsf(a[i] - sign * b[i]));
+  }
+  return error;
+}
+
+// Keeps a keyframe only if interpolating across it would move one of the keyframes since the last
+// kept one by more than the tolerance.  Returns the number of keyframes kept.
+static uint32_t reduceKeyframes(ModelAnimationChannel* channel, float* values, float tolerance, uint32_t* kept) {
+  uint32_t count = channel->keyframeCount;
+  uint32_t keptCount = 0;
+  bool rotation = channel->property == PROP_ROTATION;
+
+  kept[keptCount++] = 0;
+  for (uint32_t i = 1; i + 1 < count; i++) {
+    uint32_t anchor = kept[keptCount - 1];
+    float t0 = channel->times[anchor];
+    float dt = channel->times[i + 1] - t0;
+
+    // Step channels switch halfway between keyframes, so removing keys would shift their timing
+    bool keep = channel->smoothing != SMOOTH_LINEAR || dt <= 0.f;
+    for (uint32_t j = anchor + 1; j <= i && !keep; j++) {
+      float predicted[4];
+      memcpy(predicted, values + 4 * anchor, 4 * sizeof(float));
+      if (rotation) {
+        quat_slerp(predicted, values + 4 * (i + 1), (channel->times[j] - t0) / dt);
+      } else {
+        vec3_lerp(predicted, values + 4 * (i + 1), (channel->times[j] - t0) / dt);
+      }
+      keep = keyframeError(predicted, values + 4 * j, rotation) > tolerance;
+    }
+
+    if (keep) {
+      kept[keptCount++] = i;
+    }
+  }
+
+  if (count > 1) {
+    kept[keptCount++] = count - 1;
+  }
+
+  return keptCount;
+}
+
+// Returns an earlier channel's times if they match, so channels with the same keyframe times can
+// share them.  The times of channels before index are the ones they will have after compression.
+static float* findTimes(float** channelTimes, uint32_t* counts, uint32_t index) {
+  for (uint32_t i = 0; i < index; i++) {
+    if (counts[i] == counts[index] && !memcmp(channelTimes[i], channelTimes[index], counts[i] * sizeof(float))) {
+      return channelTimes[i];
+    }
+  }
+  return NULL;
+}
+
+// Removes keyframes that can be recovered by interpolation and quantizes keyframe data to 16 bits per
+// component.  Cubic channels are only copied since their tangents don't survive either step.  Times
+// are stored once for all channels with the same keyframe times.  The tolerance only applies to the
+// keyframe reduction, quantization adds up to half a step of error on top of it (1/65535 of a
+// channel's range for translations and scales, about 1/46000 per rotation component).
+void lovrModelDataCompressAnimations(ModelData* model, float tolerance) {
+  uint32_t channelCount = model->channelCount;
+  uint32_t maxKeyframes = 0;
+  size_t totalKeyframes = 0;
+  for (uint32_t i = 0; i < channelCount; i++) {
+    maxKeyframes = MAX(maxKeyframes, model->channels[i].keyframeCount);
+    totalKeyframes += model->channels[i].keyframeCount;
+  }
+
+  float* values = malloc(maxKeyframes * 4 * sizeof(float));
+  uint32_t* kept = malloc(totalKeyframes * sizeof(uint32_t));
+  float* keptTimes = malloc(totalKeyframes * sizeof(float));
+  uint32_t* counts = malloc(channelCount * sizeof(uint32_t));
+  float** channelTimes = malloc(channelCount * sizeof(float*));
+  lovrAssert((values && kept && keptTimes && counts && channelTimes) || totalKeyframes == 0, "Out of memory");
+
+  // Keyframes are reduced before anything is allocated, so the new data is sized by what's kept
+  size_t timeSize = 0;
+  size_t cubicSize = 0;
+  size_t quantizedSize = 0;
+  for (uint32_t i = 0, offset = 0; i < channelCount; i++) {
+    ModelAnimationChannel* channel = &model->channels[i];
+    uint32_t* channelKept = kept + offset;
+
+    if (channel->smoothing == SMOOTH_CUBIC) {
+      size_t n = channel->property == PROP_ROTATION ? 4 : 3;
+      cubicSize += channel->keyframeCount * 3 * n * sizeof(float);
+      counts[i] = channel->keyframeCount;
+      for (uint32_t j = 0; j < counts[i]; j++) {
+        channelKept[j] = j;
+      }
+    } else if (channel->keyframeCount > 0) {
+      for (uint32_t j = 0; j < channel->keyframeCount; j++) {
+        lovrModelDataGetKeyframe(channel, j, values + 4 * j);
+      }
+
+      counts[i] = reduceKeyframes(channel, values, tolerance, channelKept);
+      quantizedSize += counts[i] * 3 * sizeof(uint16_t);
+    } else {
+      counts[i] = 0;
+    }
+
+    channelTimes[i] = keptTimes + offset;
+    for (uint32_t j = 0; j < counts[i]; j++) {
+      channelTimes[i][j] = channel->times[channelKept[j]];
+    }
+
+    if (!findTimes(channelTimes, counts, i)) {
+      timeSize += counts[i] * sizeof(float);
+    }
+
+    offset += channel->keyframeCount;
+  }
+
+  size_t size = timeSize + cubicSize + quantizedSize;
+  char* data = malloc(size);
+  lovrAssert(data || size == 0, "Out of memory");
+
+  // Times go first, then the float data of cubic channels, then the quantized data
+  size_t timeOffset = 0;
+  size_t cubicOffset = timeSize;
+  size_t quantizedOffset = timeSize + cubicSize;
+
+  for (uint32_t i = 0, offset = 0; i < channelCount; i++) {
+    ModelAnimationChannel* channel = &model->channels[i];
+    uint32_t* channelKept = kept + offset;
+    uint32_t count = counts[i];
+    offset += channel->keyframeCount;
+
+    if (channel->keyframeCount == 0) {
+      continue;
+    }
+
+    float* times = findTimes(channelTimes, counts, i);
+    if (!times) {
+      times = (float*) (data + timeOffset);
+      memcpy(times, channelTimes[i], count * sizeof(float));
+      timeOffset += count * sizeof(float);
+    }
+
+    // Later channels compare against the stored copy, which has the same contents
+    channelTimes[i] = times;
+
+    if (channel->smoothing == SMOOTH_CUBIC) {
+      size_t n = channel->property == PROP_ROTATION ? 4 : 3;
+      float* cubic = (float*) (data + cubicOffset);
+      memcpy(cubic, channel->data, channel->keyframeCount * 3 * n * sizeof(float));
+      cubicOffset += channel->keyframeCount * 3 * n * sizeof(float);
+      channel->times = times;
+      channel->data = cubic;
+      continue;
+    }
+
+    for (uint32_t j = 0; j < count; j++) {
+      lovrModelDataGetKeyframe(channel, channelKept[j], values + 4 * j);
+    }
+
+    uint16_t* quantized = (uint16_t*) (data + quantizedOffset);
+    quantizedOffset += 3 * count * sizeof(uint16_t);
+
+    if (channel->property == PROP_ROTATION) {
+      for (uint32_t j = 0; j < count; j++) {
+        float* q = values + 4 * j;
+        quat_normalize(q);
+        quantizeRotation(q, quantized + 3 * j);
+      }
+    } else {
+      float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      for (uint32_t j = 0; j < count; j++) {
+        for (uint32_t c = 0; c < 3; c++) {
+          min[c] = MIN(min[c], values[4 * j + c]);
+          max[c] = MAX(max[c], values[4 * j + c]);
+        }
+      }
+
+      for (uint32_t c = 0; c < 3; c++) {
+        channel->offset[c] = min[c];
+        channel->extent[c] = max[c] - min[c];
+      }
+
+      for (uint32_t j = 0; j < count; j++) {
+        for (uint32_t c = 0; c < 3; c++) {
+          float x = channel->extent[c] > 0.f ? (values[4 * j + c] - min[c]) / channel->extent[c] : 0.f;
+          quantized[3 * j + c] = (uint16_t) roundf(x * 65535.f);
+        }
+      }
+    }
+
+    channel->keyframeCount = count;
+    channel->times = times;
+    channel->data = NULL;
+    channel->quantized = quantized;
+  }
+
+  free(channelTimes);
+  free(counts);
+  free(keptTimes);
+  free(kept);
+  free(values);
+
+  // Uncompressed keyframes point into the model's buffers, animationData is only set once compressed
+  free(model->animationData);
+  model->animationData = data;
+}
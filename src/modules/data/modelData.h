@@ -129,6 +129,9 @@ typedef struct {
   uint32_t keyframeCount;
   float* times;
   float* data;
+  uint16_t* quantized;
+  float offset[3];
+  float extent[3];
 } ModelAnimationChannel;
 
 typedef struct {
@@ -213,6 +216,8 @@ typedef struct ModelData {
   map_t animationMap;
   map_t materialMap;
   map_t nodeMap;
+
+  void* animationData;
 } ModelData;
 
 typedef void* ModelDataIO(const char* filename, size_t* bytesRead);
@@ -223,3 +228,5 @@ ModelData* lovrModelDataInitGltf(ModelData* model, struct Blob* blob, ModelDataI
 ModelData* lovrModelDataInitObj(ModelData* model, struct Blob* blob, ModelDataIO* io);
 void lovrModelDataDestroy(void* ref);
 void lovrModelDataAllocate(ModelData* model);
+void lovrModelDataCompressAnimations(ModelData* model, float tolerance);
+void lovrModelDataGetKeyframe(ModelAnimationChannel* channel, uint32_t index, float* value);
@@ -8,6 +8,7 @@ typedef enum {
   BUFFER_INDEX,
   BUFFER_UNIFORM,
   BUFFER_SHADER_STORAGE,
+  BUFFER_INDIRECT,
   BUFFER_GENERIC,
   MAX_BUFFER_TYPES
 } BufferType;
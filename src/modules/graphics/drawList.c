@@ -0,0 +1,85 @@
+#include "graphics/drawList.h"
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/model.h"
+#include "core/maf.h"
+#include "core/ref.h"
+#include <stdlib.h>
+
+DrawList* lovrDrawListInit(DrawList* list) {
+  arr_init(&list->entries);
+  list->color = (Color) { 1.f, 1.f, 1.f, 1.f };
+  return list;
+}
+
+void lovrDrawListDestroy(void* ref) {
+  DrawList* list = ref;
+  lovrDrawListClear(list);
+  lovrRelease(Material, list->material);
+  arr_free(&list->entries);
+}
+
+void lovrDrawListClear(DrawList* list) {
+  for (size_t i = 0; i < list->entries.length; i++) {
+    DrawListEntry* entry = &list->entries.data[i];
+    switch (entry->type) {
+      case DRAW_LIST_MESH: lovrRelease(Mesh, entry->object.mesh); break;
+      case DRAW_LIST_MODEL: lovrRelease(Model, entry->object.model); break;
+    }
+    lovrRelease(Material, entry->material);
+  }
+  arr_clear(&list->entries);
+}
+
+uint32_t lovrDrawListGetCount(DrawList* list) {
+  return list->entries.length;
+}
+
+Color lovrDrawListGetColor(DrawList* list) {
+  return list->color;
+}
+
+void lovrDrawListSetColor(DrawList* list, Color color) {
+  list->color = color;
+}
+
+Material* lovrDrawListGetMaterial(DrawList* list) {
+  return list->material;
+}
+
+void lovrDrawListSetMaterial(DrawList* list, Material* material) {
+  lovrRetain(material);
+  lovrRelease(Material, list->material);
+  list->material = material;
+}
+
+static void lovrDrawListPush(DrawList* list, DrawListEntry* entry, float* transform) {
+  if (transform) {
+    mat4_init(entry->transform, transform);
+  } else {
+    mat4_identity(entry->transform);
+  }
+
+  entry->color = list->color;
+  entry->material = list->material;
+  lovrRetain(entry->material);
+  arr_push(&list->entries, *entry);
+}
+
+void lovrDrawListMesh(DrawList* list, Mesh* mesh, float* transform, uint32_t instances) {
+  lovrRetain(mesh);
+  lovrDrawListPush(list, &(DrawListEntry) {
+    .type = DRAW_LIST_MESH,
+    .object.mesh = mesh,
+    .instances = instances
+  }, transform);
+}
+
+void lovrDrawListModel(DrawList* list, Model* model, float* transform, uint32_t instances) {
+  lovrRetain(model);
+  lovrDrawListPush(list, &(DrawListEntry) {
+    .type = DRAW_LIST_MODEL,
+    .object.model = model,
+    .instances = instances
+  }, transform);
+}
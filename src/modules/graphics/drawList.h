@@ -0,0 +1,47 @@
+#include "core/arr.h"
+#include "core/util.h"
+#include <stdint.h>
+
+#pragma once
+
+struct Material;
+struct Mesh;
+struct Model;
+
+// A DrawList records draws without touching any graphics state, so it can be filled on any thread.
+// It should only be used by one thread at a time, and only submitted on the graphics thread.
+
+typedef enum {
+  DRAW_LIST_MESH,
+  DRAW_LIST_MODEL
+} DrawListEntryType;
+
+typedef struct {
+  DrawListEntryType type;
+  union {
+    struct Mesh* mesh;
+    struct Model* model;
+  } object;
+  struct Material* material;
+  float transform[16];
+  Color color;
+  uint32_t instances;
+} DrawListEntry;
+
+typedef struct DrawList {
+  arr_t(DrawListEntry) entries;
+  struct Material* material;
+  Color color;
+} DrawList;
+
+DrawList* lovrDrawListInit(DrawList* list);
+#define lovrDrawListCreate() lovrDrawListInit(lovrAlloc(DrawList))
+void lovrDrawListDestroy(void* ref);
+void lovrDrawListClear(DrawList* list);
+uint32_t lovrDrawListGetCount(DrawList* list);
+Color lovrDrawListGetColor(DrawList* list);
+void lovrDrawListSetColor(DrawList* list, Color color);
+struct Material* lovrDrawListGetMaterial(DrawList* list);
+void lovrDrawListSetMaterial(DrawList* list, struct Material* material);
+void lovrDrawListMesh(DrawList* list, struct Mesh* mesh, float* transform, uint32_t instances);
+void lovrDrawListModel(DrawList* list, struct Model* model, float* transform, uint32_t instances);
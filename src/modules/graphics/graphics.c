@@ -1,13 +1,18 @@
 #include "graphics/graphics.h"
 #include "graphics/buffer.h"
 #include "graphics/canvas.h"
+#include "graphics/drawList.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
+#include "graphics/model.h"
+#include "graphics/scene.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
+#include "resources/shaders.h"
 #include "data/rasterizer.h"
 #include "event/event.h"
 #include "math/math.h"
+#include "core/hash.h"
 #include "core/maf.h"
 #include "core/ref.h"
 #include "core/util.h"
@@ -16,8 +21,13 @@
 #include <math.h>
 
 #define MAX_TRANSFORMS 64
-#define MAX_BATCHES 4
-#define MAX_DRAWS 256
+#define MAX_BATCHES 16
+#define MAX_DRAWS 1024
+#define MAX_INSTANCES (1 << 14)
+#define MAX_GEOMETRY_VERTICES ((1 << 16) - 1)
+#define MAX_GEOMETRY_INDICES (1 << 17)
+#define MAX_GEOMETRY_CANDIDATES 4096
+#define STREAM_SEGMENTS 3
 
 typedef enum {
   STREAM_VERTEX,
@@ -25,6 +35,7 @@ typedef enum {
   STREAM_INDEX,
   STREAM_MODEL,
   STREAM_COLOR,
+  STREAM_INSTANCE,
   STREAM_FRAME,
   MAX_STREAMS
 } StreamType;
@@ -65,6 +76,7 @@ typedef struct {
   Material* material;
   Texture* texture;
   mat4 transform;
+  float* bounds;
   uint32_t vertexCount;
   uint32_t indexCount;
   float** vertices;
@@ -80,11 +92,73 @@ typedef struct {
   Material* material;
   mat4 transforms;
   Color* colors;
+  uint64_t key;
   uint32_t drawStart;
   uint32_t drawCount;
   bool indexed;
+  bool sortable;
+  bool streamed;
 } Batch;
 
+typedef struct {
+  arr_t(float) vertices;
+  arr_t(Color) colors;
+  arr_t(uint16_t) indices;
+  Material* material;
+  float transform[16];
+  DrawMode topology;
+  uint32_t vertexStart;
+  uint32_t indexStart;
+  bool indexed;
+  bool active;
+} Capture;
+
+typedef enum {
+  RECORD_REQUEST,
+  RECORD_DRAW,
+  RECORD_PRESENT
+} RecordType;
+
+typedef struct {
+  uint8_t type; // RecordType
+  uint8_t batchType; // BatchType
+  uint8_t topology; // DrawMode
+  uint8_t shader; // DefaultShader
+  bool instanced;
+  bool bounded;
+  uint32_t mesh;
+  uint32_t material;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t instances;
+  Pipeline pipeline;
+  BatchParams params;
+  Color color;
+  float transform[16];
+  float bounds[6];
+} Record;
+
+// Recordings are a header (magic, version, record count, object count) followed by variable length
+// records.  Each record starts with its type and only stores the fields that type uses, written
+// one at a time in little endian order.  Record is only the decoded form used during replay.
+#define RECORDING_VERSION 2
+#define RECORDING_HEADER_SIZE 16
+
+typedef struct {
+  arr_t(uint8_t) data;
+  map_t objects;
+  uint32_t objectCount;
+  uint32_t recordCount;
+  bool active;
+} Recording;
+
+typedef struct {
+  const uint8_t* data;
+  size_t size;
+  size_t cursor;
+  uint32_t objectCount;
+} RecordReader;
+
 typedef struct {
   float viewMatrix[2][16];
   float projection[2][16];
@@ -99,6 +173,8 @@ static struct {
   bool frameDataDirty;
   Canvas* defaultCanvas;
   Shader* defaultShaders[MAX_DEFAULT_SHADERS][2];
+  Shader* layeredShaders[MAX_DEFAULT_SHADERS][2];
+  Shader* cullShader;
   Material* defaultMaterial;
   Font* defaultFont;
   TextureFilter defaultFilter;
@@ -113,36 +189,45 @@ static struct {
   Pipeline pipeline;
   float pointSize;
   Shader* shader;
+  bool sorting;
+  bool frustumCulling;
+  Capture capture;
+  Recording recording;
   Mesh* mesh;
-  Mesh* instancedMesh;
-  Buffer* identityBuffer;
+  Mesh* geometryMesh;
+  map_t geometryCache;
+  map_t geometryCandidates;
+  uint32_t geometryVertexCount;
+  uint32_t geometryIndexCount;
   Buffer* buffers[MAX_STREAMS];
+  uint32_t bufferCount[MAX_STREAMS];
   uint32_t head[MAX_STREAMS];
   uint32_t tail[MAX_STREAMS];
-  Batch batches[MAX_BATCHES];
-  uint8_t batchCount;
+  uint32_t segment[MAX_STREAMS];
+  uint8_t pending[MAX_STREAMS];
+  uint8_t requestSegments[MAX_STREAMS];
+  bool batching;
+  void* locks[MAX_STREAMS][STREAM_SEGMENTS];
+  GpuStats stats;
+  Batch* batches;
+  uint16_t* batchOrder;
+  uint64_t* sortKeys;
+  arr_t(float)* instanceData;
+  uint32_t instanceCount;
+  uint32_t batchCount;
+  uint32_t flushedBatches;
+  uint64_t uploadedBytes;
+  uint32_t maxBatches;
+  uint32_t maxDraws;
 } state;
 
-static const uint32_t bufferCount[] = {
-  [STREAM_VERTEX] = (1 << 16) - 1,
-  [STREAM_DRAWID] = (1 << 16) - 1,
-  [STREAM_INDEX] = 1 << 16,
-#if defined(LOVR_WEBGL) // Work around bugs where big UBOs don't work
-  [STREAM_MODEL] = MAX_DRAWS,
-  [STREAM_COLOR] = MAX_DRAWS,
-#else
-  [STREAM_MODEL] = MAX_DRAWS * MAX_BATCHES,
-  [STREAM_COLOR] = MAX_DRAWS * MAX_BATCHES,
-#endif
-  [STREAM_FRAME] = 4
-};
-
 static const size_t bufferStride[] = {
   [STREAM_VERTEX] = 8 * sizeof(float),
-  [STREAM_DRAWID] = sizeof(uint8_t),
+  [STREAM_DRAWID] = sizeof(uint16_t),
   [STREAM_INDEX] = sizeof(uint16_t),
   [STREAM_MODEL] = 16 * sizeof(float),
   [STREAM_COLOR] = 4 * sizeof(float),
+  [STREAM_INSTANCE] = 20 * sizeof(float),
   [STREAM_FRAME] = sizeof(FrameData)
 };
 
@@ -152,6 +237,7 @@ static const BufferType bufferType[] = {
   [STREAM_INDEX] = BUFFER_INDEX,
   [STREAM_MODEL] = BUFFER_UNIFORM,
   [STREAM_COLOR] = BUFFER_UNIFORM,
+  [STREAM_INSTANCE] = BUFFER_VERTEX,
   [STREAM_FRAME] = BUFFER_UNIFORM
 };
 
@@ -161,6 +247,264 @@ static void gammaCorrect(Color* color) {
   color->b = lovrMathGammaToLinear(color->b);
 }
 
+static void writeU8(uint8_t x) {
+  arr_push(&state.recording.data, x);
+}
+
+static void writeU32(uint32_t x) {
+  uint8_t bytes[4] = { x & 0xff, (x >> 8) & 0xff, (x >> 16) & 0xff, (x >> 24) & 0xff };
+  arr_append(&state.recording.data, bytes, 4);
+}
+
+static void writeFloats(const float* x, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    union { float f; uint32_t u; } bits = { .f = x[i] };
+    writeU32(bits.u);
+  }
+}
+
+static uint8_t readU8(RecordReader* reader) {
+  lovrAssert(reader->cursor + 1 <= reader->size, "Recording is truncated");
+  return reader->data[reader->cursor++];
+}
+
+static uint32_t readU32(RecordReader* reader) {
+  lovrAssert(reader->cursor + 4 <= reader->size, "Recording is truncated");
+  const uint8_t* p = reader->data + reader->cursor;
+  reader->cursor += 4;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void readFloats(RecordReader* reader, float* x, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    union { float f; uint32_t u; } bits = { .u = readU32(reader) };
+    x[i] = bits.f;
+  }
+}
+
+static void writePipeline(Pipeline* pipeline) {
+  uint32_t bits = 0;
+  bits |= pipeline->alphaSampling << 0;
+  bits |= pipeline->blendMode << 1;
+  bits |= pipeline->blendAlphaMode << 4;
+  bits |= pipeline->colorMask << 5;
+  bits |= pipeline->culling << 9;
+  bits |= pipeline->depthTest << 10;
+  bits |= pipeline->depthWrite << 13;
+  bits |= pipeline->stencilValue << 14;
+  bits |= pipeline->stencilMode << 22;
+  bits |= pipeline->winding << 25;
+  bits |= pipeline->wireframe << 26;
+  writeFloats(&pipeline->lineWidth, 1);
+  writeU32(bits);
+}
+
+static void readPipeline(RecordReader* reader, Pipeline* pipeline) {
+  readFloats(reader, &pipeline->lineWidth, 1);
+  uint32_t bits = readU32(reader);
+  pipeline->alphaSampling = (bits >> 0) & 0x1;
+  pipeline->blendMode = (bits >> 1) & 0x7;
+  pipeline->blendAlphaMode = (bits >> 4) & 0x1;
+  pipeline->colorMask = (bits >> 5) & 0xf;
+  pipeline->culling = (bits >> 9) & 0x1;
+  pipeline->depthTest = (bits >> 10) & 0x7;
+  pipeline->depthWrite = (bits >> 13) & 0x1;
+  pipeline->stencilValue = (bits >> 14) & 0xff;
+  pipeline->stencilMode = (bits >> 22) & 0x7;
+  pipeline->winding = (bits >> 25) & 0x1;
+  pipeline->wireframe = (bits >> 26) & 0x1;
+}
+
+static void lovrGraphicsWriteRecord(Record* record) {
+  state.recording.recordCount++;
+  writeU8(record->type);
+
+  if (record->type == RECORD_PRESENT) {
+    return;
+  } else if (record->type == RECORD_DRAW) {
+    writeU8(record->topology);
+    writeU32(record->mesh);
+    writeU32(record->vertexCount);
+    writeU32(record->instances);
+    return;
+  }
+
+  BatchParams* params = &record->params;
+  writeU8(record->batchType);
+  writeU8(record->topology);
+  writeU8(record->shader);
+  writeU8(record->instanced | (record->bounded << 1));
+  writeU32(record->mesh);
+  writeU32(record->material);
+  writeU32(record->vertexCount);
+  writeU32(record->indexCount);
+  writePipeline(&record->pipeline);
+  writeFloats(&record->color.r, 4);
+  writeFloats(record->transform, 16);
+
+  if (record->bounded) {
+    writeFloats(record->bounds, 6);
+  }
+
+  switch (record->batchType) {
+    case BATCH_TRIANGLES: writeU8(params->triangles.style); break;
+    case BATCH_PLANE: writeU8(params->plane.style); break;
+    case BATCH_BOX: writeU8(params->box.style); break;
+    case BATCH_ARC:
+      writeU8(params->arc.style);
+      writeU8(params->arc.mode);
+      writeFloats(&params->arc.r1, 1);
+      writeFloats(&params->arc.r2, 1);
+      writeU32(params->arc.segments);
+      break;
+    case BATCH_SPHERE: writeU32(params->sphere.segments); break;
+    case BATCH_CYLINDER:
+      writeFloats(&params->cylinder.r1, 1);
+      writeFloats(&params->cylinder.r2, 1);
+      writeU8(params->cylinder.capped);
+      writeU32(params->cylinder.segments);
+      break;
+    case BATCH_FILL:
+      writeFloats(&params->fill.u, 1);
+      writeFloats(&params->fill.v, 1);
+      writeFloats(&params->fill.w, 1);
+      writeFloats(&params->fill.h, 1);
+      break;
+    case BATCH_MESH:
+      writeU32(params->mesh.rangeStart);
+      writeU32(params->mesh.rangeCount);
+      writeU32(params->mesh.instances);
+      break;
+    default: break;
+  }
+}
+
+// Recordings are untrusted, so anything that ends up indexing an array, sizing a stream mapping, or
+// reaching GL as an enum is checked before a request is replayed.
+static void lovrGraphicsValidateRecord(RecordReader* reader, Record* record) {
+  BatchParams* params = &record->params;
+  Pipeline* pipeline = &record->pipeline;
+  uint64_t vertexCount = record->vertexCount;
+  uint64_t indexCount = record->indexCount;
+  uint64_t segments = 0;
+
+  lovrAssert(record->batchType <= BATCH_MESH, "Invalid recording");
+  lovrAssert(record->topology <= DRAW_TRIANGLE_FAN, "Invalid recording");
+  lovrAssert(record->shader < MAX_DEFAULT_SHADERS, "Invalid recording");
+  lovrAssert(record->mesh <= reader->objectCount && record->material <= reader->objectCount, "Invalid recording");
+  lovrAssert(pipeline->depthTest <= COMPARE_NONE && pipeline->stencilMode <= COMPARE_NONE, "Invalid recording");
+  lovrAssert(pipeline->lineWidth > 0.f, "Invalid recording");
+
+  // Primitives are replayed through the public functions, which size their own requests
+  switch (record->batchType) {
+    case BATCH_LINES: indexCount = vertexCount + 1; break;
+    case BATCH_TRIANGLES:
+      lovrAssert(params->triangles.style <= STYLE_LINE, "Invalid recording");
+      indexCount = params->triangles.style == STYLE_LINE ? 4 * vertexCount / 3 : 0;
+      break;
+    case BATCH_PLANE: lovrAssert(params->plane.style <= STYLE_LINE, "Invalid recording"); break;
+    case BATCH_BOX: lovrAssert(params->box.style <= STYLE_LINE, "Invalid recording"); break;
+    case BATCH_ARC:
+      lovrAssert(params->arc.style <= STYLE_LINE && params->arc.mode <= ARC_MODE_CLOSED, "Invalid recording");
+      segments = params->arc.segments;
+      vertexCount = segments + 2;
+      indexCount = 0;
+      break;
+    case BATCH_SPHERE:
+      segments = params->sphere.segments;
+      vertexCount = (segments + 1) * (segments + 1);
+      indexCount = segments * segments * 6;
+      break;
+    case BATCH_CYLINDER:
+      segments = params->cylinder.segments;
+      vertexCount = 4 * (segments + 2);
+      indexCount = 12 * segments;
+      break;
+    case BATCH_MESH: {
+      lovrAssert(record->mesh > 0 && vertexCount > 0, "Invalid recording");
+      uint64_t limit = indexCount > 0 ? indexCount : vertexCount;
+      lovrAssert((uint64_t) params->mesh.rangeStart + params->mesh.rangeCount <= limit, "Invalid recording");
+      return;
+    }
+    default: break;
+  }
+
+  lovrAssert(segments <= 0xffff, "Invalid recording");
+  lovrAssert(vertexCount <= state.bufferCount[STREAM_VERTEX] && indexCount <= state.bufferCount[STREAM_INDEX], "Invalid recording");
+}
+
+static void lovrGraphicsReadRecord(RecordReader* reader, Record* record) {
+  memset(record, 0, sizeof(*record));
+  record->type = readU8(reader);
+
+  if (record->type == RECORD_PRESENT) {
+    return;
+  } else if (record->type == RECORD_DRAW) {
+    record->topology = readU8(reader);
+    record->mesh = readU32(reader);
+    record->vertexCount = readU32(reader);
+    record->instances = readU32(reader);
+    lovrAssert(record->topology <= DRAW_TRIANGLE_FAN, "Invalid recording");
+    return;
+  }
+
+  lovrAssert(record->type == RECORD_REQUEST, "Invalid recording");
+  BatchParams* params = &record->params;
+  record->batchType = readU8(reader);
+  record->topology = readU8(reader);
+  record->shader = readU8(reader);
+  uint8_t flags = readU8(reader);
+  record->instanced = flags & 1;
+  record->bounded = flags & 2;
+  record->mesh = readU32(reader);
+  record->material = readU32(reader);
+  record->vertexCount = readU32(reader);
+  record->indexCount = readU32(reader);
+  readPipeline(reader, &record->pipeline);
+  readFloats(reader, &record->color.r, 4);
+  readFloats(reader, record->transform, 16);
+
+  if (record->bounded) {
+    readFloats(reader, record->bounds, 6);
+  }
+
+  switch (record->batchType) {
+    case BATCH_TRIANGLES: params->triangles.style = readU8(reader); break;
+    case BATCH_PLANE: params->plane.style = readU8(reader); break;
+    case BATCH_BOX: params->box.style = readU8(reader); break;
+    case BATCH_ARC:
+      params->arc.style = readU8(reader);
+      params->arc.mode = readU8(reader);
+      readFloats(reader, &params->arc.r1, 1);
+      readFloats(reader, &params->arc.r2, 1);
+      params->arc.segments = readU32(reader);
+      break;
+    case BATCH_SPHERE: params->sphere.segments = readU32(reader); break;
+    case BATCH_CYLINDER:
+      readFloats(reader, &params->cylinder.r1, 1);
+      readFloats(reader, &params->cylinder.r2, 1);
+      params->cylinder.capped = readU8(reader);
+      params->cylinder.segments = readU32(reader);
+      break;
+    case BATCH_FILL:
+      readFloats(reader, &params->fill.u, 1);
+      readFloats(reader, &params->fill.v, 1);
+      readFloats(reader, &params->fill.w, 1);
+      readFloats(reader, &params->fill.h, 1);
+      break;
+    case BATCH_MESH:
+      params->mesh.rangeStart = readU32(reader);
+      params->mesh.rangeCount = readU32(reader);
+      params->mesh.instances = readU32(reader);
+      record->instances = params->mesh.instances;
+      break;
+    default: break;
+  }
+
+  lovrGraphicsValidateRecord(reader, record);
+}
+
+#ifndef LOVR_NULL
 static void onCloseWindow(void) {
   lovrEventPush((Event) { .type = EVENT_QUIT, .data.quit = { .exitCode = 0 } });
 }
@@ -171,20 +515,110 @@ static void onResizeWindow(int width, int height) {
   lovrCanvasSetWidth(state.defaultCanvas, width);
   lovrCanvasSetHeight(state.defaultCanvas, height);
 }
+#endif
 
+// Streams are rings split into a few segments.  Each segment is locked after the draws that read
+// from it are submitted, and the lock is waited on before the segment gets written again, so the
+// buffers never need to be orphaned.  A segment only has to be flushed early if the ring wraps
+// all the way around before the draws using it were submitted.  The segment currently being written
+// can be skipped, unless the ring wrapped and came back around to it.
 static void* lovrGraphicsMapBuffer(StreamType type, uint32_t count) {
-  lovrAssert(count <= bufferCount[type], "Whoa there!  Tried to get %d elements from a buffer that only has %d elements.", count, bufferCount[type]);
+  uint32_t size = state.bufferCount[type];
+  lovrAssert(count <= size, "Whoa there!  Tried to get %d elements from a buffer that only has %d elements.", count, size);
 
-  if (state.head[type] + count > bufferCount[type]) {
-    lovrGraphicsFlush();
-    lovrBufferDiscard(state.buffers[type]);
+  bool wrapped = false;
+  if (state.head[type] + count > size) {
+    lovrBufferFlush(state.buffers[type], state.tail[type] * bufferStride[type], (state.head[type] - state.tail[type]) * bufferStride[type]);
     state.tail[type] = 0;
     state.head[type] = 0;
+    state.stats.streamWraps++;
+    wrapped = true;
+  }
+
+  uint32_t first = state.head[type] * STREAM_SEGMENTS / size;
+  uint32_t last = (state.head[type] + MAX(count, 1) - 1) * STREAM_SEGMENTS / size;
+  for (uint32_t i = first; i <= last; i++) {
+    if (i == state.segment[type] && !wrapped) {
+      continue;
+    }
+
+    if (state.pending[type] & (1 << i)) {
+      lovrGraphicsFlush();
+    }
+
+    if (state.locks[type][i]) {
+      lovrGpuUnlock(state.locks[type][i]);
+      lovrGpuDestroyLock(state.locks[type][i]);
+      state.locks[type][i] = NULL;
+    }
+  }
+
+  for (uint32_t i = first; i <= last; i++) {
+    state.pending[type] |= (1 << i);
+    state.requestSegments[type] |= state.batching ? (1 << i) : 0;
   }
 
+  state.segment[type] = last;
   return lovrBufferMap(state.buffers[type], state.head[type] * bufferStride[type]);
 }
 
+// Opaque batches are ordered by state first, most expensive change in the high bits, and then
+// front to back.  Objects are hashed down to a few bits, so collisions only make the order worse.
+static uint64_t getSortKey(Canvas* canvas, Shader* shader, Material* material, Mesh* mesh, Pipeline* pipeline, mat4 transform) {
+  float* view = state.camera.viewMatrix[0];
+  float depth = -(view[2] * transform[12] + view[6] * transform[13] + view[10] * transform[14] + view[14]);
+  union { float f; uint32_t u; } bits = { .f = MAX(depth, 0.f) }; // Positive floats sort like ints
+  uint64_t key = 0;
+  key |= (hash64(&canvas, sizeof(canvas)) & 0x3f) << 58;
+  key |= (hash64(&shader, sizeof(shader)) & 0xfff) << 46;
+  key |= (hash64(&material, sizeof(material)) & 0xfff) << 34;
+  key |= (hash64(&mesh, sizeof(mesh)) & 0x3ff) << 24;
+  key |= (hash64(pipeline, sizeof(Pipeline)) & 0xff) << 16;
+  key |= bits.u >> 16;
+  return key;
+}
+
+// Stable LSD radix sort, 8 bits per pass, skipping passes where every key has the same digit.
+// Only the draw order is sorted, the batches themselves stay put.
+static void sortBatches(uint16_t* order, uint32_t count) {
+  uint64_t* keys[2] = { state.sortKeys, state.sortKeys + state.maxBatches };
+  uint16_t* orders[2] = { order, state.batchOrder + state.maxBatches };
+  int src = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    keys[0][i] = state.batches[order[i]].key;
+  }
+
+  for (int shift = 0; shift < 64; shift += 8) {
+    uint32_t offsets[256] = { 0 };
+    for (uint32_t i = 0; i < count; i++) {
+      offsets[(keys[src][i] >> shift) & 0xff]++;
+    }
+
+    if (offsets[(keys[src][0] >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    for (uint32_t d = 0, offset = 0; d < 256; d++) {
+      uint32_t n = offsets[d];
+      offsets[d] = offset;
+      offset += n;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t j = offsets[(keys[src][i] >> shift) & 0xff]++;
+      keys[!src][j] = keys[src][i];
+      orders[!src][j] = orders[src][i];
+    }
+
+    src = !src;
+  }
+
+  if (src) {
+    memcpy(order, orders[1], count * sizeof(uint16_t));
+  }
+}
+
 // Base
 
 bool lovrGraphicsInit() {
@@ -193,62 +627,112 @@ bool lovrGraphicsInit() {
 
 void lovrGraphicsDestroy() {
   if (!state.initialized) return;
+  lovrModelDestroyWorkers();
   lovrGraphicsSetShader(NULL);
   lovrGraphicsSetFont(NULL);
   lovrGraphicsSetCanvas(NULL);
   for (int i = 0; i < MAX_DEFAULT_SHADERS; i++) {
     lovrRelease(Shader, state.defaultShaders[i][false]);
     lovrRelease(Shader, state.defaultShaders[i][true]);
+    lovrRelease(Shader, state.layeredShaders[i][false]);
+    lovrRelease(Shader, state.layeredShaders[i][true]);
   }
+  lovrRelease(Shader, state.cullShader);
   for (int i = 0; i < MAX_STREAMS; i++) {
     lovrRelease(Buffer, state.buffers[i]);
+    for (int j = 0; j < STREAM_SEGMENTS; j++) {
+      lovrGpuDestroyLock(state.locks[i][j]);
+    }
   }
   lovrRelease(Mesh, state.mesh);
-  lovrRelease(Mesh, state.instancedMesh);
-  lovrRelease(Buffer, state.identityBuffer);
+  lovrRelease(Mesh, state.geometryMesh);
+  map_free(&state.geometryCache);
+  map_free(&state.geometryCandidates);
   lovrRelease(Material, state.defaultMaterial);
   lovrRelease(Font, state.defaultFont);
   lovrRelease(Canvas, state.defaultCanvas);
+  free(state.batches);
+  free(state.batchOrder);
+  free(state.sortKeys);
+  for (uint32_t i = 0; i < state.maxBatches; i++) {
+    arr_free(&state.instanceData[i]);
+  }
+  free(state.instanceData);
+  arr_free(&state.capture.vertices);
+  arr_free(&state.capture.colors);
+  arr_free(&state.capture.indices);
+  lovrRelease(Material, state.capture.material);
+  arr_free(&state.recording.data);
+  map_free(&state.recording.objects);
   lovrGpuDestroy();
   memset(&state, 0, sizeof(state));
 }
 
 void lovrGraphicsPresent() {
+  if (state.recording.active) {
+    lovrGraphicsWriteRecord(&(Record) { .type = RECORD_PRESENT });
+  }
+
   lovrGraphicsFlush();
+#ifndef LOVR_NULL
   lovrPlatformSwapBuffers();
+#endif
   lovrGpuPresent();
+  state.stats.streamWraps = 0;
+  state.stats.culledDraws = 0;
 }
 
-void lovrGraphicsCreateWindow(WindowFlags* flags) {
+void lovrGraphicsCreateWindow(WindowFlags* flags, StereoMode stereo) {
   lovrAssert(!state.initialized, "Window is already created");
+#ifdef LOVR_NULL // Headless, the window size only determines the size of the default Canvas
+  state.width = flags->width > 0 ? flags->width : 1080;
+  state.height = flags->height > 0 ? flags->height : 600;
+  lovrGpuInit(NULL, stereo);
+#else
   lovrAssert(lovrPlatformCreateWindow(flags), "Could not create window");
   lovrPlatformOnWindowClose(onCloseWindow);
   lovrPlatformOnWindowResize(onResizeWindow);
   lovrPlatformGetFramebufferSize(&state.width, &state.height);
-  lovrGpuInit(lovrPlatformGetProcAddress);
+  lovrGpuInit(lovrPlatformGetProcAddress, stereo);
+#endif
+
+  // Draws in a batch are limited by how many transforms fit in a uniform block, and the number of
+  // batches is limited by how many of those blocks fit in the transform stream.
+  state.maxDraws = MIN(lovrGpuGetLimits()->blockSize / (16 * sizeof(float)), MAX_DRAWS);
+#ifdef LOVR_WEBGL // Work around bugs where big UBOs don't work
+  state.maxBatches = 1;
+#else
+  state.maxBatches = MAX_BATCHES;
+#endif
+
+  state.bufferCount[STREAM_VERTEX] = (1 << 16) - 1;
+  state.bufferCount[STREAM_DRAWID] = (1 << 16) - 1;
+  state.bufferCount[STREAM_INDEX] = 1 << 16;
+  state.bufferCount[STREAM_MODEL] = state.maxDraws * state.maxBatches;
+  state.bufferCount[STREAM_COLOR] = state.maxDraws * state.maxBatches;
+  state.bufferCount[STREAM_INSTANCE] = MAX_INSTANCES;
+  state.bufferCount[STREAM_FRAME] = 4;
+
+  state.batches = malloc(state.maxBatches * sizeof(Batch));
+  state.batchOrder = malloc(2 * state.maxBatches * sizeof(uint16_t));
+  state.sortKeys = malloc(2 * state.maxBatches * sizeof(uint64_t));
+  state.instanceData = calloc(state.maxBatches, sizeof(*state.instanceData));
+  lovrAssert(state.batches && state.batchOrder && state.sortKeys && state.instanceData, "Out of memory");
 
   state.defaultCanvas = lovrCanvasCreateFromHandle(state.width, state.height, (CanvasFlags) { .stereo = false }, 0, 0, 0, 1, true);
 
   for (int i = 0; i < MAX_STREAMS; i++) {
-    state.buffers[i] = lovrBufferCreate(bufferCount[i] * bufferStride[i], NULL, bufferType[i], USAGE_STREAM, false);
+    state.buffers[i] = lovrBufferCreate(state.bufferCount[i] * bufferStride[i], NULL, bufferType[i], USAGE_STREAM, false);
+    state.stats.streamMemory += state.bufferCount[i] * bufferStride[i];
   }
 
-  // The identity buffer is used for autoinstanced meshes and instanced primitives and maps the
-  // instance ID to a vertex attribute.  Its contents never change, so they are initialized here.
-  state.identityBuffer = lovrBufferCreate(MAX_DRAWS * sizeof(uint8_t), NULL, BUFFER_VERTEX, USAGE_STATIC, false);
-  uint8_t* id = lovrBufferMap(state.identityBuffer, 0);
-  for (int i = 0; i < MAX_DRAWS; i++) id[i] = i;
-  lovrBufferFlush(state.identityBuffer, 0, MAX_DRAWS);
-  lovrBufferUnmap(state.identityBuffer);
-
   Buffer* vertexBuffer = state.buffers[STREAM_VERTEX];
   size_t stride = bufferStride[STREAM_VERTEX];
 
   MeshAttribute position = { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 };
   MeshAttribute normal = { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 };
   MeshAttribute texCoord = { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 };
-  MeshAttribute drawId = { .buffer = state.buffers[STREAM_DRAWID], .type = U8, .components = 1, .integer = true };
-  MeshAttribute identity = { .buffer = state.identityBuffer, .type = U8, .components = 1, .divisor = 1, .integer = true };
+  MeshAttribute drawId = { .buffer = state.buffers[STREAM_DRAWID], .type = U16, .components = 1, .integer = true };
 
   state.mesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
   lovrMeshAttachAttribute(state.mesh, "lovrPosition", &position);
@@ -256,11 +740,37 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
   lovrMeshAttachAttribute(state.mesh, "lovrTexCoord", &texCoord);
   lovrMeshAttachAttribute(state.mesh, "lovrDrawID", &drawId);
 
-  state.instancedMesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrPosition", &position);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrNormal", &normal);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrTexCoord", &texCoord);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrDrawID", &identity);
+  Buffer* geometryVertices = lovrBufferCreate(MAX_GEOMETRY_VERTICES * stride, NULL, BUFFER_VERTEX, USAGE_STATIC, false);
+  Buffer* geometryIndices = lovrBufferCreate(MAX_GEOMETRY_INDICES * sizeof(uint16_t), NULL, BUFFER_INDEX, USAGE_STATIC, false);
+  position.buffer = normal.buffer = texCoord.buffer = geometryVertices;
+
+  state.geometryMesh = lovrMeshCreate(DRAW_TRIANGLES, geometryVertices, MAX_GEOMETRY_VERTICES);
+  lovrMeshAttachAttribute(state.geometryMesh, "lovrPosition", &position);
+  lovrMeshAttachAttribute(state.geometryMesh, "lovrNormal", &normal);
+  lovrMeshAttachAttribute(state.geometryMesh, "lovrTexCoord", &texCoord);
+  lovrMeshSetIndexBuffer(state.geometryMesh, geometryIndices, MAX_GEOMETRY_INDICES, sizeof(uint16_t), 0);
+  lovrRelease(Buffer, geometryVertices);
+  lovrRelease(Buffer, geometryIndices);
+  map_init(&state.geometryCache, 64);
+  map_init(&state.geometryCandidates, 64);
+
+  // When the driver compiles shaders in the background, start on the default shaders now instead of
+  // stalling the first frame that draws with each one.  The standard shader is never used by default.
+  // The stereo variants only have different code with multiview, otherwise they share the shader.
+  if (lovrGpuGetFeatures()->parallelCompile) {
+    bool multiview = lovrGpuGetStereoMode() == STEREO_MULTIVIEW;
+    for (int i = 0; i < MAX_DEFAULT_SHADERS; i++) {
+      if (i != SHADER_STANDARD) {
+        state.defaultShaders[i][false] = lovrShaderCreateDefault(i, NULL, 0, false);
+        if (multiview) {
+          state.defaultShaders[i][true] = lovrShaderCreateDefault(i, NULL, 0, true);
+        } else {
+          state.defaultShaders[i][true] = state.defaultShaders[i][false];
+          lovrRetain(state.defaultShaders[i][true]);
+        }
+      }
+    }
+  }
 
   lovrGraphicsReset();
   state.initialized = true;
@@ -275,14 +785,18 @@ int lovrGraphicsGetHeight() {
 }
 
 float lovrGraphicsGetPixelDensity() {
-  int width, framebufferWidth;
-  lovrPlatformGetWindowSize(&width, NULL);
-  lovrPlatformGetFramebufferSize(&framebufferWidth, NULL);
+#ifdef LOVR_NULL // Headless, the default Canvas is sized in pixels
+  return 1.f;
+#else
+  int width, height, framebufferWidth, framebufferHeight;
+  lovrPlatformGetWindowSize(&width, &height);
+  lovrPlatformGetFramebufferSize(&framebufferWidth, &framebufferHeight);
   if (width == 0 || framebufferWidth == 0) {
     return 0.f;
   } else {
     return (float) framebufferWidth / (float) width;
   }
+#endif
 }
 
 const Camera* lovrGraphicsGetCamera() {
@@ -321,14 +835,28 @@ void lovrGraphicsSetCamera(Camera* camera, bool clear) {
   }
 }
 
-Buffer* lovrGraphicsGetIdentityBuffer() {
-  return state.identityBuffer;
+uint32_t lovrGraphicsGetMaxDraws() {
+  return state.maxDraws;
+}
+
+const GpuStats* lovrGraphicsGetStats() {
+  uint32_t streamWraps = state.stats.streamWraps;
+  uint64_t streamMemory = state.stats.streamMemory;
+  uint32_t culledDraws = state.stats.culledDraws;
+  state.stats = *lovrGpuGetStats();
+  state.stats.streamWraps = streamWraps;
+  state.stats.streamMemory = streamMemory;
+  state.stats.culledDraws = culledDraws;
+  return &state.stats;
 }
 
 // State
 
 void lovrGraphicsReset() {
   state.transform = 0;
+  state.capture.active = false;
+  lovrRelease(Material, state.capture.material);
+  state.capture.material = NULL;
   lovrGraphicsSetCamera(NULL, false);
   lovrGraphicsSetAlphaSampling(false);
   lovrGraphicsSetBackgroundColor((Color) { 0, 0, 0, 1 });
@@ -340,9 +868,11 @@ void lovrGraphicsReset() {
   lovrGraphicsSetDefaultFilter((TextureFilter) { .mode = FILTER_TRILINEAR });
   lovrGraphicsSetDepthTest(COMPARE_LEQUAL, true);
   lovrGraphicsSetFont(NULL);
+  lovrGraphicsSetFrustumCullingEnabled(false);
   lovrGraphicsSetLineWidth(1.f);
   lovrGraphicsSetPointSize(1.f);
   lovrGraphicsSetShader(NULL);
+  lovrGraphicsSetSortingEnabled(false);
   lovrGraphicsSetStencilTest(COMPARE_NONE, 0);
   lovrGraphicsSetWinding(WINDING_COUNTERCLOCKWISE);
   lovrGraphicsSetWireframe(false);
@@ -458,6 +988,14 @@ void lovrGraphicsSetFont(Font* font) {
   state.font = font;
 }
 
+bool lovrGraphicsIsFrustumCullingEnabled() {
+  return state.frustumCulling;
+}
+
+void lovrGraphicsSetFrustumCullingEnabled(bool culling) {
+  state.frustumCulling = culling;
+}
+
 float lovrGraphicsGetLineWidth() {
   return state.pipeline.lineWidth;
 }
@@ -485,6 +1023,14 @@ void lovrGraphicsSetShader(Shader* shader) {
   state.shader = shader;
 }
 
+bool lovrGraphicsIsSortingEnabled() {
+  return state.sorting;
+}
+
+void lovrGraphicsSetSortingEnabled(bool sorting) {
+  state.sorting = sorting;
+}
+
 void lovrGraphicsGetStencilTest(CompareMode* mode, int* value) {
   *mode = state.pipeline.stencilMode;
   *value = state.pipeline.stencilValue;
@@ -555,40 +1101,390 @@ void lovrGraphicsSetProjection(mat4 projection) {
 
 // Rendering
 
+// Transforms the corners of a local bounding box into clip space and checks whether they're all
+// outside one of the clip planes, for every view.
+bool lovrGraphicsIsCulled(float aabb[6], mat4 transform) {
+  if (!state.frustumCulling) {
+    return false;
+  }
+
+  float model[16];
+  mat4_init(model, state.transforms[state.transform]);
+  if (transform) {
+    mat4_multiply(model, transform);
+  }
+
+  Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_multiply(mat4_multiply(mat4_init(m, state.camera.projection[i]), state.camera.viewMatrix[i]), model);
+
+    uint8_t outside = 0x3f;
+    for (uint32_t j = 0; j < 8 && outside; j++) {
+      float x = aabb[0 + ((j >> 0) & 1)];
+      float y = aabb[2 + ((j >> 1) & 1)];
+      float z = aabb[4 + ((j >> 2) & 1)];
+      float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+      float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+      float cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+      float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+      uint8_t planes = 0;
+      planes |= (cx < -cw) << 0;
+      planes |= (cx > cw) << 1;
+      planes |= (cy < -cw) << 2;
+      planes |= (cy > cw) << 3;
+      planes |= (cz < -cw) << 4;
+      planes |= (cz > cw) << 5;
+      outside &= planes;
+    }
+
+    if (!outside) {
+      return false;
+    }
+  }
+
+  state.stats.culledDraws++;
+  return true;
+}
+
+// Estimates the height of an AABB's bounding sphere on screen, as a fraction of the viewport height,
+// using the largest size across views.  Cameras inside the sphere get an infinite size.
+float lovrGraphicsGetScreenSize(float aabb[6], mat4 transform) {
+  float model[16];
+  mat4_init(model, state.transforms[state.transform]);
+  if (transform) {
+    mat4_multiply(model, transform);
+  }
+
+  float sx = model[0] * model[0] + model[1] * model[1] + model[2] * model[2];
+  float sy = model[4] * model[4] + model[5] * model[5] + model[6] * model[6];
+  float sz = model[8] * model[8] + model[9] * model[9] + model[10] * model[10];
+  float scale = MAX(sx, sy);
+  scale = MAX(scale, sz);
+
+  float dx = aabb[1] - aabb[0];
+  float dy = aabb[3] - aabb[2];
+  float dz = aabb[5] - aabb[4];
+  float radius = .5f * sqrtf(dx * dx + dy * dy + dz * dz) * sqrtf(scale);
+
+  Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+  float size = 0.f;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    float center[3] = { (aabb[0] + aabb[1]) / 2.f, (aabb[2] + aabb[3]) / 2.f, (aabb[4] + aabb[5]) / 2.f };
+    mat4_transform(mat4_multiply(mat4_init(m, state.camera.viewMatrix[i]), model), center);
+
+    float* projection = state.camera.projection[i];
+    float viewSize;
+    if (projection[15] == 1.f) { // Orthographic
+      viewSize = radius * projection[5];
+    } else if (-center[2] > radius) {
+      viewSize = radius * projection[5] / -center[2];
+    } else {
+      return HUGE_VALF;
+    }
+
+    size = MAX(size, viewSize);
+  }
+
+  return size;
+}
+
+// Requests write their vertices after they've been captured, so the transform and topology of the
+// most recent request are applied right before the next one is captured or when the capture ends.
+static void lovrGraphicsResolveCapture() {
+  Capture* capture = &state.capture;
+  uint32_t vertexCount = (uint32_t) capture->vertices.length / 8;
+
+  if (capture->vertexStart == vertexCount) {
+    return;
+  }
+
+  float normalMatrix[16];
+  mat4_transpose(mat4_invert(mat4_set(normalMatrix, capture->transform)));
+
+  for (uint32_t i = capture->vertexStart; i < vertexCount; i++) {
+    float* vertex = capture->vertices.data + 8 * i;
+    mat4_transform(capture->transform, vertex);
+    mat4_transformDirection(normalMatrix, vertex + 3);
+    if (vec3_length(vertex + 3) > 0.f) {
+      vec3_normalize(vertex + 3);
+    }
+  }
+
+  // Everything is baked into a triangle list, so restart indices are dropped and fans are unrolled
+  if (capture->indexed) {
+    size_t count = capture->indexStart;
+    for (size_t i = capture->indexStart; i < capture->indices.length; i++) {
+      if (capture->indices.data[i] != 0xffff) {
+        capture->indices.data[count++] = capture->indices.data[i];
+      }
+    }
+    capture->indices.length = count;
+  } else if (capture->topology == DRAW_TRIANGLE_FAN) {
+    for (uint32_t i = capture->vertexStart + 1; i + 1 < vertexCount; i++) {
+      uint16_t triangle[3] = { capture->vertexStart, i, i + 1 };
+      arr_append(&capture->indices, triangle, 3);
+    }
+  } else {
+    for (uint32_t i = capture->vertexStart; i < vertexCount; i++) {
+      arr_push(&capture->indices, i);
+    }
+  }
+
+  capture->vertexStart = vertexCount;
+  capture->indexStart = (uint32_t) capture->indices.length;
+}
+
+static void lovrGraphicsCapture(BatchRequest* req) {
+  Capture* capture = &state.capture;
+
+  bool filled = req->topology == DRAW_TRIANGLES || req->topology == DRAW_TRIANGLE_FAN;
+  switch (req->type) {
+    case BATCH_TRIANGLES: case BATCH_PLANE: case BATCH_BOX: case BATCH_ARC: case BATCH_SPHERE: case BATCH_CYLINDER: break;
+    default: filled = false; break;
+  }
+
+  lovrAssert(filled, "Only filled primitives can be captured");
+  lovrAssert(!req->material || !capture->material || req->material == capture->material, "Captured primitives must all use the same Material");
+
+  if (req->material && !capture->material) {
+    capture->material = req->material;
+    lovrRetain(capture->material);
+  }
+
+  lovrGraphicsResolveCapture();
+
+  uint32_t vertexCount = (uint32_t) capture->vertices.length / 8;
+  lovrAssert(vertexCount + req->vertexCount < 0xffff, "Too many vertices were captured (the maximum is %d)", 0xffff - 1);
+
+  mat4_init(capture->transform, state.transforms[state.transform]);
+  if (req->transform) {
+    mat4_multiply(capture->transform, req->transform);
+  }
+
+  capture->topology = req->topology;
+  capture->indexed = req->indexCount > 0;
+
+  arr_reserve(&capture->vertices, capture->vertices.length + 8 * req->vertexCount);
+  *(req->vertices) = capture->vertices.data + capture->vertices.length;
+  capture->vertices.length += 8 * req->vertexCount;
+
+  for (uint32_t i = 0; i < req->vertexCount; i++) {
+    arr_push(&capture->colors, state.linearColor);
+  }
+
+  if (req->indexCount > 0) {
+    arr_reserve(&capture->indices, capture->indices.length + req->indexCount);
+    *(req->indices) = capture->indices.data + capture->indices.length;
+    *(req->baseVertex) = vertexCount;
+    capture->indices.length += req->indexCount;
+  }
+}
+
+// Arcs, spheres, and cylinders are tessellated once into a static buffer and drawn from there.
+// Nothing is evicted, once the buffer fills up any new shapes go back to being streamed.  Shapes are
+// only cached the second time they're drawn, so animating a radius or an angle doesn't fill the
+// buffer with shapes that are never drawn again.  The shapes seen once are forgotten now and then.
+static bool lovrGraphicsCacheGeometry(BatchRequest* req, uint32_t* rangeStart, uint32_t* rangeCount) {
+  struct { BatchType type; BatchParams params; } key;
+  memset(&key, 0, sizeof(key));
+  key.type = req->type;
+  key.params = req->params;
+  uint64_t hash = hash64(&key, sizeof(key));
+  uint64_t range = map_get(&state.geometryCache, hash);
+
+  if (range != MAP_NIL) {
+    *rangeStart = range >> 32;
+    *rangeCount = range & 0xffffffff;
+    return true;
+  }
+
+  uint32_t indexCount = req->indexCount > 0 ? req->indexCount : req->vertexCount;
+  if (state.geometryVertexCount + req->vertexCount > MAX_GEOMETRY_VERTICES || state.geometryIndexCount + indexCount > MAX_GEOMETRY_INDICES) {
+    return false;
+  }
+
+  if (map_get(&state.geometryCandidates, hash) == MAP_NIL) {
+    if (state.geometryCandidates.used >= MAX_GEOMETRY_CANDIDATES) {
+      map_free(&state.geometryCandidates);
+      map_init(&state.geometryCandidates, 64);
+    }
+    map_set(&state.geometryCandidates, hash, 0);
+    return false;
+  }
+
+  Buffer* vertexBuffer = lovrMeshGetVertexBuffer(state.geometryMesh);
+  Buffer* indexBuffer = lovrMeshGetIndexBuffer(state.geometryMesh);
+  size_t vertexOffset = state.geometryVertexCount * bufferStride[STREAM_VERTEX];
+  size_t indexOffset = state.geometryIndexCount * sizeof(uint16_t);
+  uint16_t* indices = lovrBufferMap(indexBuffer, indexOffset);
+  *(req->vertices) = lovrBufferMap(vertexBuffer, vertexOffset);
+  lovrBufferFlush(vertexBuffer, vertexOffset, req->vertexCount * bufferStride[STREAM_VERTEX]);
+  lovrBufferFlush(indexBuffer, indexOffset, indexCount * sizeof(uint16_t));
+
+  if (req->indexCount > 0) {
+    *(req->indices) = indices;
+    *(req->baseVertex) = state.geometryVertexCount;
+  } else {
+    for (uint32_t i = 0; i < indexCount; i++) {
+      indices[i] = state.geometryVertexCount + i;
+    }
+  }
+
+  *rangeStart = state.geometryIndexCount;
+  *rangeCount = indexCount;
+  map_set(&state.geometryCache, hash, ((uint64_t) *rangeStart << 32) | *rangeCount);
+  state.geometryVertexCount += req->vertexCount;
+  state.geometryIndexCount += indexCount;
+  return true;
+}
+
+// Objects are referred to by small ids in recordings, since pointers mean nothing once replayed
+static uint32_t lovrGraphicsRecordObject(void* object) {
+  if (!object) {
+    return 0;
+  }
+
+  uint64_t hash = hash64(&object, sizeof(object));
+  uint64_t id = map_get(&state.recording.objects, hash);
+
+  if (id == MAP_NIL) {
+    id = ++state.recording.objectCount;
+    map_set(&state.recording.objects, hash, id);
+  }
+
+  return (uint32_t) id;
+}
+
+static void lovrGraphicsRecordRequest(BatchRequest* req) {
+  Record record = {
+    .type = RECORD_REQUEST,
+    .batchType = req->type,
+    .topology = req->topology,
+    .shader = req->shader,
+    .instanced = req->instanced,
+    .bounded = req->bounds != NULL,
+    .mesh = lovrGraphicsRecordObject(req->mesh),
+    .material = lovrGraphicsRecordObject(req->material),
+    .vertexCount = req->mesh ? lovrMeshGetVertexCount(req->mesh) : req->vertexCount,
+    .indexCount = req->mesh ? lovrMeshGetIndexCount(req->mesh) : req->indexCount,
+    .pipeline = req->pipeline ? *req->pipeline : state.pipeline,
+    .params = req->params,
+    .color = state.color
+  };
+
+  mat4_init(record.transform, state.transforms[state.transform]);
+  if (req->transform) {
+    mat4_multiply(record.transform, req->transform);
+  }
+
+  if (req->bounds) {
+    memcpy(record.bounds, req->bounds, 6 * sizeof(float));
+  }
+
+  if (req->type == BATCH_MESH) {
+    record.instances = record.params.mesh.instances;
+  }
+
+  lovrGraphicsWriteRecord(&record);
+}
+
 static void lovrGraphicsBatch(BatchRequest* req) {
+  if (state.recording.active) {
+    lovrGraphicsRecordRequest(req);
+  }
+
+  if (state.capture.active) {
+    lovrGraphicsCapture(req);
+    return;
+  }
+
+  if (req->bounds && lovrGraphicsIsCulled(req->bounds, req->transform)) {
+    return;
+  }
+
+  uint32_t cachedStart = 0;
+  uint32_t cachedCount = 0;
+  bool cached = false;
+  switch (req->type) {
+    case BATCH_ARC:
+    case BATCH_SPHERE:
+    case BATCH_CYLINDER:
+      cached = lovrGraphicsCacheGeometry(req, &cachedStart, &cachedCount);
+      break;
+    default: break;
+  }
 
   // Resolve objects
-  Mesh* mesh = req->mesh ? req->mesh : (req->instanced ? state.instancedMesh : state.mesh);
+  Mesh* mesh = cached ? state.geometryMesh : (req->mesh ? req->mesh : state.mesh);
   Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
   bool stereo = lovrCanvasIsStereo(canvas);
-  Shader* shader = state.shader ? state.shader : (state.defaultShaders[req->shader][stereo] ? state.defaultShaders[req->shader][stereo] : (state.defaultShaders[req->shader][stereo] = lovrShaderCreateDefault(req->shader, NULL, 0, stereo)));
   Pipeline* pipeline = req->pipeline ? req->pipeline : &state.pipeline;
   Material* material = req->material ? req->material : (state.defaultMaterial ? state.defaultMaterial : (state.defaultMaterial = lovrMaterialCreate()));
+  Texture* diffuse = req->material ? lovrMaterialGetTexture(material, TEXTURE_DIFFUSE) : NULL;
+  Shader* shader = state.shader;
+
+  // Atlased model materials sample texture arrays, which need a variant of the default shader
+  if (!shader && diffuse && lovrTextureGetType(diffuse) == TEXTURE_ARRAY) {
+    if (!state.layeredShaders[req->shader][stereo]) {
+      ShaderFlag flag = { .name = "textureArrays", .type = FLAG_BOOL, .value.b32 = true };
+      state.layeredShaders[req->shader][stereo] = lovrShaderCreateDefault(req->shader, &flag, 1, stereo);
+    }
+    shader = state.layeredShaders[req->shader][stereo];
+  } else if (!shader) {
+    shader = state.defaultShaders[req->shader][stereo] ? state.defaultShaders[req->shader][stereo] : (state.defaultShaders[req->shader][stereo] = lovrShaderCreateDefault(req->shader, NULL, 0, stereo));
+  }
+
+  // Instanced draws are merged by streaming their transforms as instance attributes, which only
+  // shaders built with the instanceStream flag read.  Other shaders give each of them its own batch.
+  bool instanced = req->instanced && lovrShaderGetBuiltin(shader, BUILTIN_INSTANCE_STREAM) != LOVR_UNIFORM_NONE;
 
   if (!req->material) {
     if (req->type == BATCH_SKYBOX && lovrTextureGetType(req->texture) == TEXTURE_CUBE) {
-      lovrShaderSetTextures(shader, "lovrSkyboxTexture", &req->texture, 0, 1);
+      lovrShaderSetTexturesAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_SKYBOX_TEXTURE), &req->texture, 0, 1);
     } else {
       lovrMaterialSetTexture(material, TEXTURE_DIFFUSE, req->texture);
     }
   }
 
-  if (lovrShaderHasUniform(shader, "lovrPose")) {
+  UniformHandle pose = lovrShaderGetBuiltin(shader, BUILTIN_POSE);
+  if (pose != LOVR_UNIFORM_NONE) {
     if (req->type == BATCH_MESH && req->params.mesh.pose) {
-      lovrShaderSetMatrices(shader, "lovrPose", req->params.mesh.pose, 0, MAX_BONES * 16);
+      lovrShaderSetMatricesAt(shader, pose, req->params.mesh.pose, 0, MAX_BONES * 16);
     } else {
-      lovrShaderSetMatrices(shader, "lovrPose", (float[]) MAT4_IDENTITY, 0, 16);
+      lovrShaderSetMatricesAt(shader, pose, (float[]) MAT4_IDENTITY, 0, 16);
     }
   }
 
+  float transform[16];
+  mat4_init(transform, state.transforms[state.transform]);
+  if (req->transform) {
+    mat4_multiply(transform, req->transform);
+  }
+
+  // Track the stream segments this request maps, in case it has to flush before its draw is batched
+  memset(state.requestSegments, 0, sizeof(state.requestSegments));
+  state.batching = true;
+
+  // Instances of every batch are written to the instance stream together, so they have to fit
+  if (instanced && state.instanceCount >= state.bufferCount[STREAM_INSTANCE]) {
+    lovrGraphicsFlush();
+  }
+
   // Try to find an existing batch to use
   Batch* batch = NULL;
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batchCount - 1; i >= 0; i--) {
     if (req->type == BATCH_MESH && req->params.mesh.instances > 1) { break; }
+    if (!instanced && (cached || req->type == BATCH_MESH)) { break; }
 
     Batch* b = &state.batches[i];
     if (b->type != req->type) { goto next; }
-    if (b->drawCount >= MAX_DRAWS) { goto next; }
+    if (b->drawCount >= state.maxDraws && !b->streamed) { goto next; }
     if (b->draw.mesh != mesh) { goto next; }
     if (b->draw.canvas != canvas) { goto next; }
     if (b->draw.shader != shader) { goto next; }
@@ -603,15 +1499,19 @@ next:
     // are streaming their vertices (since the vertices of a batch must be contiguous)
     if (b->draw.pipeline.blendMode != BLEND_NONE || pipeline->blendMode != BLEND_NONE) { break; }
     if (b->draw.pipeline.depthTest == COMPARE_NONE || pipeline->depthTest == COMPARE_NONE) { break; }
-    if (!req->instanced) { break; }
+    if (!instanced) { break; }
   }
 
   // The final draw id isn't known until the batch is fully resolved and all the potential flushes
   // have occurred, so we have to do this weird thing where we map the draw id buffer early on but
   // write the ids much later.
-  uint8_t* ids = NULL;
+  uint16_t* ids = NULL;
 
-  if (req->vertexCount > 0 && (!req->instanced || !batch)) {
+  // Vertices of a batch need to be contiguous, so a batch can't be continued if the stream wraps
+  uint32_t vertexHead = state.head[STREAM_VERTEX];
+  uint32_t indexHead = state.head[STREAM_INDEX];
+
+  if (req->vertexCount > 0 && !cached && (!instanced || !batch)) {
     *(req->vertices) = lovrGraphicsMapBuffer(STREAM_VERTEX, req->vertexCount);
     ids = lovrGraphicsMapBuffer(STREAM_DRAWID, req->vertexCount);
 
@@ -621,26 +1521,41 @@ next:
     }
   }
 
+  bool wrapped = state.head[STREAM_VERTEX] < vertexHead || state.head[STREAM_INDEX] < indexHead;
+
   // Start a new batch
-  if (!batch || state.batchCount == 0) {
-    if (state.batchCount >= MAX_BATCHES) {
+  if (!batch || state.batchCount == 0 || wrapped) {
+    if (state.batchCount >= state.maxBatches) {
       lovrGraphicsFlush();
     }
 
-    float* transforms = lovrGraphicsMapBuffer(STREAM_MODEL, MAX_DRAWS);
-    Color* colors = lovrGraphicsMapBuffer(STREAM_COLOR, MAX_DRAWS);
+    // Instanced batches stream their transforms and colors as instance attributes during the flush
+    // instead of using a window of the uniform streams, so they aren't limited to maxDraws
+    float* transforms = NULL;
+    Color* colors = NULL;
+    if (!instanced) {
+      transforms = lovrGraphicsMapBuffer(STREAM_MODEL, state.maxDraws);
+      colors = lovrGraphicsMapBuffer(STREAM_COLOR, state.maxDraws);
+    }
 
     uint32_t rangeStart, rangeCount, instances;
     if (req->type == BATCH_MESH) {
       rangeStart = req->params.mesh.rangeStart;
       rangeCount = req->params.mesh.rangeCount;
-      instances = req->instanced ? 0 : req->params.mesh.instances;
+      instances = instanced ? 0 : req->params.mesh.instances;
+    } else if (cached) {
+      rangeStart = cachedStart;
+      rangeCount = cachedCount;
+      instances = 0;
     } else {
       rangeStart = req->indexCount > 0 ? state.head[STREAM_INDEX] : state.head[STREAM_VERTEX];
       rangeCount = 0;
       instances = 0;
     }
 
+    // Opaque draws that write depth can be drawn in any order
+    bool sortable = state.sorting && pipeline->blendMode == BLEND_NONE && pipeline->depthTest != COMPARE_NONE && pipeline->depthWrite;
+
     batch = &state.batches[state.batchCount++];
     *batch = (Batch) {
       .type = req->type,
@@ -658,30 +1573,37 @@ next:
       .material = material,
       .transforms = transforms,
       .colors = colors,
-      .drawStart = state.head[STREAM_MODEL],
-      .indexed = req->indexCount > 0
+      .key = sortable ? getSortKey(canvas, shader, material, mesh, pipeline, transform) : 0,
+      .drawStart = instanced ? 0 : state.head[STREAM_MODEL],
+      .indexed = cached || req->indexCount > 0,
+      .sortable = sortable,
+      .streamed = instanced
     };
 
-    state.head[STREAM_MODEL] += MAX_DRAWS;
-    state.head[STREAM_COLOR] += MAX_DRAWS;
+    if (batch->streamed) {
+      arr_clear(&state.instanceData[batch - state.batches]);
+    } else {
+      state.head[STREAM_MODEL] += state.maxDraws;
+      state.head[STREAM_COLOR] += state.maxDraws;
+    }
   }
 
-  // Transform
-  if (req->transform) {
-    float transform[16];
-    mat4_multiply(mat4_init(transform, state.transforms[state.transform]), req->transform);
-    memcpy(&batch->transforms[16 * batch->drawCount], transform, 16 * sizeof(float));
+  // Transform and color
+  if (batch->streamed) {
+    arr_append(&state.instanceData[batch - state.batches], transform, 16);
+    arr_append(&state.instanceData[batch - state.batches], (float*) &state.linearColor, 4);
+    state.instanceCount++;
   } else {
-    memcpy(&batch->transforms[16 * batch->drawCount], state.transforms[state.transform], 16 * sizeof(float));
+    memcpy(&batch->transforms[16 * batch->drawCount], transform, 16 * sizeof(float));
+    batch->colors[batch->drawCount] = state.linearColor;
   }
 
-  // Color
-  batch->colors[batch->drawCount] = state.linearColor;
-
   // Cursors
-  if (!req->instanced || batch->drawCount == 0) {
+  if (!cached && (!instanced || batch->drawCount == 0)) {
     if (ids) {
-      memset(ids, batch->drawCount, req->vertexCount * sizeof(uint8_t));
+      for (uint32_t i = 0; i < req->vertexCount; i++) {
+        ids[i] = batch->drawCount;
+      }
     }
 
     batch->draw.rangeCount += batch->indexed ? req->indexCount : req->vertexCount;
@@ -690,69 +1612,136 @@ next:
     state.head[STREAM_INDEX] += req->indexCount;
   }
 
-  if (req->instanced) {
+  if (instanced) {
     batch->draw.instances++;
   }
 
   batch->drawCount++;
+  memset(state.requestSegments, 0, sizeof(state.requestSegments));
+  state.batching = false;
 }
 
-void lovrGraphicsFlush() {
-  if (state.batchCount == 0) {
-    return;
-  }
-
-  // Prevent infinite flushing >_>
-  int batchCount = state.batchCount;
-  state.batchCount = 0;
-
+static void lovrGraphicsWriteFrameData() {
   if (state.frameDataDirty) {
     state.frameDataDirty = false;
     void* data = lovrGraphicsMapBuffer(STREAM_FRAME, 1);
     memcpy(data, &state.frameData, sizeof(FrameData));
     state.head[STREAM_FRAME]++;
   }
+}
 
-  // Flush buffers
+static void lovrGraphicsUnmapStreams() {
   for (int i = 0; i < MAX_STREAMS; i++) {
+    state.uploadedBytes += (state.head[i] - state.tail[i]) * bufferStride[i];
     lovrBufferFlush(state.buffers[i], state.tail[i] * bufferStride[i], (state.head[i] - state.tail[i]) * bufferStride[i]);
     lovrBufferUnmap(state.buffers[i]);
     state.tail[i] = state.head[i];
   }
+}
 
-  for (int b = 0; b < batchCount; b++) {
-    Batch* batch = &state.batches[b];
+// Lock every segment that was used, the lock replaces any previous lock for the segment.  If this
+// flush happened in the middle of a batch request, the segments it already mapped will be read by a
+// draw that hasn't been submitted yet, so they stay pending and get locked again by the next flush.
+static void lovrGraphicsLockStreams() {
+  for (int i = 0; i < MAX_STREAMS; i++) {
+    for (int j = 0; j < STREAM_SEGMENTS; j++) {
+      if (state.pending[i] & (1 << j)) {
+        lovrGpuDestroyLock(state.locks[i][j]);
+        state.locks[i][j] = lovrGpuLock();
+      }
+    }
+    state.pending[i] = state.requestSegments[i];
+  }
+}
+
+void lovrGraphicsFlush() {
+  if (state.batchCount == 0) {
+    return;
+  }
+
+  // Prevent infinite flushing >_>
+  uint32_t batchCount = state.batchCount;
+  state.batchCount = 0;
+
+  // Streams mapped by the flush itself aren't part of the batch request that caused it
+  bool batching = state.batching;
+  state.batching = false;
+
+  lovrGraphicsWriteFrameData();
+
+  // Pack the instances of each streamed batch contiguously now that all of the counts are known
+  if (state.instanceCount > 0) {
+    float* instances = lovrGraphicsMapBuffer(STREAM_INSTANCE, state.instanceCount);
+    for (uint32_t b = 0; b < batchCount; b++) {
+      Batch* batch = &state.batches[b];
+      if (batch->streamed) {
+        memcpy(instances, state.instanceData[b].data, state.instanceData[b].length * sizeof(float));
+        instances += state.instanceData[b].length;
+        batch->draw.instanceBuffer = state.buffers[STREAM_INSTANCE];
+        batch->draw.instanceOffset = state.head[STREAM_INSTANCE] * bufferStride[STREAM_INSTANCE];
+        state.head[STREAM_INSTANCE] += batch->drawCount;
+      }
+    }
+    state.instanceCount = 0;
+  }
+
+  lovrGraphicsUnmapStreams();
+
+  for (uint32_t b = 0; b < batchCount; b++) {
+    state.batchOrder[b] = b;
+  }
+
+  // Sort each run of sortable batches, batches that need their submission order act as barriers
+  for (uint32_t b = 0; b < batchCount; b++) {
+    uint32_t start = b;
+    while (b < batchCount && state.batches[b].sortable) b++;
+    if (b - start > 1) {
+      sortBatches(state.batchOrder + start, b - start);
+    }
+  }
+
+  for (uint32_t b = 0; b < batchCount; b++) {
+    Batch* batch = &state.batches[state.batchOrder[b]];
 
     // Uniforms
-    lovrMaterialBind(batch->material, batch->draw.shader);
-    lovrShaderSetBlock(batch->draw.shader, "lovrModelBlock", state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], MAX_DRAWS * bufferStride[STREAM_MODEL], ACCESS_READ);
-    lovrShaderSetBlock(batch->draw.shader, "lovrColorBlock", state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], MAX_DRAWS * bufferStride[STREAM_COLOR], ACCESS_READ);
-    lovrShaderSetBlock(batch->draw.shader, "lovrFrameBlock", state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
+    Shader* shader = batch->draw.shader;
+    lovrMaterialBind(batch->material, shader);
+    lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_MODEL_BLOCK), state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], state.maxDraws * bufferStride[STREAM_MODEL], ACCESS_READ);
+    lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_COLOR_BLOCK), state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], state.maxDraws * bufferStride[STREAM_COLOR], ACCESS_READ);
+    lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_FRAME_BLOCK), state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
     if (batch->draw.topology == DRAW_POINTS) {
-      lovrShaderSetFloats(batch->draw.shader, "lovrPointSize", &state.pointSize, 0, 1);
+      lovrShaderSetFloatsAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_POINT_SIZE), &state.pointSize, 0, 1);
     }
 
     // Other bindings (TODO try to get rid of all this!)
-    if (batch->type == BATCH_MESH) {
-      lovrMeshSetAttributeEnabled(batch->draw.mesh, "lovrDrawID", batch->params.mesh.instances <= 1);
-    } else {
-      if (batch->draw.mesh == state.instancedMesh && batch->draw.instances <= 1) {
-        batch->draw.mesh = state.mesh;
-      }
-
+    if (batch->draw.mesh == state.mesh) {
       if (batch->indexed) {
-        lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], bufferCount[STREAM_INDEX], sizeof(uint16_t), 0);
+        lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], state.bufferCount[STREAM_INDEX], sizeof(uint16_t), 0);
       } else {
         lovrMeshSetIndexBuffer(batch->draw.mesh, NULL, 0, 0, 0);
       }
     }
 
+    if (state.recording.active) {
+      lovrGraphicsWriteRecord(&(Record) {
+        .type = RECORD_DRAW,
+        .topology = batch->draw.topology,
+        .mesh = lovrGraphicsRecordObject(batch->draw.mesh),
+        .vertexCount = batch->draw.rangeCount,
+        .instances = batch->draw.instances
+      });
+    }
+
     lovrGpuDraw(&batch->draw);
   }
+
+  state.flushedBatches += batchCount;
+  lovrGraphicsLockStreams();
+  state.batching = batching;
 }
 
 void lovrGraphicsFlushCanvas(Canvas* canvas) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.canvas == canvas) {
       lovrGraphicsFlush();
       return;
@@ -761,7 +1750,7 @@ void lovrGraphicsFlushCanvas(Canvas* canvas) {
 }
 
 void lovrGraphicsFlushShader(Shader* shader) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.shader == shader) {
       lovrGraphicsFlush();
       return;
@@ -770,7 +1759,7 @@ void lovrGraphicsFlushShader(Shader* shader) {
 }
 
 void lovrGraphicsFlushMaterial(Material* material) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].material == material) {
       lovrGraphicsFlush();
       return;
@@ -779,7 +1768,7 @@ void lovrGraphicsFlushMaterial(Material* material) {
 }
 
 void lovrGraphicsFlushMesh(Mesh* mesh) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batchCount - 1; i >= 0; i--) {
     if (state.batches[i].draw.mesh == mesh) {
       lovrGraphicsFlush();
       return;
@@ -868,6 +1857,7 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
     .topology = style == STYLE_LINE ? DRAW_LINE_LOOP : DRAW_TRIANGLES,
     .material = material,
     .transform = transform,
+    .bounds = (float[6]) { -.5f, .5f, -.5f, .5f, 0.f, 0.f },
     .vertexCount = 4,
     .indexCount = style == STYLE_LINE ? 5 : 6,
     .vertices = &vertices,
@@ -875,6 +1865,10 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
     .baseVertex = &baseVertex
   });
 
+  if (!vertices) {
+    return;
+  }
+
   if (style == STYLE_LINE) {
     static float vertexData[] = {
       -.5f,  .5f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f,
@@ -919,6 +1913,7 @@ void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
     .topology = style == STYLE_LINE ? DRAW_LINES : DRAW_TRIANGLES,
     .material = material,
     .transform = transform,
+    .bounds = (float[6]) { -.5f, .5f, -.5f, .5f, -.5f, .5f },
     .vertexCount = style == STYLE_LINE ? 8 : 24,
     .indexCount = style == STYLE_LINE ? 24 : 36,
     .vertices = &vertices,
@@ -1020,6 +2015,7 @@ void lovrGraphicsArc(DrawStyle style, ArcMode mode, Material* material, mat4 tra
     .topology = style == STYLE_LINE ? (mode == ARC_MODE_OPEN ? DRAW_LINE_STRIP : DRAW_LINE_LOOP) : DRAW_TRIANGLE_FAN,
     .material = material,
     .transform = transform,
+    .bounds = (float[6]) { -1.f, 1.f, -1.f, 1.f, 0.f, 0.f },
     .vertexCount = vertexCount,
     .vertices = &vertices,
     .instanced = true
@@ -1058,6 +2054,7 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
   float* vertices = NULL;
   uint16_t* indices = NULL;
   uint16_t baseVertex;
+  float r = MAX(r1, r2);
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_CYLINDER,
@@ -1068,6 +2065,7 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
     .topology = DRAW_TRIANGLES,
     .material = material,
     .transform = transform,
+    .bounds = (float[6]) { -r, r, -r, r, -.5f, .5f },
     .vertexCount = vertexCount,
     .indexCount = indexCount,
     .vertices = &vertices,
@@ -1145,6 +2143,7 @@ void lovrGraphicsSphere(Material* material, mat4 transform, int segments) {
     .topology = DRAW_TRIANGLES,
     .material = material,
     .transform = transform,
+    .bounds = (float[6]) { -1.f, 1.f, -1.f, 1.f, -1.f, 1.f },
     .vertexCount = (segments + 1) * (segments + 1),
     .indexCount = segments * segments * 6,
     .vertices = &vertices,
@@ -1280,7 +2279,7 @@ void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
   }
 }
 
-void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose) {
+static void lovrGraphicsBatchMesh(Mesh* mesh, Material* material, mat4 transform, uint32_t instances, float* pose) {
   uint32_t vertexCount = lovrMeshGetVertexCount(mesh);
   uint32_t indexCount = lovrMeshGetIndexCount(mesh);
   uint32_t defaultCount = indexCount > 0 ? indexCount : vertexCount;
@@ -1288,7 +2287,6 @@ void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float*
   lovrMeshGetDrawRange(mesh, &rangeStart, &rangeCount);
   rangeCount = rangeCount > 0 ? rangeCount : defaultCount;
   DrawMode mode = lovrMeshGetDrawMode(mesh);
-  Material* material = lovrMeshGetMaterial(mesh);
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_MESH,
@@ -1303,3 +2301,403 @@ void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float*
     .instanced = instances <= 1
   });
 }
+
+void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose) {
+  lovrGraphicsBatchMesh(mesh, lovrMeshGetMaterial(mesh), transform, instances, pose);
+}
+
+// Extracts the clip planes of every view as (normal, distance), normalized so distances are in world
+// units.  The planes of a view are the sums and differences of the last row of the view-projection
+// matrix with each of the other rows.
+static uint32_t lovrGraphicsGetFrustum(float planes[12][4]) {
+  Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_multiply(mat4_init(m, state.camera.projection[i]), state.camera.viewMatrix[i]);
+
+    for (uint32_t j = 0; j < 6; j++) {
+      float* plane = planes[6 * i + j];
+      float sign = (j & 1) ? -1.f : 1.f;
+      uint32_t row = j >> 1;
+      for (uint32_t k = 0; k < 4; k++) {
+        plane[k] = m[4 * k + 3] + sign * m[4 * k + row];
+      }
+
+      float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+      for (uint32_t k = 0; k < 4; k++) {
+        plane[k] /= length;
+      }
+    }
+  }
+
+  return 6 * viewCount;
+}
+
+// Scenes are drawn right away instead of going through the batcher.  With indirect draws the whole
+// Scene is one draw (culled by a compute shader when possible), otherwise each visible object is
+// drawn using its slice of the instance buffer.
+void lovrGraphicsDrawScene(Scene* scene) {
+  uint32_t count = lovrSceneGetCount(scene);
+  if (count == 0) {
+    return;
+  }
+
+  lovrGraphicsFlush();
+
+  Mesh* mesh = lovrSceneGetMesh(scene);
+  Canvas* canvas = state.canvas ? state.canvas : state.camera.canvas;
+  bool stereo = lovrCanvasIsStereo(canvas);
+  Shader* shader = state.shader ? state.shader : (state.defaultShaders[SHADER_UNLIT][stereo] ? state.defaultShaders[SHADER_UNLIT][stereo] : (state.defaultShaders[SHADER_UNLIT][stereo] = lovrShaderCreateDefault(SHADER_UNLIT, NULL, 0, stereo)));
+  Material* material = lovrMeshGetMaterial(mesh);
+
+  if (!material) {
+    material = state.defaultMaterial ? state.defaultMaterial : (state.defaultMaterial = lovrMaterialCreate());
+    lovrMaterialSetTexture(material, TEXTURE_DIFFUSE, NULL);
+  }
+
+  // Instanced stereo draws every object once per eye, so commands need twice as many instances
+  uint32_t multiplier = (stereo && lovrGpuGetStereoMode() == STEREO_INSTANCED) ? 2 : 1;
+  SceneFrame* frame = lovrSceneSync(scene, multiplier);
+
+  float planes[12][4];
+  uint32_t planeCount = lovrSceneIsCullingEnabled(scene) ? lovrGraphicsGetFrustum(planes) : 0;
+
+  if (frame->commands && frame->bounds && planeCount > 0) {
+    if (!state.cullShader) {
+      state.cullShader = lovrShaderCreateCompute(lovrSceneCullShader, -1, NULL, 0);
+    }
+
+    Shader* cull = state.cullShader;
+    lovrShaderSetBlock(cull, "lovrSceneInstances", frame->instances, 0, count * sizeof(SceneInstance), ACCESS_READ);
+    lovrShaderSetBlock(cull, "lovrSceneBounds", frame->bounds, 0, count * 4 * sizeof(float), ACCESS_READ);
+    lovrShaderSetBlock(cull, "lovrSceneCommands", frame->commands, 0, count * sizeof(IndirectCommand), ACCESS_READ_WRITE);
+    lovrShaderSetFloats(cull, "lovrScenePlanes", &planes[0][0], 0, planeCount * 4);
+    lovrShaderSetInts(cull, "lovrScenePlaneCount", &(int) { planeCount }, 0, 1);
+    lovrShaderSetInts(cull, "lovrSceneCount", &(int) { count }, 0, 1);
+    lovrShaderSetInts(cull, "lovrSceneMultiplier", &(int) { multiplier }, 0, 1);
+    lovrGpuCompute(cull, (count + 63) / 64, 1, 1);
+  }
+
+  lovrGraphicsWriteFrameData();
+  lovrGraphicsUnmapStreams();
+
+  // Transforms and colors come from the instance attributes, but the blocks still need a binding
+  lovrMaterialBind(material, shader);
+  lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_MODEL_BLOCK), state.buffers[STREAM_MODEL], 0, state.maxDraws * bufferStride[STREAM_MODEL], ACCESS_READ);
+  lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_COLOR_BLOCK), state.buffers[STREAM_COLOR], 0, state.maxDraws * bufferStride[STREAM_COLOR], ACCESS_READ);
+  lovrShaderSetBlockAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_FRAME_BLOCK), state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
+  lovrShaderSetMatricesAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_POSE), (float[]) MAT4_IDENTITY, 0, 16);
+  if (lovrMeshGetDrawMode(mesh) == DRAW_POINTS) {
+    lovrShaderSetFloatsAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_POINT_SIZE), &state.pointSize, 0, 1);
+  }
+
+  DrawCommand draw = {
+    .mesh = mesh,
+    .canvas = canvas,
+    .shader = shader,
+    .pipeline = state.pipeline,
+    .topology = lovrMeshGetDrawMode(mesh),
+    .instances = 1,
+    .instanceBuffer = frame->instances
+  };
+
+  if (frame->commands) {
+    draw.indirectBuffer = frame->commands;
+    draw.indirectCount = count;
+    lovrGpuDraw(&draw);
+  } else {
+    for (uint32_t i = 0; i < count; i++) {
+      if (planeCount > 0 && !lovrSceneIsVisible(scene, i, planes, planeCount)) {
+        state.stats.culledDraws++;
+        continue;
+      }
+
+      draw.rangeStart = scene->commandData[i].start;
+      draw.rangeCount = scene->commandData[i].count;
+      draw.instanceOffset = i * sizeof(SceneInstance);
+      lovrGpuDraw(&draw);
+    }
+  }
+
+  lovrSceneLock(scene);
+  lovrGraphicsLockStreams();
+}
+
+void lovrGraphicsSubmit(DrawList* list) {
+  Color color = state.color;
+
+  for (size_t i = 0; i < list->entries.length; i++) {
+    DrawListEntry* entry = &list->entries.data[i];
+    lovrGraphicsSetColor(entry->color);
+
+    switch (entry->type) {
+      case DRAW_LIST_MESH: {
+        Material* material = entry->material ? entry->material : lovrMeshGetMaterial(entry->object.mesh);
+        lovrGraphicsBatchMesh(entry->object.mesh, material, entry->transform, entry->instances, NULL);
+        break;
+      }
+      case DRAW_LIST_MODEL:
+        lovrModelDraw(entry->object.model, entry->transform, entry->instances, NULL);
+        break;
+    }
+  }
+
+  lovrGraphicsSetColor(color);
+}
+
+void lovrGraphicsBeginCapture() {
+  lovrAssert(!state.capture.active, "Primitives are already being captured");
+  arr_clear(&state.capture.vertices);
+  arr_clear(&state.capture.colors);
+  arr_clear(&state.capture.indices);
+  state.capture.vertexStart = 0;
+  state.capture.indexStart = 0;
+  state.capture.active = true;
+}
+
+Mesh* lovrGraphicsEndCapture() {
+  Capture* capture = &state.capture;
+  lovrAssert(capture->active, "Primitives aren't being captured");
+  lovrGraphicsResolveCapture();
+  capture->active = false;
+
+  Material* material = capture->material;
+  capture->material = NULL;
+
+  uint32_t vertexCount = (uint32_t) capture->vertices.length / 8;
+  if (vertexCount == 0) {
+    lovrRelease(Material, material);
+    return NULL;
+  }
+
+  Buffer* vertexBuffer = lovrBufferCreate(capture->vertices.length * sizeof(float), capture->vertices.data, BUFFER_VERTEX, USAGE_STATIC, false);
+  Buffer* colorBuffer = lovrBufferCreate(capture->colors.length * sizeof(Color), capture->colors.data, BUFFER_VERTEX, USAGE_STATIC, false);
+  Buffer* indexBuffer = lovrBufferCreate(capture->indices.length * sizeof(uint16_t), capture->indices.data, BUFFER_INDEX, USAGE_STATIC, false);
+
+  size_t stride = 8 * sizeof(float);
+  Mesh* mesh = lovrMeshCreate(DRAW_TRIANGLES, vertexBuffer, vertexCount);
+  lovrMeshAttachAttribute(mesh, "lovrPosition", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 });
+  lovrMeshAttachAttribute(mesh, "lovrNormal", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 });
+  lovrMeshAttachAttribute(mesh, "lovrTexCoord", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 });
+  lovrMeshAttachAttribute(mesh, "lovrVertexColor", &(MeshAttribute) { .buffer = colorBuffer, .stride = sizeof(Color), .type = F32, .components = 4 });
+  lovrMeshSetIndexBuffer(mesh, indexBuffer, (uint32_t) capture->indices.length, sizeof(uint16_t), 0);
+  lovrMeshSetMaterial(mesh, material);
+  lovrRelease(Buffer, vertexBuffer);
+  lovrRelease(Buffer, colorBuffer);
+  lovrRelease(Buffer, indexBuffer);
+  lovrRelease(Material, material);
+  return mesh;
+}
+
+void lovrGraphicsStartRecording() {
+  lovrAssert(!state.recording.active, "Already recording");
+  arr_clear(&state.recording.data);
+  map_free(&state.recording.objects);
+  map_init(&state.recording.objects, 64);
+  state.recording.objectCount = 0;
+  state.recording.recordCount = 0;
+  state.recording.active = true;
+}
+
+void* lovrGraphicsStopRecording(size_t* size) {
+  lovrAssert(state.recording.active, "Not recording");
+  state.recording.active = false;
+
+  size_t bodySize = state.recording.data.length;
+  uint8_t* body = state.recording.data.data;
+  state.recording.data.data = NULL;
+  state.recording.data.length = 0;
+  state.recording.data.capacity = 0;
+
+  // The header is written through the same helpers so it's little endian too
+  arr_append(&state.recording.data, (uint8_t*) "LVRR", 4);
+  writeU32(RECORDING_VERSION);
+  writeU32(state.recording.recordCount);
+  writeU32(state.recording.objectCount);
+  arr_append(&state.recording.data, body, bodySize);
+  free(body);
+
+  *size = state.recording.data.length;
+  uint8_t* data = state.recording.data.data;
+  state.recording.data.data = NULL;
+  state.recording.data.length = 0;
+  state.recording.data.capacity = 0;
+  return data;
+}
+
+// Replayed meshes only need the right counts, their contents are zeroed
+static Mesh* lovrGraphicsCreateReplayMesh(Record* record) {
+  size_t stride = bufferStride[STREAM_VERTEX];
+  Buffer* vertexBuffer = lovrBufferCreate(record->vertexCount * stride, NULL, BUFFER_VERTEX, USAGE_STATIC, false);
+  memset(lovrBufferMap(vertexBuffer, 0), 0, record->vertexCount * stride);
+  lovrBufferFlush(vertexBuffer, 0, record->vertexCount * stride);
+
+  Mesh* mesh = lovrMeshCreate(record->topology, vertexBuffer, record->vertexCount);
+  lovrMeshAttachAttribute(mesh, "lovrPosition", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 });
+  lovrMeshAttachAttribute(mesh, "lovrNormal", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 });
+  lovrMeshAttachAttribute(mesh, "lovrTexCoord", &(MeshAttribute) { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 });
+  lovrMeshSetDrawRange(mesh, record->params.mesh.rangeStart, record->params.mesh.rangeCount);
+  lovrRelease(Buffer, vertexBuffer);
+
+  if (record->indexCount > 0) {
+    size_t indexSize = record->vertexCount > 0xffff ? sizeof(uint32_t) : sizeof(uint16_t);
+    Buffer* indexBuffer = lovrBufferCreate(record->indexCount * indexSize, NULL, BUFFER_INDEX, USAGE_STATIC, false);
+    memset(lovrBufferMap(indexBuffer, 0), 0, record->indexCount * indexSize);
+    lovrBufferFlush(indexBuffer, 0, record->indexCount * indexSize);
+    lovrMeshSetIndexBuffer(mesh, indexBuffer, record->indexCount, indexSize, 0);
+    lovrRelease(Buffer, indexBuffer);
+  }
+
+  return mesh;
+}
+
+// Feeds a recording back through the batcher, using the public drawing functions wherever possible
+// so tessellation is measured too.  Skyboxes are skipped since their textures aren't recorded.
+void lovrGraphicsReplay(void* data, size_t size, ReplayStats* stats) {
+  RecordReader reader = { .data = data, .size = size };
+  lovrAssert(size >= RECORDING_HEADER_SIZE && !memcmp(data, "LVRR", 4), "Invalid recording");
+  reader.cursor = 4;
+  lovrAssert(readU32(&reader) == RECORDING_VERSION, "Recording was made with an incompatible version");
+  uint32_t recordCount = readU32(&reader);
+  uint32_t objectCount = readU32(&reader);
+  lovrAssert(!state.recording.active, "Can not replay while recording");
+  lovrAssert(!state.capture.active, "Can not replay while capturing");
+
+  // Every record is at least a byte and introduces at most one object, which bounds the allocations
+  lovrAssert(recordCount <= size - RECORDING_HEADER_SIZE && objectCount <= recordCount, "Invalid recording");
+  reader.objectCount = objectCount;
+
+  // The whole recording is decoded once up front, so a bad one is rejected before any state changes
+  size_t start = reader.cursor;
+  Record decoded;
+  Record* record = &decoded;
+  for (uint32_t i = 0; i < recordCount; i++) {
+    lovrGraphicsReadRecord(&reader, record);
+  }
+
+  Mesh** meshes = calloc(objectCount + 1, sizeof(Mesh*));
+  Material** materials = calloc(objectCount + 1, sizeof(Material*));
+  lovrAssert(meshes && materials, "Out of memory");
+
+  // Objects are created before timing starts so their uploads aren't part of the measurement
+  reader.cursor = start;
+  for (uint32_t i = 0; i < recordCount; i++) {
+    lovrGraphicsReadRecord(&reader, record);
+    if (record->type != RECORD_REQUEST || record->batchType == BATCH_SKYBOX) {
+      continue;
+    }
+
+    if (record->mesh && !meshes[record->mesh]) {
+      meshes[record->mesh] = lovrGraphicsCreateReplayMesh(record);
+    }
+
+    if (record->material && !materials[record->material]) {
+      materials[record->material] = lovrMaterialCreate();
+    }
+  }
+
+  Shader* shader = state.shader;
+  Pipeline pipeline = state.pipeline;
+  Color color = state.color;
+  float savedTransform[16];
+  mat4_init(savedTransform, state.transforms[state.transform]);
+  lovrRetain(shader);
+  lovrGraphicsSetShader(NULL);
+
+  lovrGraphicsFlush();
+  memset(stats, 0, sizeof(*stats));
+  uint32_t flushedBatches = state.flushedBatches;
+  uint64_t uploadedBytes = state.uploadedBytes;
+  uint32_t drawCalls = lovrGpuGetStats()->drawCalls;
+  double startTime = lovrPlatformGetTime();
+
+  reader.cursor = start;
+  for (uint32_t i = 0; i < recordCount; i++) {
+    lovrGraphicsReadRecord(&reader, record);
+
+    if (record->type == RECORD_DRAW) {
+      stats->recordedDraws++;
+      continue;
+    } else if (record->type == RECORD_PRESENT) {
+      lovrGraphicsFlush();
+      stats->frames++;
+      continue;
+    } else if (record->batchType == BATCH_SKYBOX) {
+      continue;
+    }
+
+    Mesh* mesh = meshes[record->mesh];
+    Material* material = materials[record->material];
+    BatchParams* params = &record->params;
+    float transform[16] = MAT4_IDENTITY;
+    float* vertices = NULL;
+    uint16_t* indices = NULL;
+    uint16_t baseVertex = 0;
+
+    mat4_set(state.transforms[state.transform], record->transform);
+    state.pipeline = record->pipeline;
+    lovrGraphicsSetColor(record->color);
+    stats->requests++;
+
+    switch (record->batchType) {
+      case BATCH_POINTS: lovrGraphicsPoints(record->vertexCount, &vertices); break;
+      case BATCH_LINES: lovrGraphicsLine(record->vertexCount, &vertices); break;
+      case BATCH_TRIANGLES: lovrGraphicsTriangle(params->triangles.style, material, record->vertexCount, &vertices); break;
+      case BATCH_PLANE: lovrGraphicsPlane(params->plane.style, material, transform, 0.f, 0.f, 1.f, 1.f); break;
+      case BATCH_BOX: lovrGraphicsBox(params->box.style, material, transform); break;
+      case BATCH_ARC: lovrGraphicsArc(params->arc.style, params->arc.mode, material, transform, params->arc.r1, params->arc.r2, params->arc.segments); break;
+      case BATCH_SPHERE: lovrGraphicsSphere(material, transform, params->sphere.segments); break;
+      case BATCH_CYLINDER: lovrGraphicsCylinder(material, transform, params->cylinder.r1, params->cylinder.r2, params->cylinder.capped, params->cylinder.segments); break;
+      case BATCH_FILL: lovrGraphicsFill(NULL, params->fill.u, params->fill.v, params->fill.w, params->fill.h); break;
+      case BATCH_MESH:
+        lovrGraphicsBatchMesh(mesh, material, transform, record->instances, NULL);
+        break;
+      default:
+        lovrGraphicsBatch(&(BatchRequest) {
+          .type = record->batchType,
+          .params = record->params,
+          .topology = record->topology,
+          .shader = record->shader,
+          .pipeline = &record->pipeline,
+          .material = material,
+          .bounds = record->bounded ? record->bounds : NULL,
+          .vertexCount = record->vertexCount,
+          .indexCount = record->indexCount,
+          .vertices = &vertices,
+          .indices = &indices,
+          .baseVertex = &baseVertex,
+          .instanced = record->instanced
+        });
+
+        for (uint32_t j = 0; indices && j < record->indexCount; j++) {
+          indices[j] = baseVertex;
+        }
+        break;
+    }
+
+    if (vertices) {
+      memset(vertices, 0, record->vertexCount * bufferStride[STREAM_VERTEX]);
+    }
+  }
+
+  lovrGraphicsFlush();
+  stats->time = lovrPlatformGetTime() - startTime;
+  stats->batches = state.flushedBatches - flushedBatches;
+  stats->draws = lovrGpuGetStats()->drawCalls - drawCalls;
+  stats->bytes = state.uploadedBytes - uploadedBytes;
+
+  for (uint32_t i = 0; i <= objectCount; i++) {
+    lovrRelease(Mesh, meshes[i]);
+    lovrRelease(Material, materials[i]);
+  }
+  free(meshes);
+  free(materials);
+
+  mat4_init(state.transforms[state.transform], savedTransform);
+  lovrGraphicsSetShader(shader);
+  lovrRelease(Shader, shader);
+  lovrGraphicsSetColor(color);
+  state.pipeline = pipeline;
+}
@@ -10,9 +10,11 @@
 
 struct Buffer;
 struct Canvas;
+struct DrawList;
 struct Font;
 struct Material;
 struct Mesh;
+struct Scene;
 struct Shader;
 struct Texture;
 
@@ -64,6 +66,15 @@ typedef enum {
   STENCIL_INVERT
 } StencilAction;
 
+// How stereo canvases are rendered: once per eye, once with an instance per eye sent to its own
+// viewport, or once with the multiview extension.  Auto picks one when the window is created.
+typedef enum {
+  STEREO_NONE,
+  STEREO_INSTANCED,
+  STEREO_MULTIVIEW,
+  STEREO_AUTO
+} StereoMode;
+
 typedef enum {
   WINDING_CLOCKWISE,
   WINDING_COUNTERCLOCKWISE
@@ -95,18 +106,18 @@ typedef struct {
 bool lovrGraphicsInit(void);
 void lovrGraphicsDestroy(void);
 void lovrGraphicsPresent(void);
-void lovrGraphicsCreateWindow(WindowFlags* flags);
+void lovrGraphicsCreateWindow(WindowFlags* flags, StereoMode stereo);
 int lovrGraphicsGetWidth(void);
 int lovrGraphicsGetHeight(void);
 float lovrGraphicsGetPixelDensity(void);
 const Camera* lovrGraphicsGetCamera(void);
 void lovrGraphicsSetCamera(Camera* camera, bool clear);
-struct Buffer* lovrGraphicsGetIdentityBuffer(void);
+uint32_t lovrGraphicsGetMaxDraws(void);
 #define lovrGraphicsTick lovrGpuTick
 #define lovrGraphicsTock lovrGpuTock
 #define lovrGraphicsGetFeatures lovrGpuGetFeatures
 #define lovrGraphicsGetLimits lovrGpuGetLimits
-#define lovrGraphicsGetStats lovrGpuGetStats
+#define lovrGraphicsGetStereoMode lovrGpuGetStereoMode
 
 // State
 void lovrGraphicsReset(void);
@@ -130,12 +141,16 @@ void lovrGraphicsGetDepthTest(CompareMode* mode, bool* write);
 void lovrGraphicsSetDepthTest(CompareMode depthTest, bool write);
 struct Font* lovrGraphicsGetFont(void);
 void lovrGraphicsSetFont(struct Font* font);
+bool lovrGraphicsIsFrustumCullingEnabled(void);
+void lovrGraphicsSetFrustumCullingEnabled(bool culling);
 float lovrGraphicsGetLineWidth(void);
 void lovrGraphicsSetLineWidth(float width);
 float lovrGraphicsGetPointSize(void);
 void lovrGraphicsSetPointSize(float size);
 struct Shader* lovrGraphicsGetShader(void);
 void lovrGraphicsSetShader(struct Shader* shader);
+bool lovrGraphicsIsSortingEnabled(void);
+void lovrGraphicsSetSortingEnabled(bool sorting);
 void lovrGraphicsGetStencilTest(CompareMode* mode, int* value);
 void lovrGraphicsSetStencilTest(CompareMode mode, int value);
 Winding lovrGraphicsGetWinding(void);
@@ -154,6 +169,8 @@ void lovrGraphicsMatrixTransform(mat4 transform);
 void lovrGraphicsSetProjection(mat4 projection);
 
 // Rendering
+bool lovrGraphicsIsCulled(float aabb[6], mat4 transform);
+float lovrGraphicsGetScreenSize(float aabb[6], mat4 transform);
 void lovrGraphicsFlush(void);
 void lovrGraphicsFlushCanvas(struct Canvas* canvas);
 void lovrGraphicsFlushShader(struct Shader* shader);
@@ -174,8 +191,30 @@ void lovrGraphicsSkybox(struct Texture* texture);
 void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign);
 void lovrGraphicsFill(struct Texture* texture, float u, float v, float w, float h);
 void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, float* pose);
+void lovrGraphicsDrawScene(struct Scene* scene);
+void lovrGraphicsSubmit(struct DrawList* list);
+void lovrGraphicsBeginCapture(void);
+struct Mesh* lovrGraphicsEndCapture(void);
+
+// Recording
+
+typedef struct {
+  uint32_t frames;
+  uint32_t requests;
+  uint32_t batches;
+  uint32_t draws;
+  uint32_t recordedDraws;
+  uint64_t bytes;
+  double time;
+} ReplayStats;
+
+void lovrGraphicsStartRecording(void);
+void* lovrGraphicsStopRecording(size_t* size);
+void lovrGraphicsReplay(void* data, size_t size, ReplayStats* stats);
 #define lovrGraphicsStencil lovrGpuStencil
 #define lovrGraphicsCompute lovrGpuCompute
+#define lovrGraphicsOcclude lovrGpuOcclude
+#define lovrGraphicsConditional lovrGpuConditional
 
 // GPU
 
@@ -183,8 +222,10 @@ typedef struct {
   bool astc;
   bool compute;
   bool dxt;
+  bool indirect;
   bool instancedStereo;
   bool multiview;
+  bool parallelCompile;
   bool timers;
 } GpuFeatures;
 
@@ -206,8 +247,29 @@ typedef struct {
   uint32_t textureCount;
   uint64_t bufferMemory;
   uint64_t textureMemory;
+  uint32_t streamWraps;
+  uint32_t streamStalls;
+  uint64_t streamMemory;
+  uint32_t culledDraws;
+  uint32_t pipelineChanges;
+  uint32_t bufferBinds;
+  uint32_t textureBinds;
+  uint32_t uniformUploads;
+  uint64_t bytesStreamed;
 } GpuStats;
 
+const GpuStats* lovrGraphicsGetStats(void);
+
+// Matches the layout of the indirect commands for indexed draws.  Non-indexed draws read the base
+// instance from the fourth field.
+typedef struct {
+  uint32_t count;
+  uint32_t instances;
+  uint32_t start;
+  uint32_t baseVertex;
+  uint32_t baseInstance;
+} IndirectCommand;
+
 typedef struct {
   struct Mesh* mesh;
   struct Canvas* canvas;
@@ -217,9 +279,13 @@ typedef struct {
   uint32_t rangeStart;
   uint32_t rangeCount;
   uint32_t instances;
+  struct Buffer* instanceBuffer;
+  size_t instanceOffset;
+  struct Buffer* indirectBuffer;
+  uint32_t indirectCount;
 } DrawCommand;
 
-void lovrGpuInit(void* (*getProcAddress)(const char*));
+void lovrGpuInit(void* (*getProcAddress)(const char*), StereoMode stereo);
 void lovrGpuDestroy(void);
 void lovrGpuClear(struct Canvas* canvas, Color* color, float* depth, int* stencil);
 void lovrGpuCompute(struct Shader* shader, int x, int y, int z);
@@ -228,8 +294,14 @@ void lovrGpuDraw(DrawCommand* draw);
 void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata);
 void lovrGpuPresent(void);
 void lovrGpuDirtyTexture(void);
+void* lovrGpuLock(void);
+void lovrGpuUnlock(void* lock);
+void lovrGpuDestroyLock(void* lock);
 void lovrGpuTick(const char* label);
 double lovrGpuTock(const char* label);
+bool lovrGpuOcclude(const char* label, StencilCallback callback, void* userdata);
+void lovrGpuConditional(const char* label, StencilCallback callback, void* userdata);
 const GpuFeatures* lovrGpuGetFeatures(void);
 const GpuLimits* lovrGpuGetLimits(void);
 const GpuStats* lovrGpuGetStats(void);
+StereoMode lovrGpuGetStereoMode(void);
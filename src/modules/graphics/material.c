@@ -2,7 +2,6 @@
 #include "graphics/graphics.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
-#include "resources/shaders.h"
 #include "core/ref.h"
 #include <stdlib.h>
 #include <math.h>
@@ -34,18 +33,18 @@ void lovrMaterialDestroy(void* ref) {
 
 void lovrMaterialBind(Material* material, Shader* shader) {
   for (int i = 0; i < MAX_MATERIAL_SCALARS; i++) {
-    lovrShaderSetFloats(shader, lovrShaderScalarUniforms[i], &material->scalars[i], 0, 1);
+    lovrShaderSetFloatsAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_METALNESS + i), &material->scalars[i], 0, 1);
   }
 
   for (int i = 0; i < MAX_MATERIAL_COLORS; i++) {
-    lovrShaderSetColor(shader, lovrShaderColorUniforms[i], material->colors[i]);
+    lovrShaderSetColorAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_DIFFUSE_COLOR + i), material->colors[i]);
   }
 
   for (int i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
-    lovrShaderSetTextures(shader, lovrShaderTextureUniforms[i], &material->textures[i], 0, 1);
+    lovrShaderSetTexturesAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_DIFFUSE_TEXTURE + i), &material->textures[i], 0, 1);
   }
 
-  lovrShaderSetMatrices(shader, "lovrMaterialTransform", material->transform, 0, 9);
+  lovrShaderSetMatricesAt(shader, lovrShaderGetBuiltin(shader, BUILTIN_MATERIAL_TRANSFORM), material->transform, 0, 9);
 }
 
 float lovrMaterialGetScalar(Material* material, MaterialScalar scalarType) {
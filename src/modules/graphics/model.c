@@ -7,7 +7,11 @@
 #include "resources/shaders.h"
 #include "core/maf.h"
 #include "core/ref.h"
+#ifdef LOVR_ENABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
 #include <stdlib.h>
+#include <string.h>
 #include <float.h>
 #include <math.h>
 
@@ -15,58 +19,216 @@ typedef struct {
   float properties[3][4];
 } NodeTransform;
 
+// Switching levels needs the screen size to cross a threshold by this much, so objects hovering
+// around a threshold don't flicker between levels
+#define LOD_HYSTERESIS .1f
+#define KEYFRAME_LOOKAHEAD 4
+#define ANIMATION_WORKERS 3
+
+typedef struct {
+  Model* model;
+  float size;
+  bool posed;
+} ModelLOD;
+
 struct Model {
   struct ModelData* data;
   struct Buffer** buffers;
   struct Mesh** meshes;
   struct Texture** textures;
   struct Material** materials;
+  struct Buffer* layers;
   NodeTransform* localTransforms;
   float* globalTransforms;
-  bool transformsDirty;
+  uint32_t* positions;
+  uint32_t* parents;
+  uint8_t* dirty;
+  uint32_t dirtyFrom;
+  uint32_t* cursors;
+  float* blendWeights;
+  float* palettes;
+  uint32_t* paletteNodes;
+  ModelLOD lods[MAX_LODS];
+  uint32_t lodCount;
+  uint32_t lod;
+  float bounds[6];
 };
 
-static void updateGlobalTransform(Model* model, uint32_t nodeIndex, mat4 parent) {
-  mat4 global = model->globalTransforms + 16 * nodeIndex;
-  NodeTransform* local = &model->localTransforms[nodeIndex];
-  vec3 T = local->properties[PROP_TRANSLATION];
-  quat R = local->properties[PROP_ROTATION];
-  vec3 S = local->properties[PROP_SCALE];
+#ifdef LOVR_ENABLE_THREAD
+// Workers pull jobs from the current batch until it runs out, the thread submitting the batch helps
+static struct {
+  bool initialized;
+  bool quit;
+  thrd_t workers[ANIMATION_WORKERS];
+  uint32_t workerCount;
+  mtx_t lock;
+  cnd_t start;
+  cnd_t done;
+  ModelAnimationJob* jobs;
+  uint32_t jobCount;
+  uint32_t nextJob;
+  uint32_t finishedJobs;
+} state;
+#endif
+
+// Node transforms are stored in an order where parents come before their children, positions maps
+// node indices to that order
+static NodeTransform* getLocalTransform(Model* model, uint32_t nodeIndex) {
+  return &model->localTransforms[model->positions[nodeIndex]];
+}
 
-  mat4_init(global, parent);
-  mat4_translate(global, T[0], T[1], T[2]);
-  mat4_rotateQuat(global, R);
-  mat4_scale(global, S[0], S[1], S[2]);
+static mat4 getGlobalTransform(Model* model, uint32_t nodeIndex) {
+  return model->globalTransforms + 16 * model->positions[nodeIndex];
+}
 
-  ModelNode* node = &model->data->nodes[nodeIndex];
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    updateGlobalTransform(model, node->children[i], global);
+static void markDirty(Model* model, uint32_t nodeIndex) {
+  uint32_t position = model->positions[nodeIndex];
+  model->dirty[position] = 1;
+  model->dirtyFrom = MIN(model->dirtyFrom, position);
+}
+
+static void markAllDirty(Model* model) {
+  memset(model->dirty, 1, model->data->nodeCount);
+  model->dirtyFrom = 0;
+}
+
+// A single pass in order updates the dirty nodes and their descendants, since a dirty parent is
+// always seen before its children
+static void updateTransforms(Model* model) {
+  if (model->dirtyFrom == ~0u) {
+    return;
   }
+
+  uint32_t count = model->data->nodeCount;
+  for (uint32_t i = model->dirtyFrom; i < count; i++) {
+    uint32_t parent = model->parents[i];
+    if (parent != ~0u && model->dirty[parent]) {
+      model->dirty[i] = 1;
+    } else if (!model->dirty[i]) {
+      continue;
+    }
+
+    float* T = model->localTransforms[i].properties[PROP_TRANSLATION];
+    float* R = model->localTransforms[i].properties[PROP_ROTATION];
+    float* S = model->localTransforms[i].properties[PROP_SCALE];
+    float x = R[0], y = R[1], z = R[2], w = R[3];
+    float local[16] = {
+      (1.f - 2.f * y * y - 2.f * z * z) * S[0], (2.f * x * y + 2.f * w * z) * S[0], (2.f * x * z - 2.f * w * y) * S[0], 0.f,
+      (2.f * x * y - 2.f * w * z) * S[1], (1.f - 2.f * x * x - 2.f * z * z) * S[1], (2.f * y * z + 2.f * w * x) * S[1], 0.f,
+      (2.f * x * z + 2.f * w * y) * S[2], (2.f * y * z - 2.f * w * x) * S[2], (1.f - 2.f * x * x - 2.f * y * y) * S[2], 0.f,
+      T[0], T[1], T[2], 1.f
+    };
+
+    mat4 global = model->globalTransforms + 16 * i;
+    if (parent == ~0u) {
+      mat4_init(global, local);
+    } else {
+      mat4_multiply(mat4_init(global, model->globalTransforms + 16 * parent), local);
+    }
+  }
+
+  memset(model->dirty + model->dirtyFrom, 0, count - model->dirtyFrom);
+  if (model->paletteNodes) {
+    memset(model->paletteNodes, 0xff, model->data->skinCount * sizeof(uint32_t));
+  }
+  model->dirtyFrom = ~0u;
 }
 
-static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
-  ModelNode* node = &model->data->nodes[nodeIndex];
-  mat4 globalTransform = model->globalTransforms + 16 * nodeIndex;
-  float poseMatrix[16 * MAX_BONES];
-  float* pose = NULL;
+// Sorts the nodes depth first from the root, followed by any nodes that aren't attached to it
+static void sortNodes(Model* model) {
+  ModelData* data = model->data;
+  uint32_t count = data->nodeCount;
+  uint32_t edges = 1;
+  uint32_t* parentNodes = malloc(count * sizeof(uint32_t));
+  lovrAssert(parentNodes, "Out of memory");
+  memset(parentNodes, 0xff, count * sizeof(uint32_t));
+  memset(model->positions, 0xff, count * sizeof(uint32_t));
+
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t j = 0; j < data->nodes[i].childCount; j++) {
+      parentNodes[data->nodes[i].children[j]] = i;
+    }
+    edges += data->nodes[i].childCount;
+  }
 
-  if (node->skin != ~0u) {
-    ModelSkin* skin = &model->data->skins[node->skin];
-    pose = poseMatrix;
+  uint32_t* stack = malloc(edges * sizeof(uint32_t));
+  lovrAssert(stack, "Out of memory");
+  uint32_t next = 0;
 
-    for (uint32_t j = 0; j < skin->jointCount; j++) {
-      mat4 globalJointTransform = model->globalTransforms + 16 * skin->joints[j];
-      mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
-      mat4 jointPose = pose + 16 * j;
+  for (uint32_t r = 0; r <= count; r++) {
+    uint32_t root = r == 0 ? data->rootNode : r - 1;
+    if (r > 0 && (parentNodes[root] != ~0u || model->positions[root] != ~0u)) {
+      continue;
+    }
 
-      mat4_set(jointPose, globalTransform);
-      mat4_invert(jointPose);
-      mat4_multiply(jointPose, globalJointTransform);
-      mat4_multiply(jointPose, inverseBindMatrix);
+    uint32_t top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+      uint32_t nodeIndex = stack[--top];
+      if (model->positions[nodeIndex] != ~0u) {
+        continue;
+      }
+
+      uint32_t parent = nodeIndex == root ? ~0u : parentNodes[nodeIndex];
+      model->positions[nodeIndex] = next;
+      model->parents[next] = parent == ~0u ? ~0u : model->positions[parent];
+      next++;
+
+      ModelNode* node = &data->nodes[nodeIndex];
+      for (uint32_t i = node->childCount; i > 0; i--) {
+        if (model->positions[node->children[i - 1]] == ~0u) {
+          stack[top++] = node->children[i - 1];
+        }
+      }
     }
   }
 
+  free(stack);
+  free(parentNodes);
+}
+
+// Skin palettes are cached until the pose changes.  They're relative to the skinned node, so a skin
+// used by several nodes is only reused by the node it was last computed for.
+static float* getPalette(Model* model, uint32_t nodeIndex, uint32_t skinIndex) {
+  float* palette = model->palettes + 16 * MAX_BONES * skinIndex;
+  if (model->paletteNodes[skinIndex] == nodeIndex) {
+    return palette;
+  }
+
+  ModelSkin* skin = &model->data->skins[skinIndex];
+  float inverse[16];
+  mat4_invert(mat4_set(inverse, getGlobalTransform(model, nodeIndex)));
+
+  for (uint32_t j = 0; j < skin->jointCount; j++) {
+    mat4 globalJointTransform = getGlobalTransform(model, skin->joints[j]);
+    mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
+    mat4 jointPose = palette + 16 * j;
+
+    mat4_set(jointPose, inverse);
+    mat4_multiply(jointPose, globalJointTransform);
+    mat4_multiply(jointPose, inverseBindMatrix);
+  }
+
+  model->paletteNodes[skinIndex] = nodeIndex;
+  return palette;
+}
+
+static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
+  ModelNode* node = &model->data->nodes[nodeIndex];
+  mat4 globalTransform = getGlobalTransform(model, nodeIndex);
+  float* pose = node->skin == ~0u ? NULL : getPalette(model, nodeIndex, node->skin);
+
   for (uint32_t i = 0; i < node->primitiveCount; i++) {
+    ModelAttribute* position = model->data->primitives[node->primitiveIndex + i].attributes[ATTR_POSITION];
+
+    // Skinned and instanced primitives can end up anywhere, so they are never culled
+    if (!pose && instances <= 1 && position && position->hasMin && position->hasMax) {
+      float aabb[6] = { position->min[0], position->max[0], position->min[1], position->max[1], position->min[2], position->max[2] };
+      if (lovrGraphicsIsCulled(aabb, globalTransform)) {
+        continue;
+      }
+    }
+
     lovrGraphicsDrawMesh(model->meshes[node->primitiveIndex + i], globalTransform, instances, pose);
   }
 
@@ -75,11 +237,160 @@ static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
   }
 }
 
-Model* lovrModelCreate(ModelData* data) {
+// Atlasing packs materials that only differ by their textures into one Material whose textures are
+// arrays, so draws using any of them share the same material and shader state.  Textures have to be
+// uncompressed and have matching dimensions and formats for each slot.
+static bool isPackable(ModelData* data, ModelMaterial* material) {
+  if (material->textures[TEXTURE_DIFFUSE] == ~0u) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
+    if (material->textures[i] != ~0u && data->textures[material->textures[i]]->format >= FORMAT_DXT1) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool canPack(ModelData* data, ModelMaterial* a, ModelMaterial* b) {
+  if (memcmp(a->scalars, b->scalars, sizeof(a->scalars)) || memcmp(a->colors, b->colors, sizeof(a->colors))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
+    if ((a->textures[i] == ~0u) != (b->textures[i] == ~0u)) {
+      return false;
+    } else if (a->textures[i] == ~0u) {
+      continue;
+    }
+
+    TextureData* x = data->textures[a->textures[i]];
+    TextureData* y = data->textures[b->textures[i]];
+    if (x->width != y->width || x->height != y->height || x->format != y->format) {
+      return false;
+    }
+
+    if (a->filters[i].mode != b->filters[i].mode || a->filters[i].anisotropy != b->filters[i].anisotropy) {
+      return false;
+    }
+
+    if (a->wraps[i].s != b->wraps[i].s || a->wraps[i].t != b->wraps[i].t || a->wraps[i].r != b->wraps[i].r) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Returns the number of materials that were packed.  groups[i] is the material that leads the group
+// of material i (or ~0u) and layers[i] is its layer in the group's texture arrays.
+static uint32_t packMaterials(Model* model, uint32_t* groups, uint32_t* layers) {
+  ModelData* data = model->data;
+  uint32_t* sizes = calloc(data->materialCount, sizeof(uint32_t));
+  lovrAssert(sizes, "Out of memory");
+
+  for (uint32_t i = 0; i < data->materialCount; i++) {
+    groups[i] = ~0u;
+
+    if (!isPackable(data, &data->materials[i])) {
+      continue;
+    }
+
+    for (uint32_t k = 0; k < i; k++) {
+      if (groups[k] == k && canPack(data, &data->materials[k], &data->materials[i])) {
+        groups[i] = k;
+        layers[i] = sizes[k]++;
+        break;
+      }
+    }
+
+    if (groups[i] == ~0u) {
+      groups[i] = i;
+      layers[i] = 0;
+      sizes[i] = 1;
+    }
+  }
+
+  uint32_t packed = 0;
+  Texture* white = NULL;
+  TextureData** slices = malloc(data->materialCount * sizeof(TextureData*));
+  lovrAssert(slices, "Out of memory");
+
+  for (uint32_t i = 0; i < data->materialCount; i++) {
+    if (groups[i] == ~0u || sizes[groups[i]] < 2) {
+      groups[i] = ~0u;
+      continue;
+    } else if (groups[i] != i) {
+      continue;
+    }
+
+    ModelMaterial* leader = &data->materials[i];
+    Material* material = lovrMaterialCreate();
+
+    for (uint32_t j = 0; j < MAX_MATERIAL_SCALARS; j++) {
+      lovrMaterialSetScalar(material, j, leader->scalars[j]);
+    }
+
+    for (uint32_t j = 0; j < MAX_MATERIAL_COLORS; j++) {
+      lovrMaterialSetColor(material, j, leader->colors[j]);
+    }
+
+    for (uint32_t j = 0; j < MAX_MATERIAL_TEXTURES; j++) {
+      if (leader->textures[j] == ~0u) {
+
+        // Unused slots still need an array texture to satisfy the sampler type, the layer gets
+        // clamped so every material samples the same white texel
+        if (!white) {
+          TextureData* textureData = lovrTextureDataCreate(1, 1, NULL, 0xff, FORMAT_RGBA);
+          white = lovrTextureCreate(TEXTURE_ARRAY, &textureData, 1, false, false, 0);
+          lovrRelease(TextureData, textureData);
+        }
+
+        lovrMaterialSetTexture(material, j, white);
+        continue;
+      }
+
+      for (uint32_t k = i; k < data->materialCount; k++) {
+        if (groups[k] == i) {
+          slices[layers[k]] = data->textures[data->materials[k].textures[j]];
+        }
+      }
+
+      bool srgb = j == TEXTURE_DIFFUSE || j == TEXTURE_EMISSIVE;
+      Texture* texture = lovrTextureCreate(TEXTURE_ARRAY, slices, sizes[i], srgb, true, 0);
+      lovrTextureSetFilter(texture, leader->filters[j]);
+      lovrTextureSetWrap(texture, leader->wraps[j]);
+      lovrMaterialSetTexture(material, j, texture);
+      lovrRelease(Texture, texture);
+    }
+
+    for (uint32_t k = i; k < data->materialCount; k++) {
+      if (groups[k] == i) {
+        model->materials[k] = material;
+        lovrRetain(material);
+        packed++;
+      }
+    }
+
+    lovrRelease(Material, material);
+  }
+
+  lovrRelease(Texture, white);
+  free(slices);
+  free(sizes);
+  return packed;
+}
+
+Model* lovrModelCreate(ModelData* data, bool atlas) {
   Model* model = lovrAlloc(Model);
   model->data = data;
   lovrRetain(data);
 
+  uint32_t* groups = NULL;
+  uint32_t* layers = NULL;
+
   // Materials
   if (data->materialCount > 0) {
     model->materials = malloc(data->materialCount * sizeof(Material*));
@@ -88,7 +399,23 @@ Model* lovrModelCreate(ModelData* data) {
       model->textures = calloc(data->textureCount, sizeof(Texture*));
     }
 
+    if (atlas) {
+      groups = malloc(data->materialCount * sizeof(uint32_t));
+      layers = malloc(data->materialCount * sizeof(uint32_t));
+      lovrAssert(groups && layers, "Out of memory");
+
+      if (packMaterials(model, groups, layers) == 0) {
+        free(groups);
+        free(layers);
+        groups = layers = NULL;
+      }
+    }
+
     for (uint32_t i = 0; i < data->materialCount; i++) {
+      if (groups && groups[i] != ~0u) {
+        continue;
+      }
+
       Material* material = lovrMaterialCreate();
 
       for (uint32_t j = 0; j < MAX_MATERIAL_SCALARS; j++) {
@@ -125,11 +452,52 @@ Model* lovrModelCreate(ModelData* data) {
       model->buffers = calloc(data->bufferCount, sizeof(Buffer*));
     }
 
+    // Primitives using a packed material get a per-vertex layer index, stored in one shared buffer
+    size_t layerCount = 0;
+    if (groups) {
+      for (uint32_t i = 0; i < data->primitiveCount; i++) {
+        ModelPrimitive* primitive = &data->primitives[i];
+        if (primitive->material != ~0u && groups[primitive->material] != ~0u && primitive->attributes[ATTR_POSITION]) {
+          layerCount += primitive->attributes[ATTR_POSITION]->count;
+        }
+      }
+    }
+
+    float* layerData = NULL;
+    if (layerCount > 0) {
+      layerData = malloc(layerCount * sizeof(float));
+      lovrAssert(layerData, "Out of memory");
+      for (uint32_t i = 0, cursor = 0; i < data->primitiveCount; i++) {
+        ModelPrimitive* primitive = &data->primitives[i];
+        if (primitive->material != ~0u && groups[primitive->material] != ~0u && primitive->attributes[ATTR_POSITION]) {
+          for (uint32_t j = 0; j < primitive->attributes[ATTR_POSITION]->count; j++) {
+            layerData[cursor++] = (float) layers[primitive->material];
+          }
+        }
+      }
+
+      model->layers = lovrBufferCreate(layerCount * sizeof(float), layerData, BUFFER_VERTEX, USAGE_STATIC, false);
+      free(layerData);
+    }
+
+    size_t layerOffset = 0;
     model->meshes = calloc(data->primitiveCount, sizeof(Mesh*));
     for (uint32_t i = 0; i < data->primitiveCount; i++) {
       ModelPrimitive* primitive = &data->primitives[i];
       model->meshes[i] = lovrMeshCreate(primitive->mode, NULL, 0);
 
+      if (model->layers && primitive->material != ~0u && groups[primitive->material] != ~0u && primitive->attributes[ATTR_POSITION]) {
+        lovrMeshAttachAttribute(model->meshes[i], "lovrMaterialLayer", &(MeshAttribute) {
+          .buffer = model->layers,
+          .offset = layerOffset,
+          .stride = sizeof(float),
+          .type = F32,
+          .components = 1
+        });
+
+        layerOffset += primitive->attributes[ATTR_POSITION]->count * sizeof(float);
+      }
+
       if (primitive->material != ~0u) {
         lovrMeshSetMaterial(model->meshes[i], model->materials[primitive->material]);
       }
@@ -161,14 +529,6 @@ Model* lovrModelCreate(ModelData* data) {
         }
       }
 
-      lovrMeshAttachAttribute(model->meshes[i], "lovrDrawID", &(MeshAttribute) {
-        .buffer = lovrGraphicsGetIdentityBuffer(),
-        .type = U8,
-        .components = 1,
-        .divisor = 1,
-        .integer = true
-      });
-
       if (primitive->indices) {
         ModelAttribute* attribute = primitive->indices;
 
@@ -184,8 +544,31 @@ Model* lovrModelCreate(ModelData* data) {
     }
   }
 
+  free(groups);
+  free(layers);
+
   model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
   model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
+  model->positions = malloc(data->nodeCount * sizeof(uint32_t));
+  model->parents = malloc(data->nodeCount * sizeof(uint32_t));
+  model->dirty = malloc(data->nodeCount * sizeof(uint8_t));
+  model->cursors = calloc(data->channelCount, sizeof(uint32_t));
+  model->blendWeights = malloc(3 * data->nodeCount * sizeof(float));
+  lovrAssert(model->localTransforms && model->globalTransforms && model->positions && model->parents && model->dirty, "Out of memory");
+  lovrAssert(model->blendWeights && (model->cursors || data->channelCount == 0), "Out of memory");
+
+  // Palettes are zeroed so the unused bones compare equal when the pose uniform is resent
+  if (data->skinCount > 0) {
+    for (uint32_t i = 0; i < data->skinCount; i++) {
+      lovrAssert(data->skins[i].jointCount <= MAX_BONES, "Skin has too many joints (max is %d)", MAX_BONES);
+    }
+
+    model->palettes = calloc(data->skinCount, 16 * MAX_BONES * sizeof(float));
+    model->paletteNodes = malloc(data->skinCount * sizeof(uint32_t));
+    lovrAssert(model->palettes && model->paletteNodes, "Out of memory");
+  }
+
+  sortNodes(model);
   lovrModelResetPose(model);
   return model;
 }
@@ -221,27 +604,175 @@ void lovrModelDestroy(void* ref) {
     free(model->materials);
   }
 
+  for (uint32_t i = 0; i < model->lodCount; i++) {
+    lovrRelease(Model, model->lods[i].model);
+  }
+
+  lovrRelease(Buffer, model->layers);
   lovrRelease(ModelData, model->data);
   free(model->globalTransforms);
   free(model->localTransforms);
+  free(model->positions);
+  free(model->parents);
+  free(model->dirty);
+  free(model->cursors);
+  free(model->blendWeights);
+  free(model->palettes);
+  free(model->paletteNodes);
 }
 
 ModelData* lovrModelGetModelData(Model* model) {
   return model->data;
 }
 
-void lovrModelDraw(Model* model, mat4 transform, uint32_t instances) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
+// Picks the level to draw from the screen size of the Model's bounds.  Levels are sorted by their
+// size thresholds (largest first), and level 0 is the Model itself.  The hysteresis needs the level
+// picked by the previous frame, which is kept per draw in *level so that drawing the same Model at
+// several distances doesn't make the levels fight each other.
+static Model* selectLOD(Model* model, mat4 transform, uint32_t* level) {
+  float size = lovrGraphicsGetScreenSize(model->bounds, transform);
+  uint32_t lod = MIN(*level, model->lodCount);
+
+  while (lod < model->lodCount && size < model->lods[lod].size * (1.f - LOD_HYSTERESIS)) {
+    lod++;
   }
 
+  while (lod > 0 && size > model->lods[lod - 1].size * (1.f + LOD_HYSTERESIS)) {
+    lod--;
+  }
+
+  *level = model->lod = lod;
+
+  if (lod == 0) {
+    return model;
+  }
+
+  // Levels with the same node hierarchy follow the pose of the Model
+  Model* lodModel = model->lods[lod - 1].model;
+  uint32_t nodeCount = model->data->nodeCount;
+  if (model->lods[lod - 1].posed && memcmp(lodModel->localTransforms, model->localTransforms, nodeCount * sizeof(NodeTransform))) {
+    memcpy(lodModel->localTransforms, model->localTransforms, nodeCount * sizeof(NodeTransform));
+    markAllDirty(lodModel);
+  }
+
+  return lodModel;
+}
+
+// If lod is NULL, the level of the last draw is used for hysteresis, which only works well when the
+// Model is drawn once per frame.  Draws at different distances should each pass their own level.
+void lovrModelDraw(Model* model, mat4 transform, uint32_t instances, uint32_t* lod) {
+  if (model->lodCount > 0) {
+    uint32_t level = model->lod;
+    Model* lodModel = selectLOD(model, transform, lod ? lod : &level);
+    if (lodModel != model) {
+      lovrModelDraw(lodModel, transform, instances, NULL);
+      return;
+    }
+  }
+
+  updateTransforms(model);
+
   lovrGraphicsPush();
   lovrGraphicsMatrixTransform(transform);
   renderNode(model, model->data->rootNode, instances);
   lovrGraphicsPop();
 }
 
+// Returns the index of the first keyframe at or after the time.  Playback usually moves forward a
+// little every frame, so the keyframes after the cursor from the last lookup are checked first, and
+// anything else (seeking, looping, blending in a new animation) falls back to a binary search.
+static uint32_t findKeyframe(ModelAnimationChannel* channel, float time, uint32_t* cursor) {
+  uint32_t count = channel->keyframeCount;
+  float* times = channel->times;
+
+  for (uint32_t k = *cursor; k <= count && k <= *cursor + KEYFRAME_LOOKAHEAD; k++) {
+    if ((k == 0 || times[k - 1] < time) && (k == count || times[k] >= time)) {
+      return *cursor = k;
+    }
+  }
+
+  uint32_t lo = 0;
+  uint32_t hi = count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (times[mid] < time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return *cursor = lo;
+}
+
+static void sampleChannel(Model* model, ModelAnimationChannel* channel, float time, float property[4]) {
+  uint32_t keyframe = findKeyframe(channel, time, &model->cursors[channel - model->data->channels]);
+  bool rotate = channel->property == PROP_ROTATION;
+  size_t n = 3 + rotate;
+  float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
+
+  if (keyframe == 0 || keyframe >= channel->keyframeCount) {
+    size_t index = CLAMP(keyframe, 0, channel->keyframeCount - 1);
+
+    // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
+    if (channel->smoothing == SMOOTH_CUBIC) {
+      index = 3 * index + 1;
+    }
+
+    lovrModelDataGetKeyframe(channel, index, property);
+  } else {
+    float t1 = channel->times[keyframe - 1];
+    float t2 = channel->times[keyframe];
+    float z = (time - t1) / (t2 - t1);
+
+    switch (channel->smoothing) {
+      case SMOOTH_STEP:
+        lovrModelDataGetKeyframe(channel, z >= .5f ? keyframe : keyframe - 1, property);
+        break;
+      case SMOOTH_LINEAR: {
+        float next[4];
+        lovrModelDataGetKeyframe(channel, keyframe - 1, property);
+        lovrModelDataGetKeyframe(channel, keyframe, next);
+        lerp(property, next, z);
+        break;
+      }
+      case SMOOTH_CUBIC: {
+        size_t stride = 3 * n;
+        float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
+        float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
+        float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
+        float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
+        float dt = t2 - t1;
+        float z2 = z * z;
+        float z3 = z2 * z;
+        float a = 2.f * z3 - 3.f * z2 + 1.f;
+        float b = 2.f * z3 - 3.f * z2 + 1.f;
+        float c = (-2.f * z3 + 3.f * z2);
+        float d = (z3 * -z2) * dt;
+        for (size_t j = 0; j < n; j++) {
+          property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+static void applyChannel(Model* model, ModelAnimationChannel* channel, float property[4], float alpha) {
+  NodeTransform* transform = getLocalTransform(model, channel->nodeIndex);
+  markDirty(model, channel->nodeIndex);
+
+  if (alpha >= 1.f) {
+    memcpy(transform->properties[channel->property], property, (channel->property == PROP_ROTATION ? 4 : 3) * sizeof(float));
+  } else if (channel->property == PROP_ROTATION) {
+    quat_slerp(transform->properties[channel->property], property, alpha);
+  } else {
+    vec3_lerp(transform->properties[channel->property], property, alpha);
+  }
+}
+
 void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha) {
   if (alpha <= 0.f) {
     return;
@@ -252,88 +783,164 @@ void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float a
   time = fmodf(time, animation->duration);
 
   for (uint32_t i = 0; i < animation->channelCount; i++) {
-    ModelAnimationChannel* channel = &animation->channels[i];
-    uint32_t nodeIndex = channel->nodeIndex;
-    NodeTransform* transform = &model->localTransforms[nodeIndex];
+    float property[4];
+    sampleChannel(model, &animation->channels[i], time, property);
+    applyChannel(model, &animation->channels[i], property, alpha);
+  }
+}
+
+// Each animated property ends up as the weighted average of the animations that touch it, which is
+// accumulated by blending every sample in by its share of the weight seen so far
+void lovrModelBlend(Model* model, uint32_t count, uint32_t* animations, float* times, float* weights) {
+  memset(model->blendWeights, 0, 3 * model->data->nodeCount * sizeof(float));
 
-    uint32_t keyframe = 0;
-    while (keyframe < channel->keyframeCount && channel->times[keyframe] < time) {
-      keyframe++;
+  for (uint32_t i = 0; i < count; i++) {
+    if (weights[i] <= 0.f) {
+      continue;
     }
 
-    float property[4];
-    bool rotate = channel->property == PROP_ROTATION;
-    size_t n = 3 + rotate;
-    float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
+    lovrAssert(animations[i] < model->data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", animations[i], model->data->animationCount);
+    ModelAnimation* animation = &model->data->animations[animations[i]];
+    float time = fmodf(times[i], animation->duration);
+
+    for (uint32_t j = 0; j < animation->channelCount; j++) {
+      ModelAnimationChannel* channel = &animation->channels[j];
+      float* weight = &model->blendWeights[3 * model->positions[channel->nodeIndex] + channel->property];
+      *weight += weights[i];
+
+      float property[4];
+      sampleChannel(model, channel, time, property);
+      applyChannel(model, channel, property, weights[i] / *weight);
+    }
+  }
+}
 
-    if (keyframe == 0 || keyframe >= channel->keyframeCount) {
-      size_t index = CLAMP(keyframe, 0, channel->keyframeCount - 1);
+// Everything a Model needs before it can be drawn, only touches memory owned by the Model
+static void runAnimationJob(ModelAnimationJob* job) {
+  Model* model = job->model;
+  lovrModelBlend(model, job->animationCount, job->animations, job->times, job->weights);
+  updateTransforms(model);
 
-      // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
-      if (channel->smoothing == SMOOTH_CUBIC) {
-        index = 3 * index + 1;
+  for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+    if (model->data->nodes[i].skin != ~0u) {
+      getPalette(model, i, model->data->nodes[i].skin);
+    }
+  }
+}
+
+#ifdef LOVR_ENABLE_THREAD
+static void runAnimationJobs(bool helping) {
+  mtx_lock(&state.lock);
+  for (;;) {
+    while (!state.quit && state.nextJob >= state.jobCount) {
+      if (helping) {
+        mtx_unlock(&state.lock);
+        return;
       }
+      cnd_wait(&state.start, &state.lock);
+    }
 
-      memcpy(property, channel->data + index * n, n * sizeof(float));
-    } else {
-      float t1 = channel->times[keyframe - 1];
-      float t2 = channel->times[keyframe];
-      float z = (time - t1) / (t2 - t1);
-
-      switch (channel->smoothing) {
-        case SMOOTH_STEP:
-          memcpy(property, channel->data + (z >= .5f ? keyframe : keyframe - 1) * n, n * sizeof(float));
-          break;
-        case SMOOTH_LINEAR:
-          memcpy(property, channel->data + (keyframe - 1) * n, n * sizeof(float));
-          lerp(property, channel->data + keyframe * n, z);
-          break;
-        case SMOOTH_CUBIC: {
-          size_t stride = 3 * n;
-          float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
-          float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
-          float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
-          float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
-          float dt = t2 - t1;
-          float z2 = z * z;
-          float z3 = z2 * z;
-          float a = 2.f * z3 - 3.f * z2 + 1.f;
-          float b = 2.f * z3 - 3.f * z2 + 1.f;
-          float c = (-2.f * z3 + 3.f * z2);
-          float d = (z3 * -z2) * dt;
-          for (size_t j = 0; j < n; j++) {
-            property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
-          }
-          break;
+    if (state.quit) {
+      break;
+    }
+
+    ModelAnimationJob* job = &state.jobs[state.nextJob++];
+    mtx_unlock(&state.lock);
+    runAnimationJob(job);
+    mtx_lock(&state.lock);
+
+    if (++state.finishedJobs == state.jobCount) {
+      cnd_signal(&state.done);
+    }
+  }
+  mtx_unlock(&state.lock);
+}
+
+static int animationWorker(void* userdata) {
+  runAnimationJobs(false);
+  return 0;
+}
+
+void lovrModelDestroyWorkers() {
+  if (!state.initialized) return;
+  mtx_lock(&state.lock);
+  state.quit = true;
+  cnd_broadcast(&state.start);
+  mtx_unlock(&state.lock);
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    thrd_join(state.workers[i], NULL);
+  }
+  cnd_destroy(&state.done);
+  cnd_destroy(&state.start);
+  mtx_destroy(&state.lock);
+  memset(&state, 0, sizeof(state));
+}
+#else
+void lovrModelDestroyWorkers() {
+  //
+}
+#endif
+
+// Each Model can only appear once in a batch, since its job runs on whichever thread picks it up
+void lovrModelAnimateMany(ModelAnimationJob* jobs, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    ModelData* data = jobs[i].model->data;
+    lovrAssert(jobs[i].animationCount <= MAX_BLEND_ANIMATIONS, "Too many animations to blend (max is %d)", MAX_BLEND_ANIMATIONS);
+    for (uint32_t j = 0; j < jobs[i].animationCount; j++) {
+      lovrAssert(jobs[i].animations[j] < data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", jobs[i].animations[j], data->animationCount);
+    }
+  }
+
+#ifdef LOVR_ENABLE_THREAD
+  if (count > 1) {
+    if (!state.initialized) {
+      mtx_init(&state.lock, mtx_plain);
+      cnd_init(&state.start);
+      cnd_init(&state.done);
+      for (uint32_t i = 0; i < ANIMATION_WORKERS; i++) {
+        if (thrd_create(&state.workers[state.workerCount], animationWorker, NULL) == thrd_success) {
+          state.workerCount++;
         }
-        default:
-          break;
       }
+      state.initialized = true;
     }
 
-    if (alpha >= 1.f) {
-      memcpy(transform->properties[channel->property], property, n * sizeof(float));
-    } else {
-      lerp(transform->properties[channel->property], property, alpha);
+    mtx_lock(&state.lock);
+    state.jobs = jobs;
+    state.jobCount = count;
+    state.nextJob = 0;
+    state.finishedJobs = 0;
+    cnd_broadcast(&state.start);
+    mtx_unlock(&state.lock);
+
+    runAnimationJobs(true);
+
+    mtx_lock(&state.lock);
+    while (state.finishedJobs < state.jobCount) {
+      cnd_wait(&state.done, &state.lock);
     }
+    state.jobs = NULL;
+    state.jobCount = 0;
+    state.nextJob = 0;
+    mtx_unlock(&state.lock);
+    return;
   }
+#endif
 
-  model->transformsDirty = true;
+  for (uint32_t i = 0; i < count; i++) {
+    runAnimationJob(&jobs[i]);
+  }
 }
 
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space) {
   lovrAssert(nodeIndex < model->data->nodeCount, "Invalid node index '%d' (Model only has %d nodes)", nodeIndex, model->data->nodeCount);
   if (space == SPACE_LOCAL) {
-    vec3_init(position, model->localTransforms[nodeIndex].properties[PROP_TRANSLATION]);
-    quat_init(rotation, model->localTransforms[nodeIndex].properties[PROP_ROTATION]);
+    vec3_init(position, getLocalTransform(model, nodeIndex)->properties[PROP_TRANSLATION]);
+    quat_init(rotation, getLocalTransform(model, nodeIndex)->properties[PROP_ROTATION]);
   } else {
-    if (model->transformsDirty) {
-      updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-      model->transformsDirty = false;
-    }
-
-    mat4_getPosition(model->globalTransforms + 16 * nodeIndex, position);
-    mat4_getOrientation(model->globalTransforms + 16 * nodeIndex, rotation);
+    updateTransforms(model);
+    mat4_getPosition(getGlobalTransform(model, nodeIndex), position);
+    mat4_getOrientation(getGlobalTransform(model, nodeIndex), rotation);
   }
 }
 
@@ -343,7 +950,7 @@ void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float ro
   }
 
   lovrAssert(nodeIndex < model->data->nodeCount, "Invalid node index '%d' (Model only has %d node)", nodeIndex + 1, model->data->nodeCount, model->data->nodeCount == 1 ? "" : "s");
-  NodeTransform* transform = &model->localTransforms[nodeIndex];
+  NodeTransform* transform = getLocalTransform(model, nodeIndex);
   if (alpha >= 1.f) {
     vec3_init(transform->properties[PROP_TRANSLATION], position);
     quat_init(transform->properties[PROP_ROTATION], rotation);
@@ -351,23 +958,24 @@ void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float ro
     vec3_lerp(transform->properties[PROP_TRANSLATION], position, alpha);
     quat_slerp(transform->properties[PROP_ROTATION], rotation, alpha);
   }
-  model->transformsDirty = true;
+  markDirty(model, nodeIndex);
 }
 
 void lovrModelResetPose(Model* model) {
   for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+    NodeTransform* transform = getLocalTransform(model, i);
     if (model->data->nodes[i].matrix) {
-      mat4_getPosition(model->data->nodes[i].transform.matrix, model->localTransforms[i].properties[PROP_TRANSLATION]);
-      mat4_getOrientation(model->data->nodes[i].transform.matrix, model->localTransforms[i].properties[PROP_ROTATION]);
-      mat4_getScale(model->data->nodes[i].transform.matrix, model->localTransforms[i].properties[PROP_SCALE]);
+      mat4_getPosition(model->data->nodes[i].transform.matrix, transform->properties[PROP_TRANSLATION]);
+      mat4_getOrientation(model->data->nodes[i].transform.matrix, transform->properties[PROP_ROTATION]);
+      mat4_getScale(model->data->nodes[i].transform.matrix, transform->properties[PROP_SCALE]);
     } else {
-      vec3_init(model->localTransforms[i].properties[PROP_TRANSLATION], model->data->nodes[i].transform.properties.translation);
-      quat_init(model->localTransforms[i].properties[PROP_ROTATION], model->data->nodes[i].transform.properties.rotation);
-      vec3_init(model->localTransforms[i].properties[PROP_SCALE], model->data->nodes[i].transform.properties.scale);
+      vec3_init(transform->properties[PROP_TRANSLATION], model->data->nodes[i].transform.properties.translation);
+      quat_init(transform->properties[PROP_ROTATION], model->data->nodes[i].transform.properties.rotation);
+      vec3_init(transform->properties[PROP_SCALE], model->data->nodes[i].transform.properties.scale);
     }
   }
 
-  model->transformsDirty = true;
+  markAllDirty(model);
 }
 
 Material* lovrModelGetMaterial(Model* model, uint32_t material) {
@@ -381,7 +989,7 @@ static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
   for (uint32_t i = 0; i < node->primitiveCount; i++) {
     ModelAttribute* position = model->data->primitives[node->primitiveIndex + i].attributes[ATTR_POSITION];
     if (position && position->hasMin && position->hasMax) {
-      mat4 m = model->globalTransforms + 16 * nodeIndex;
+      mat4 m = getGlobalTransform(model, nodeIndex);
 
       float xa[3] = { position->min[0] * m[0], position->min[0] * m[1], position->min[0] * m[2] };
       float xb[3] = { position->max[0] * m[0], position->max[0] * m[1], position->max[0] * m[2] };
@@ -419,12 +1027,59 @@ static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
 }
 
 void lovrModelGetAABB(Model* model, float aabb[6]) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
+  updateTransforms(model);
 
   aabb[0] = aabb[2] = aabb[4] = FLT_MAX;
   aabb[1] = aabb[3] = aabb[5] = -FLT_MAX;
   applyAABB(model, model->data->rootNode, aabb);
 }
+
+// Adds a simpler version of the Model that is drawn instead when the Model's height on screen, as a
+// fraction of the viewport height, is below size
+// Whether two Models have the same node hierarchy, so a pose of one can be copied to the other
+static bool hasSameHierarchy(Model* a, Model* b) {
+  uint32_t nodeCount = a->data->nodeCount;
+  if (b->data->nodeCount != nodeCount) {
+    return false;
+  }
+
+  if (memcmp(a->positions, b->positions, nodeCount * sizeof(uint32_t)) || memcmp(a->parents, b->parents, nodeCount * sizeof(uint32_t))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < nodeCount; i++) {
+    const char* name = a->data->nodes[i].name;
+    const char* other = b->data->nodes[i].name;
+    if (name && other && strcmp(name, other)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void lovrModelAddLOD(Model* model, Model* lod, float size) {
+  lovrAssert(lod != model && lod->lodCount == 0, "A level of detail can not have levels of its own");
+  lovrAssert(model->lodCount < MAX_LODS, "Too many levels of detail (max is %d)", MAX_LODS);
+  lovrAssert(size > 0.f, "Level of detail size must be positive");
+
+  // The bounds are measured once, in the pose the Model has when its first level is added
+  if (model->lodCount == 0) {
+    lovrModelGetAABB(model, model->bounds);
+    lovrAssert(model->bounds[0] <= model->bounds[1], "Model needs vertex position bounds to use levels of detail");
+  }
+
+  uint32_t i = model->lodCount++;
+  while (i > 0 && model->lods[i - 1].size < size) {
+    model->lods[i] = model->lods[i - 1];
+    i--;
+  }
+
+  model->lods[i] = (ModelLOD) { lod, size, hasSameHierarchy(model, lod) };
+  lovrRetain(lod);
+  model->lod = 0;
+}
+
+uint32_t lovrModelGetLOD(Model* model) {
+  return model->lod;
+}
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#define MAX_LODS 8
+#define MAX_BLEND_ANIMATIONS 16
+
 struct Material;
 struct ModelData;
 
@@ -12,13 +15,27 @@ typedef enum {
 } CoordinateSpace;
 
 typedef struct Model Model;
-Model* lovrModelCreate(struct ModelData* data);
+
+typedef struct {
+  Model* model;
+  uint32_t animationCount;
+  uint32_t animations[MAX_BLEND_ANIMATIONS];
+  float times[MAX_BLEND_ANIMATIONS];
+  float weights[MAX_BLEND_ANIMATIONS];
+} ModelAnimationJob;
+
+Model* lovrModelCreate(struct ModelData* data, bool atlas);
 void lovrModelDestroy(void* ref);
 struct ModelData* lovrModelGetModelData(Model* model);
-void lovrModelDraw(Model* model, float* transform, uint32_t instances);
+void lovrModelDraw(Model* model, float* transform, uint32_t instances, uint32_t* lod);
 void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha);
+void lovrModelBlend(Model* model, uint32_t count, uint32_t* animations, float* times, float* weights);
+void lovrModelAnimateMany(ModelAnimationJob* jobs, uint32_t count);
+void lovrModelDestroyWorkers(void);
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space);
 void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], float alpha);
 void lovrModelResetPose(Model* model);
 struct Material* lovrModelGetMaterial(Model* model, uint32_t material);
 void lovrModelGetAABB(Model* model, float aabb[6]);
+void lovrModelAddLOD(Model* model, Model* lod, float size);
+uint32_t lovrModelGetLOD(Model* model);
@@ -0,0 +1,1034 @@
+#include "graphics/graphics.h"
+#include "graphics/buffer.h"
+#include "graphics/canvas.h"
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/shader.h"
+#include "graphics/texture.h"
+#include "data/textureData.h"
+#include "core/hash.h"
+#include "core/ref.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// A GPU backend that doesn't talk to a GPU.  Buffers live in regular memory, textures and shaders
+// only keep their metadata, and draws are counted instead of submitted.  Everything above this
+// layer (batching, streaming, sorting) runs exactly like it does with a real context, so this can
+// be used to run graphics code headless and measure the CPU side of it.
+
+// Types
+
+struct Buffer {
+  void* data;
+  size_t size;
+  size_t flushFrom;
+  size_t flushTo;
+  BufferType type;
+  BufferUsage usage;
+  bool readable;
+};
+
+struct Texture {
+  uint32_t handle;
+  TextureType type;
+  TextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t mipmapCount;
+  CompareMode compareMode;
+  TextureFilter filter;
+  TextureWrap wrap;
+  uint32_t msaa;
+  bool srgb;
+  bool mipmaps;
+  bool allocated;
+  bool native;
+};
+
+struct Canvas {
+  uint32_t width;
+  uint32_t height;
+  CanvasFlags flags;
+  Attachment attachments[MAX_CANVAS_ATTACHMENTS];
+  Attachment depth;
+  uint32_t attachmentCount;
+  bool needsResolve;
+  bool immortal;
+};
+
+struct ShaderBlock {
+  BlockType type;
+  arr_uniform_t uniforms;
+  map_t uniformMap;
+  struct Buffer* buffer;
+};
+
+struct Shader {
+  ShaderType type;
+  arr_uniform_t uniforms;
+  map_t uniformMap;
+  map_t blockMap;
+  bool multiview;
+};
+
+struct Mesh {
+  DrawMode mode;
+  char attributeNames[MAX_ATTRIBUTES][MAX_ATTRIBUTE_NAME_LENGTH];
+  MeshAttribute attributes[MAX_ATTRIBUTES];
+  map_t attributeMap;
+  uint32_t attributeCount;
+  struct Buffer* vertexBuffer;
+  struct Buffer* indexBuffer;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  size_t indexSize;
+  size_t indexOffset;
+  uint32_t drawStart;
+  uint32_t drawCount;
+  struct Material* material;
+};
+
+static struct {
+  Texture* defaultTexture;
+  Canvas* canvas;
+  Shader* shader;
+  GpuFeatures features;
+  GpuLimits limits;
+  GpuStats stats;
+} state;
+
+// Helpers
+
+static bool isTextureFormatDepth(TextureFormat format) {
+  switch (format) {
+    case FORMAT_D16: case FORMAT_D32F: case FORMAT_D24S8: return true;
+    default: return false;
+  }
+}
+
+static uint64_t getTextureMemorySize(Texture* texture) {
+  if (texture->native) return 0;
+  float size = 0.f;
+  float bitrate;
+  switch (texture->format) {
+    case FORMAT_RGB: bitrate = 24.f; break;
+    case FORMAT_RGBA: bitrate = 32.f; break;
+    case FORMAT_RGBA4: bitrate = 16.f; break;
+    case FORMAT_RGBA16F: bitrate = 64.f; break;
+    case FORMAT_RGBA32F: bitrate = 128.f; break;
+    case FORMAT_R16F: bitrate = 16.f; break;
+    case FORMAT_R32F: bitrate = 32.f; break;
+    case FORMAT_RG16F: bitrate = 32.f; break;
+    case FORMAT_RG32F: bitrate = 64.f; break;
+    case FORMAT_RGB5A1: bitrate = 16.f; break;
+    case FORMAT_RGB10A2: bitrate = 32.f; break;
+    case FORMAT_RG11B10F: bitrate = 32.f; break;
+    case FORMAT_D16: bitrate = 16.f; break;
+    case FORMAT_D32F: bitrate = 32.f; break;
+    case FORMAT_D24S8: bitrate = 32.f; break;
+    case FORMAT_DXT1: bitrate = 4.f; break;
+    case FORMAT_DXT3: bitrate = 8.f; break;
+    case FORMAT_DXT5: bitrate = 8.f; break;
+    // Divide fixed-size 128-bit blocks by block size:
+    case FORMAT_ASTC_4x4: bitrate = 8.00f; break;
+    case FORMAT_ASTC_5x4: bitrate = 6.40f; break;
+    case FORMAT_ASTC_5x5: bitrate = 5.12f; break;
+    case FORMAT_ASTC_6x5: bitrate = 4.27f; break;
+    case FORMAT_ASTC_6x6: bitrate = 3.56f; break;
+    case FORMAT_ASTC_8x5: bitrate = 3.20f; break;
+    case FORMAT_ASTC_8x6: bitrate = 2.67f; break;
+    case FORMAT_ASTC_8x8: bitrate = 2.00f; break;
+    case FORMAT_ASTC_10x5: bitrate = 2.56f; break;
+    case FORMAT_ASTC_10x6: bitrate = 2.13f; break;
+    case FORMAT_ASTC_10x8: bitrate = 1.60f; break;
+    case FORMAT_ASTC_10x10: bitrate = 1.28f; break;
+    case FORMAT_ASTC_12x10: bitrate = 1.07f; break;
+    case FORMAT_ASTC_12x12: bitrate = 0.89f; break;
+    default: lovrThrow("Unreachable");
+  }
+  size = texture->width * texture->height * texture->depth * (bitrate / 8.f) * (texture->mipmaps ? 1.33f : 1.f);
+  size += texture->msaa > 1 ? (texture->width * texture->height * texture->msaa * (bitrate / 8.f)) : 0.f;
+  return (uint64_t) (size + .5f);
+}
+
+static size_t getUniformTypeLength(const Uniform* uniform) {
+  size_t size = 0;
+
+  if (uniform->count > 1) {
+    size += 2 + floor(log10(uniform->count)) + 1; // "[count]"
+  }
+
+  switch (uniform->type) {
+    case UNIFORM_MATRIX: size += 4; break;
+    case UNIFORM_FLOAT: size += uniform->components == 1 ? 5 : 4; break;
+    case UNIFORM_INT: size += uniform->components == 1 ? 3 : 5; break;
+    default: break;
+  }
+
+  return size;
+}
+
+static const char* getUniformTypeName(const Uniform* uniform) {
+  switch (uniform->type) {
+    case UNIFORM_FLOAT:
+      switch (uniform->components) {
+        case 1: return "float";
+        case 2: return "vec2";
+        case 3: return "vec3";
+        case 4: return "vec4";
+      }
+      break;
+
+    case UNIFORM_INT:
+      switch (uniform->components) {
+        case 1: return "int";
+        case 2: return "ivec2";
+        case 3: return "ivec3";
+        case 4: return "ivec4";
+      }
+      break;
+
+    case UNIFORM_MATRIX:
+      switch (uniform->components) {
+        case 2: return "mat2";
+        case 3: return "mat3";
+        case 4: return "mat4";
+      }
+      break;
+
+    default: break;
+  }
+
+  lovrThrow("Unreachable");
+  return "";
+}
+
+// GPU
+
+void lovrGpuInit(void* (*getProcAddress)(const char*), StereoMode stereo) {
+  state.limits.pointSizes[0] = 1.f;
+  state.limits.pointSizes[1] = 64.f;
+  state.limits.textureSize = 16384;
+  state.limits.textureMSAA = 8;
+  state.limits.textureAnisotropy = 16.f;
+  state.limits.blockSize = 1 << 16;
+  state.limits.blockAlign = 256;
+
+  TextureData* textureData = lovrTextureDataCreate(1, 1, NULL, 0xff, FORMAT_RGBA);
+  state.defaultTexture = lovrTextureCreate(TEXTURE_2D, &textureData, 1, true, false, 0);
+  lovrRelease(TextureData, textureData);
+}
+
+void lovrGpuDestroy() {
+  lovrRelease(Texture, state.defaultTexture);
+  memset(&state, 0, sizeof(state));
+}
+
+void lovrGpuClear(Canvas* canvas, Color* color, float* depth, int* stencil) {
+  if (state.canvas != canvas) {
+    state.canvas = canvas;
+    state.stats.renderPasses++;
+  }
+
+  if (canvas) {
+    canvas->needsResolve = true;
+  }
+}
+
+void lovrGpuCompute(Shader* shader, int x, int y, int z) {
+  lovrThrow("Compute shaders are not supported on this system");
+}
+
+void lovrGpuDiscard(Canvas* canvas, bool color, bool depth, bool stencil) {
+  //
+}
+
+void lovrGpuDraw(DrawCommand* draw) {
+  if (state.canvas != draw->canvas) {
+    state.canvas = draw->canvas;
+    state.stats.renderPasses++;
+  }
+
+  if (state.shader != draw->shader) {
+    state.shader = draw->shader;
+    state.stats.shaderSwitches++;
+  }
+
+  draw->canvas->needsResolve = true;
+  state.stats.drawCalls += draw->canvas->flags.stereo ? 2 : 1;
+}
+
+void lovrGpuPresent() {
+  state.canvas = NULL;
+  state.shader = NULL;
+  state.stats.shaderSwitches = 0;
+  state.stats.renderPasses = 0;
+  state.stats.drawCalls = 0;
+  state.stats.streamStalls = 0;
+}
+
+void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata) {
+  lovrGraphicsFlush();
+  callback(userdata);
+  lovrGraphicsFlush();
+}
+
+// Nothing reads from the stream buffers asynchronously, so there is never anything to wait for
+void* lovrGpuLock() {
+  return NULL;
+}
+
+void lovrGpuUnlock(void* lock) {
+  //
+}
+
+void lovrGpuDestroyLock(void* lock) {
+  //
+}
+
+void lovrGpuDirtyTexture() {
+  //
+}
+
+void lovrGpuTick(const char* label) {
+  //
+}
+
+double lovrGpuTock(const char* label) {
+  return 0.;
+}
+
+bool lovrGpuOcclude(const char* label, StencilCallback callback, void* userdata) {
+  lovrGraphicsFlush();
+  callback(userdata);
+  lovrGraphicsFlush();
+  return true;
+}
+
+void lovrGpuConditional(const char* label, StencilCallback callback, void* userdata) {
+  callback(userdata);
+}
+
+const GpuFeatures* lovrGpuGetFeatures() {
+  return &state.features;
+}
+
+const GpuLimits* lovrGpuGetLimits() {
+  return &state.limits;
+}
+
+const GpuStats* lovrGpuGetStats() {
+  return &state.stats;
+}
+
+StereoMode lovrGpuGetStereoMode() {
+  return STEREO_NONE;
+}
+
+// Texture
+
+Texture* lovrTextureCreate(TextureType type, TextureData** slices, uint32_t sliceCount, bool srgb, bool mipmaps, uint32_t msaa) {
+  Texture* texture = lovrAlloc(Texture);
+  state.stats.textureCount++;
+  texture->type = type;
+  texture->srgb = srgb;
+  texture->mipmaps = mipmaps;
+  texture->msaa = msaa > 1 ? msaa : 0;
+  texture->compareMode = COMPARE_NONE;
+
+  WrapMode wrap = type == TEXTURE_CUBE ? WRAP_CLAMP : WRAP_REPEAT;
+  texture->wrap = (TextureWrap) { .s = wrap, .t = wrap, .r = wrap };
+
+  if (sliceCount > 0) {
+    lovrTextureAllocate(texture, slices[0]->width, slices[0]->height, sliceCount, slices[0]->format);
+    for (uint32_t i = 0; i < sliceCount; i++) {
+      lovrTextureReplacePixels(texture, slices[i], 0, 0, i, 0);
+    }
+  }
+
+  return texture;
+}
+
+Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t depth) {
+  Texture* texture = lovrAlloc(Texture);
+  state.stats.textureCount++;
+  texture->handle = handle;
+  texture->type = type;
+  texture->depth = depth;
+  texture->mipmapCount = 1;
+  texture->compareMode = COMPARE_NONE;
+  texture->native = true;
+  return texture;
+}
+
+void lovrTextureDestroy(void* ref) {
+  Texture* texture = ref;
+  state.stats.textureMemory -= getTextureMemorySize(texture);
+  state.stats.textureCount--;
+}
+
+void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint32_t depth, TextureFormat format) {
+  uint32_t maxSize = (uint32_t) state.limits.textureSize;
+  lovrAssert(!texture->allocated, "Texture is already allocated");
+  lovrAssert(texture->type != TEXTURE_CUBE || width == height, "Cubemap images must be square");
+  lovrAssert(texture->type != TEXTURE_CUBE || depth == 6, "6 images are required for a cube texture\n");
+  lovrAssert(texture->type != TEXTURE_2D || depth == 1, "2D textures can only contain a single image");
+  lovrAssert(width < maxSize, "Texture width %d exceeds max of %d", width, maxSize);
+  lovrAssert(height < maxSize, "Texture height %d exceeds max of %d", height, maxSize);
+  lovrAssert(!texture->msaa || texture->type == TEXTURE_2D, "Only 2D textures can be created with MSAA");
+
+  texture->allocated = true;
+  texture->width = width;
+  texture->height = height;
+  texture->depth = depth;
+  texture->format = format;
+
+  if (texture->mipmaps) {
+    uint32_t dimension = texture->type == TEXTURE_VOLUME ? (MAX(MAX(width, height), depth)) : MAX(width, height);
+    texture->mipmapCount = log2(dimension) + 1;
+  } else {
+    texture->mipmapCount = 1;
+  }
+
+  state.stats.textureMemory += getTextureMemorySize(texture);
+}
+
+void lovrTextureReplacePixels(Texture* texture, TextureData* textureData, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
+  lovrGraphicsFlush();
+  lovrAssert(texture->allocated, "Texture is not allocated");
+  uint32_t maxWidth = lovrTextureGetWidth(texture, mipmap);
+  uint32_t maxHeight = lovrTextureGetHeight(texture, mipmap);
+  bool overflow = (x + textureData->width > maxWidth) || (y + textureData->height > maxHeight);
+  lovrAssert(!overflow, "Trying to replace pixels outside the texture's bounds");
+  lovrAssert(mipmap < texture->mipmapCount, "Invalid mipmap level %d", mipmap);
+}
+
+// There is nothing to upload, so streaming finishes immediately
+void lovrTextureStream(Texture* texture, TextureData** slices, uint32_t sliceCount) {
+  for (uint32_t i = 0; i < sliceCount; i++) {
+    lovrTextureReplacePixels(texture, slices[i], 0, 0, i, 0);
+  }
+}
+
+bool lovrTextureIsStreaming(Texture* texture) {
+  return false;
+}
+
+uint64_t lovrTextureGetId(Texture* texture) {
+  return texture->handle;
+}
+
+uint32_t lovrTextureGetWidth(Texture* texture, uint32_t mipmap) {
+  return MAX(texture->width >> mipmap, 1);
+}
+
+uint32_t lovrTextureGetHeight(Texture* texture, uint32_t mipmap) {
+  return MAX(texture->height >> mipmap, 1);
+}
+
+uint32_t lovrTextureGetDepth(Texture* texture, uint32_t mipmap) {
+  return texture->type == TEXTURE_VOLUME ? MAX(texture->depth >> mipmap, 1) : texture->depth;
+}
+
+uint32_t lovrTextureGetMipmapCount(Texture* texture) {
+  return texture->mipmapCount;
+}
+
+uint32_t lovrTextureGetMSAA(Texture* texture) {
+  return texture->msaa;
+}
+
+TextureType lovrTextureGetType(Texture* texture) {
+  return texture->type;
+}
+
+TextureFormat lovrTextureGetFormat(Texture* texture) {
+  return texture->format;
+}
+
+CompareMode lovrTextureGetCompareMode(Texture* texture) {
+  return texture->compareMode;
+}
+
+TextureFilter lovrTextureGetFilter(Texture* texture) {
+  return texture->filter;
+}
+
+TextureWrap lovrTextureGetWrap(Texture* texture) {
+  return texture->wrap;
+}
+
+void lovrTextureSetCompareMode(Texture* texture, CompareMode compareMode) {
+  if (texture->compareMode != compareMode) {
+    lovrAssert(compareMode == COMPARE_NONE || isTextureFormatDepth(texture->format), "Only depth textures can set a compare mode");
+    lovrGraphicsFlush();
+    texture->compareMode = compareMode;
+  }
+}
+
+void lovrTextureSetFilter(Texture* texture, TextureFilter filter) {
+  lovrGraphicsFlush();
+  texture->filter = filter;
+}
+
+void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
+  lovrGraphicsFlush();
+  texture->wrap = wrap;
+}
+
+// Canvas
+
+Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
+  Canvas* canvas = lovrAlloc(Canvas);
+  if (flags.stereo) {
+    width *= 2;
+  }
+
+  canvas->width = width;
+  canvas->height = height;
+  canvas->flags = flags;
+
+  if (flags.depth.enabled) {
+    lovrAssert(isTextureFormatDepth(flags.depth.format), "Canvas depth buffer can't use a color TextureFormat");
+    if (flags.depth.readable) {
+      canvas->depth.texture = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, flags.mipmaps, flags.msaa);
+      lovrTextureAllocate(canvas->depth.texture, width, height, 1, flags.depth.format);
+    }
+  }
+
+  return canvas;
+}
+
+Canvas* lovrCanvasCreateFromHandle(uint32_t width, uint32_t height, CanvasFlags flags, uint32_t framebuffer, uint32_t depthBuffer, uint32_t resolveBuffer, uint32_t attachmentCount, bool immortal) {
+  Canvas* canvas = lovrAlloc(Canvas);
+  canvas->attachmentCount = attachmentCount;
+  canvas->width = width;
+  canvas->height = height;
+  canvas->flags = flags;
+  canvas->immortal = immortal;
+  return canvas;
+}
+
+void lovrCanvasDestroy(void* ref) {
+  Canvas* canvas = ref;
+  lovrGraphicsFlushCanvas(canvas);
+  for (uint32_t i = 0; i < canvas->attachmentCount; i++) {
+    lovrRelease(Texture, canvas->attachments[i].texture);
+  }
+  lovrRelease(Texture, canvas->depth.texture);
+  if (state.canvas == canvas) {
+    state.canvas = NULL;
+  }
+}
+
+void lovrCanvasResolve(Canvas* canvas) {
+  if (canvas->needsResolve) {
+    lovrGraphicsFlushCanvas(canvas);
+    canvas->needsResolve = false;
+  }
+}
+
+TextureData* lovrCanvasNewTextureData(Canvas* canvas, uint32_t index) {
+  lovrGraphicsFlushCanvas(canvas);
+  return lovrTextureDataCreate(canvas->width, canvas->height, NULL, 0x0, FORMAT_RGBA);
+}
+
+const Attachment* lovrCanvasGetAttachments(Canvas* canvas, uint32_t* count) {
+  if (count) *count = canvas->attachmentCount;
+  return canvas->attachments;
+}
+
+void lovrCanvasSetAttachments(Canvas* canvas, Attachment* attachments, uint32_t count) {
+  lovrAssert(count > 0, "A Canvas must have at least one attached Texture");
+  lovrAssert(count <= MAX_CANVAS_ATTACHMENTS, "Only %d textures can be attached to a Canvas, got %d\n", MAX_CANVAS_ATTACHMENTS, count);
+
+  if (count == canvas->attachmentCount && !memcmp(canvas->attachments, attachments, count * sizeof(Attachment))) {
+    return;
+  }
+
+  lovrGraphicsFlushCanvas(canvas);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Texture* texture = attachments[i].texture;
+    uint32_t slice = attachments[i].slice;
+    uint32_t level = attachments[i].level;
+    uint32_t width = lovrTextureGetWidth(texture, level);
+    uint32_t height = lovrTextureGetHeight(texture, level);
+    uint32_t depth = lovrTextureGetDepth(texture, level);
+    uint32_t mipmaps = lovrTextureGetMipmapCount(texture);
+    bool hasDepthBuffer = canvas->flags.depth.enabled;
+    lovrAssert(slice < depth, "Invalid attachment slice (Texture has %d, got %d)", depth, slice + 1);
+    lovrAssert(level < mipmaps, "Invalid attachment mipmap level (Texture has %d, got %d)", mipmaps, level + 1);
+    lovrAssert(!hasDepthBuffer || width == canvas->width, "Texture width of %d does not match Canvas width (%d)", width, canvas->width);
+    lovrAssert(!hasDepthBuffer || height == canvas->height, "Texture height of %d does not match Canvas height (%d)", height, canvas->height);
+    lovrAssert(lovrTextureGetMSAA(texture) == canvas->flags.msaa, "Texture MSAA does not match Canvas MSAA");
+    lovrRetain(texture);
+  }
+
+  for (uint32_t i = 0; i < canvas->attachmentCount; i++) {
+    lovrRelease(Texture, canvas->attachments[i].texture);
+  }
+
+  memcpy(canvas->attachments, attachments, count * sizeof(Attachment));
+  canvas->attachmentCount = count;
+}
+
+bool lovrCanvasIsStereo(Canvas* canvas) {
+  return canvas->flags.stereo;
+}
+
+void lovrCanvasSetStereo(Canvas* canvas, bool stereo) {
+  canvas->flags.stereo = stereo;
+}
+
+uint32_t lovrCanvasGetWidth(Canvas* canvas) {
+  return canvas->width;
+}
+
+uint32_t lovrCanvasGetHeight(Canvas* canvas) {
+  return canvas->height;
+}
+
+void lovrCanvasSetWidth(Canvas* canvas, uint32_t width) {
+  canvas->width = width;
+}
+
+void lovrCanvasSetHeight(Canvas* canvas, uint32_t height) {
+  canvas->height = height;
+}
+
+uint32_t lovrCanvasGetMSAA(Canvas* canvas) {
+  return canvas->flags.msaa;
+}
+
+Texture* lovrCanvasGetDepthTexture(Canvas* canvas) {
+  return canvas->depth.texture;
+}
+
+// Buffer
+
+Buffer* lovrBufferCreate(size_t size, void* data, BufferType type, BufferUsage usage, bool readable) {
+  Buffer* buffer = lovrAlloc(Buffer);
+  state.stats.bufferCount++;
+  state.stats.bufferMemory += size;
+  buffer->size = size;
+  buffer->readable = readable;
+  buffer->type = type;
+  buffer->usage = usage;
+  buffer->flushFrom = SIZE_MAX;
+  buffer->data = data ? malloc(size) : calloc(1, size);
+  lovrAssert(buffer->data, "Out of memory");
+
+  if (data) {
+    memcpy(buffer->data, data, size);
+  }
+
+  return buffer;
+}
+
+void lovrBufferDestroy(void* ref) {
+  Buffer* buffer = ref;
+  free(buffer->data);
+  state.stats.bufferMemory -= buffer->size;
+  state.stats.bufferCount--;
+}
+
+size_t lovrBufferGetSize(Buffer* buffer) {
+  return buffer->size;
+}
+
+bool lovrBufferIsReadable(Buffer* buffer) {
+  return buffer->readable;
+}
+
+BufferUsage lovrBufferGetUsage(Buffer* buffer) {
+  return buffer->usage;
+}
+
+void* lovrBufferMap(Buffer* buffer, size_t offset) {
+  return (uint8_t*) buffer->data + offset;
+}
+
+void lovrBufferFlush(Buffer* buffer, size_t offset, size_t size) {
+  buffer->flushFrom = MIN(buffer->flushFrom, offset);
+  buffer->flushTo = MAX(buffer->flushTo, offset + size);
+}
+
+void lovrBufferUnmap(Buffer* buffer) {
+  buffer->flushFrom = SIZE_MAX;
+  buffer->flushTo = 0;
+}
+
+void lovrBufferDiscard(Buffer* buffer) {
+  //
+}
+
+// Shader
+
+// There is no compiler, so shaders don't have any active uniforms or blocks and sending values to
+// them is ignored, the same way it is for uniforms that a real compiler optimizes out.
+static Shader* lovrShaderCreate(ShaderType type, bool multiview) {
+  Shader* shader = lovrAlloc(Shader);
+  shader->type = type;
+  shader->multiview = multiview;
+  arr_init(&shader->uniforms);
+  map_init(&shader->uniformMap, 0);
+  map_init(&shader->blockMap, 0);
+  return shader;
+}
+
+Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+  return lovrShaderCreate(SHADER_GRAPHICS, multiview);
+}
+
+Shader* lovrShaderCreateDefault(DefaultShader type, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+  return lovrShaderCreate(SHADER_GRAPHICS, multiview);
+}
+
+Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flags, uint32_t flagCount) {
+  lovrThrow("Compute shaders are not supported on this system");
+  return NULL;
+}
+
+void lovrShaderDestroy(void* ref) {
+  Shader* shader = ref;
+  lovrGraphicsFlushShader(shader);
+  arr_free(&shader->uniforms);
+  map_free(&shader->uniformMap);
+  map_free(&shader->blockMap);
+  if (state.shader == shader) {
+    state.shader = NULL;
+  }
+}
+
+ShaderType lovrShaderGetType(Shader* shader) {
+  return shader->type;
+}
+
+int lovrShaderGetAttributeLocation(Shader* shader, const char* name) {
+  return -1;
+}
+
+bool lovrShaderHasUniform(Shader* shader, const char* name) {
+  return map_get(&shader->uniformMap, hash64(name, strlen(name))) != MAP_NIL;
+}
+
+bool lovrShaderHasBlock(Shader* shader, const char* name) {
+  return map_get(&shader->blockMap, hash64(name, strlen(name))) != MAP_NIL;
+}
+
+const Uniform* lovrShaderGetUniform(Shader* shader, const char* name) {
+  uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
+  return index == MAP_NIL ? NULL : &shader->uniforms.data[index];
+}
+
+UniformHandle lovrShaderGetUniformHandle(Shader* shader, const char* name) {
+  uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
+  return index == MAP_NIL ? LOVR_UNIFORM_NONE : (UniformHandle) index;
+}
+
+UniformHandle lovrShaderGetBlockHandle(Shader* shader, const char* name) {
+  uint64_t id = map_get(&shader->blockMap, hash64(name, strlen(name)));
+  return id == MAP_NIL ? LOVR_UNIFORM_NONE : (UniformHandle) id;
+}
+
+UniformHandle lovrShaderGetBuiltin(Shader* shader, BuiltinUniform builtin) {
+  return LOVR_UNIFORM_NONE;
+}
+
+const Uniform* lovrShaderGetUniformAt(Shader* shader, UniformHandle handle) {
+  return handle < shader->uniforms.length ? &shader->uniforms.data[handle] : NULL;
+}
+
+void lovrShaderSetFloatsAt(Shader* shader, UniformHandle handle, float* data, int start, int count) {
+  //
+}
+
+void lovrShaderSetIntsAt(Shader* shader, UniformHandle handle, int* data, int start, int count) {
+  //
+}
+
+void lovrShaderSetMatricesAt(Shader* shader, UniformHandle handle, float* data, int start, int count) {
+  //
+}
+
+void lovrShaderSetTexturesAt(Shader* shader, UniformHandle handle, Texture** data, int start, int count) {
+  //
+}
+
+void lovrShaderSetImagesAt(Shader* shader, UniformHandle handle, Image* data, int start, int count) {
+  //
+}
+
+void lovrShaderSetColorAt(Shader* shader, UniformHandle handle, Color color) {
+  //
+}
+
+void lovrShaderSetBlockAt(Shader* shader, UniformHandle handle, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  //
+}
+
+void lovrShaderSetFloats(Shader* shader, const char* name, float* data, int start, int count) {
+  lovrShaderSetFloatsAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetInts(Shader* shader, const char* name, int* data, int start, int count) {
+  lovrShaderSetIntsAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetMatrices(Shader* shader, const char* name, float* data, int start, int count) {
+  lovrShaderSetMatricesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetTextures(Shader* shader, const char* name, Texture** data, int start, int count) {
+  lovrShaderSetTexturesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetImages(Shader* shader, const char* name, Image* data, int start, int count) {
+  lovrShaderSetImagesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetColor(Shader* shader, const char* name, Color color) {
+  lovrShaderSetColorAt(shader, lovrShaderGetUniformHandle(shader, name), color);
+}
+
+void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  lovrShaderSetBlockAt(shader, lovrShaderGetBlockHandle(shader, name), buffer, offset, size, access);
+}
+
+// ShaderBlock
+
+// Calculates uniform size and byte offsets using std140 rules, returning the total buffer size
+size_t lovrShaderComputeUniformLayout(arr_uniform_t* uniforms) {
+  size_t size = 0;
+  for (size_t i = 0; i < uniforms->length; i++) {
+    int align;
+    Uniform* uniform = &uniforms->data[i];
+    if (uniform->count > 1 || uniform->type == UNIFORM_MATRIX) {
+      align = 16;
+      uniform->size = align * uniform->count * (uniform->type == UNIFORM_MATRIX ? uniform->components : 1);
+    } else {
+      align = (uniform->components + (uniform->components == 3)) * 4;
+      uniform->size = uniform->components * 4;
+    }
+    uniform->offset = (size + (align - 1)) & -align;
+    size = uniform->offset + uniform->size;
+  }
+  return size;
+}
+
+ShaderBlock* lovrShaderBlockCreate(BlockType type, Buffer* buffer, arr_uniform_t* uniforms) {
+  ShaderBlock* block = lovrAlloc(ShaderBlock);
+  arr_init(&block->uniforms);
+  map_init(&block->uniformMap, uniforms->length);
+
+  arr_append(&block->uniforms, uniforms->data, uniforms->length);
+
+  for (size_t i = 0; i < block->uniforms.length; i++) {
+    Uniform* uniform = &block->uniforms.data[i];
+    map_set(&block->uniformMap, hash64(uniform->name, strlen(uniform->name)), i);
+  }
+
+  block->type = type;
+  block->buffer = buffer;
+  lovrRetain(buffer);
+  return block;
+}
+
+void lovrShaderBlockDestroy(void* ref) {
+  ShaderBlock* block = ref;
+  lovrRelease(Buffer, block->buffer);
+  arr_free(&block->uniforms);
+  map_free(&block->uniformMap);
+}
+
+BlockType lovrShaderBlockGetType(ShaderBlock* block) {
+  return block->type;
+}
+
+char* lovrShaderBlockGetShaderCode(ShaderBlock* block, const char* blockName, size_t* length) {
+  size_t size = 15 + (block->type == BLOCK_UNIFORM ? 7 : 6) + 1 + strlen(blockName) + 3 + 3;
+  for (size_t i = 0; i < block->uniforms.length; i++) {
+    size += 2 + getUniformTypeLength(&block->uniforms.data[i]) + 1 + strlen(block->uniforms.data[i].name) + 2;
+  }
+
+  char* code = malloc(size + 1);
+  lovrAssert(code, "Out of memory");
+
+  char* s = code;
+  s += sprintf(s, "layout(std140) %s %s {\n", block->type == BLOCK_UNIFORM ? "uniform" : "buffer", blockName);
+  for (size_t i = 0; i < block->uniforms.length; i++) {
+    const Uniform* uniform = &block->uniforms.data[i];
+    if (uniform->count > 1) {
+      s += sprintf(s, "  %s %s[%d];\n", getUniformTypeName(uniform), uniform->name, uniform->count);
+    } else {
+      s += sprintf(s, "  %s %s;\n", getUniformTypeName(uniform), uniform->name);
+    }
+  }
+  s += sprintf(s, "};\n");
+  *s = '\0';
+
+  *length = size;
+  return code;
+}
+
+const Uniform* lovrShaderBlockGetUniform(ShaderBlock* block, const char* name) {
+  uint64_t index = map_get(&block->uniformMap, hash64(name, strlen(name)));
+  return index == MAP_NIL ? NULL : &block->uniforms.data[index];
+}
+
+Buffer* lovrShaderBlockGetBuffer(ShaderBlock* block) {
+  return block->buffer;
+}
+
+// Mesh
+
+Mesh* lovrMeshCreate(DrawMode mode, Buffer* vertexBuffer, uint32_t vertexCount) {
+  Mesh* mesh = lovrAlloc(Mesh);
+  mesh->mode = mode;
+  mesh->vertexBuffer = vertexBuffer;
+  mesh->vertexCount = vertexCount;
+  lovrRetain(mesh->vertexBuffer);
+  map_init(&mesh->attributeMap, MAX_ATTRIBUTES);
+  return mesh;
+}
+
+void lovrMeshDestroy(void* ref) {
+  Mesh* mesh = ref;
+  lovrGraphicsFlushMesh(mesh);
+  for (uint32_t i = 0; i < mesh->attributeCount; i++) {
+    lovrRelease(Buffer, mesh->attributes[i].buffer);
+  }
+  map_free(&mesh->attributeMap);
+  lovrRelease(Buffer, mesh->vertexBuffer);
+  lovrRelease(Buffer, mesh->indexBuffer);
+  lovrRelease(Material, mesh->material);
+}
+
+void lovrMeshSetIndexBuffer(Mesh* mesh, Buffer* buffer, uint32_t indexCount, size_t indexSize, size_t offset) {
+  if (mesh->indexBuffer != buffer || mesh->indexCount != indexCount || mesh->indexSize != indexSize) {
+    lovrGraphicsFlushMesh(mesh);
+    lovrRetain(buffer);
+    lovrRelease(Buffer, mesh->indexBuffer);
+    mesh->indexBuffer = buffer;
+    mesh->indexCount = indexCount;
+    mesh->indexSize = indexSize;
+    mesh->indexOffset = offset;
+  }
+}
+
+Buffer* lovrMeshGetVertexBuffer(Mesh* mesh) {
+  return mesh->vertexBuffer;
+}
+
+Buffer* lovrMeshGetIndexBuffer(Mesh* mesh) {
+  return mesh->indexBuffer;
+}
+
+uint32_t lovrMeshGetVertexCount(Mesh* mesh) {
+  return mesh->vertexCount;
+}
+
+uint32_t lovrMeshGetIndexCount(Mesh* mesh) {
+  return mesh->indexCount;
+}
+
+size_t lovrMeshGetIndexSize(Mesh* mesh) {
+  return mesh->indexSize;
+}
+
+uint32_t lovrMeshGetAttributeCount(Mesh* mesh) {
+  return mesh->attributeCount;
+}
+
+void lovrMeshAttachAttribute(Mesh* mesh, const char* name, MeshAttribute* attribute) {
+  uint64_t hash = hash64(name, strlen(name));
+  lovrAssert(map_get(&mesh->attributeMap, hash) == MAP_NIL, "Mesh already has an attribute named '%s'", name);
+  lovrAssert(mesh->attributeCount < MAX_ATTRIBUTES, "Mesh already has the max number of attributes (%d)", MAX_ATTRIBUTES);
+  lovrAssert(strlen(name) < MAX_ATTRIBUTE_NAME_LENGTH, "Mesh attribute name '%s' is too long (max is %d)", name, MAX_ATTRIBUTE_NAME_LENGTH);
+  lovrGraphicsFlushMesh(mesh);
+  uint64_t index = mesh->attributeCount++;
+  mesh->attributes[index] = *attribute;
+  strcpy(mesh->attributeNames[index], name);
+  map_set(&mesh->attributeMap, hash, index);
+  lovrRetain(attribute->buffer);
+}
+
+void lovrMeshDetachAttribute(Mesh* mesh, const char* name) {
+  uint64_t hash = hash64(name, strlen(name));
+  uint64_t index = map_get(&mesh->attributeMap, hash);
+  lovrAssert(index != MAP_NIL, "No attached attribute named '%s' was found", name);
+  MeshAttribute* attribute = &mesh->attributes[index];
+  lovrGraphicsFlushMesh(mesh);
+  lovrRelease(Buffer, attribute->buffer);
+  map_remove(&mesh->attributeMap, hash);
+  mesh->attributeNames[index][0] = '\0';
+  memmove(mesh->attributeNames + index, mesh->attributeNames + index + 1, (mesh->attributeCount - index - 1) * MAX_ATTRIBUTE_NAME_LENGTH * sizeof(char));
+  memmove(mesh->attributes + index, mesh->attributes + index + 1, (mesh->attributeCount - index - 1) * sizeof(MeshAttribute));
+  mesh->attributeCount--;
+}
+
+const MeshAttribute* lovrMeshGetAttribute(Mesh* mesh, uint32_t index) {
+  return index < mesh->attributeCount ? &mesh->attributes[index] : NULL;
+}
+
+uint32_t lovrMeshGetAttributeIndex(Mesh* mesh, const char* name) {
+  uint64_t hash = hash64(name, strlen(name));
+  uint64_t index = map_get(&mesh->attributeMap, hash);
+  return index == MAP_NIL ? ~0u : index;
+}
+
+const char* lovrMeshGetAttributeName(Mesh* mesh, uint32_t index) {
+  return mesh->attributeNames[index];
+}
+
+bool lovrMeshIsAttributeEnabled(Mesh* mesh, const char* name) {
+  uint64_t hash = hash64(name, strlen(name));
+  uint64_t index = map_get(&mesh->attributeMap, hash);
+  lovrAssert(index != MAP_NIL, "Mesh does not have an attribute named '%s'", name);
+  return !mesh->attributes[index].disabled;
+}
+
+void lovrMeshSetAttributeEnabled(Mesh* mesh, const char* name, bool enable) {
+  bool disable = !enable;
+  uint64_t hash = hash64(name, strlen(name));
+  uint64_t index = map_get(&mesh->attributeMap, hash);
+  lovrAssert(index != MAP_NIL, "Mesh does not have an attribute named '%s'", name);
+  if (mesh->attributes[index].disabled != disable) {
+    lovrGraphicsFlushMesh(mesh);
+    mesh->attributes[index].disabled = disable;
+  }
+}
+
+DrawMode lovrMeshGetDrawMode(Mesh* mesh) {
+  return mesh->mode;
+}
+
+void lovrMeshSetDrawMode(Mesh* mesh, DrawMode mode) {
+  mesh->mode = mode;
+}
+
+void lovrMeshGetDrawRange(Mesh* mesh, uint32_t* start, uint32_t* count) {
+  *start = mesh->drawStart;
+  *count = mesh->drawCount;
+}
+
+void lovrMeshSetDrawRange(Mesh* mesh, uint32_t start, uint32_t count) {
+  uint32_t limit = mesh->indexSize > 0 ? mesh->indexCount : mesh->vertexCount;
+  lovrAssert(start + count <= limit, "Invalid mesh draw range [%d, %d]", start + 1, start + count + 1);
+  mesh->drawStart = start;
+  mesh->drawCount = count;
+}
+
+Material* lovrMeshGetMaterial(Mesh* mesh) {
+  return mesh->material;
+}
+
+void lovrMeshSetMaterial(Mesh* mesh, Material* material) {
+  lovrRetain(material);
+  lovrRelease(Material, mesh->material);
+  mesh->material = material;
+}
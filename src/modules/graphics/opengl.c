@@ -10,6 +10,9 @@
 #include "math/math.h"
 #include "core/hash.h"
 #include "core/ref.h"
+#ifdef LOVR_ENABLE_FILESYSTEM
+#include "filesystem/filesystem.h"
+#endif
 #include <math.h>
 #include <limits.h>
 #include <string.h>
@@ -30,6 +33,9 @@
 #define MAX_TEXTURES 16
 #define MAX_IMAGES 8
 #define MAX_BLOCK_BUFFERS 8
+#define MAX_STAGING_BUFFERS 4
+#define STREAM_BUDGET (4 << 20)
+#define STREAM_PREVIEW_SIZE 64
 
 #define LOVR_SHADER_POSITION 0
 #define LOVR_SHADER_NORMAL 1
@@ -39,9 +45,12 @@
 #define LOVR_SHADER_BONES 5
 #define LOVR_SHADER_BONE_WEIGHTS 6
 #define LOVR_SHADER_DRAW_ID 7
+#define LOVR_SHADER_INSTANCE_TRANSFORM 8
+#define LOVR_SHADER_INSTANCE_COLOR 12
 
 struct Buffer {
   uint32_t id;
+  uint32_t generation;
   void* data;
   size_t size;
   size_t flushFrom;
@@ -71,6 +80,7 @@ struct Texture {
   bool mipmaps;
   bool allocated;
   bool native;
+  bool streaming;
   uint8_t incoherent;
 };
 
@@ -104,6 +114,24 @@ struct Shader {
   map_t attributes;
   map_t uniformMap;
   map_t blockMap;
+  UniformHandle builtins[MAX_BUILTINS];
+  uint64_t* dirtyUniforms;
+  uint16_t textureUniforms[MAX_TEXTURES];
+  uint16_t imageUniforms[MAX_IMAGES];
+  uint16_t textureSlots;
+  uint16_t dirtyTextures;
+  uint8_t imageSlots;
+  uint8_t dirtyImages;
+  uint8_t writableImages;
+  uint8_t dirtyBlocks[2];
+  uint8_t writableBlocks;
+  uint8_t barriers;
+  uint32_t textureVersions[MAX_TEXTURES];
+  uint32_t imageVersions[MAX_IMAGES];
+  uint32_t blockVersions[2][MAX_BLOCK_BUFFERS];
+  uint32_t stages[2];
+  uint64_t cacheKey;
+  bool ready;
   bool multiview;
 };
 
@@ -116,6 +144,8 @@ struct Mesh {
   uint8_t locations[MAX_ATTRIBUTES];
   uint16_t enabledLocations;
   uint16_t divisors[MAX_ATTRIBUTES];
+  uint32_t instanceGeneration;
+  size_t instanceOffset;
   map_t attributeMap;
   uint32_t attributeCount;
   struct Buffer* vertexBuffer;
@@ -157,9 +187,30 @@ typedef struct {
   uint64_t nanoseconds;
 } Timer;
 
+typedef struct {
+  uint32_t head;
+  uint32_t tail;
+  bool visible;
+} Occlusion;
+
+typedef struct {
+  uint32_t id;
+  size_t size;
+  void* fence;
+} StagingBuffer;
+
+typedef struct {
+  Texture* texture;
+  TextureData** slices;
+  uint32_t sliceCount;
+  uint32_t slice;
+  uint32_t level;
+  uint32_t row;
+} TextureStream;
+
 static struct {
   Texture* defaultTexture;
-  enum { NONE, INSTANCED_STEREO, MULTIVIEW } singlepass;
+  StereoMode singlepass;
   bool alphaToCoverage;
   bool blendEnabled;
   BlendMode blendMode;
@@ -181,6 +232,7 @@ static struct {
   uint32_t program;
   Mesh* vertexArray;
   uint32_t buffers[MAX_BUFFER_TYPES];
+  uint32_t bufferGeneration;
   BlockBuffer blockBuffers[2][MAX_BLOCK_BUFFERS];
   int activeTexture;
   Texture* textures[MAX_TEXTURES];
@@ -188,10 +240,23 @@ static struct {
   float viewports[2][4];
   uint32_t viewportCount;
   arr_t(void*) incoherents[MAX_BARRIERS];
+  uint8_t incoherentMask;
+  uint32_t textureVersions[MAX_TEXTURES];
+  uint32_t imageVersions[MAX_IMAGES];
+  uint32_t blockVersions[2][MAX_BLOCK_BUFFERS];
   QueryPool queryPool;
   arr_t(Timer) timers;
   uint32_t activeTimer;
   map_t timerMap;
+  QueryPool occlusionPool;
+  arr_t(Occlusion) occlusions;
+  map_t occlusionMap;
+  bool occluding;
+  StagingBuffer stagingBuffers[MAX_STAGING_BUFFERS];
+  uint32_t stagingIndex;
+  arr_t(TextureStream) textureStreams;
+  bool programCache;
+  uint64_t driverHash;
   GpuFeatures features;
   GpuLimits limits;
   GpuStats stats;
@@ -346,6 +411,18 @@ static GLenum convertTextureFormatType(TextureFormat format) {
   }
 }
 
+static void generateMipmaps(Texture* texture, uint32_t width) {
+#if defined(__APPLE__) || defined(LOVR_WEBGL) // glGenerateMipmap doesn't work on big cubemap textures on macOS
+  if (texture->type != TEXTURE_CUBE || width < 2048) {
+    glGenerateMipmap(texture->target);
+  } else {
+    glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, 0);
+  }
+#else
+  glGenerateMipmap(texture->target);
+#endif
+}
+
 static bool isTextureFormatCompressed(TextureFormat format) {
   switch (format) {
     case FORMAT_DXT1:
@@ -442,6 +519,7 @@ static GLenum convertBufferType(BufferType type) {
     case BUFFER_INDEX: return GL_ELEMENT_ARRAY_BUFFER;
     case BUFFER_UNIFORM: return GL_UNIFORM_BUFFER;
     case BUFFER_SHADER_STORAGE: return GL_SHADER_STORAGE_BUFFER;
+    case BUFFER_INDIRECT: return GL_DRAW_INDIRECT_BUFFER;
     case BUFFER_GENERIC: return GL_COPY_WRITE_BUFFER;
     default: lovrThrow("Unreachable");
   }
@@ -624,6 +702,7 @@ static void lovrGpuSync(uint8_t flags) {
     }
 
     arr_clear(&state.incoherents[i]);
+    state.incoherentMask &= ~(1 << i);
 
     switch (i) {
       case BARRIER_BLOCK: bits |= GL_SHADER_STORAGE_BARRIER_BIT; break;
@@ -653,6 +732,10 @@ static void lovrGpuDestroySyncResource(void* resource, uint8_t incoherent) {
           break;
         }
       }
+
+      if (state.incoherents[i].length == 0) {
+        state.incoherentMask &= ~(1 << i);
+      }
     }
   }
 }
@@ -685,11 +768,13 @@ static void lovrGpuBindBuffer(BufferType type, uint32_t buffer) {
     if (buffer != state.vertexArray->ibo) {
       state.vertexArray->ibo = buffer;
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+      state.stats.bufferBinds++;
     }
   } else {
     if (state.buffers[type] != buffer) {
       state.buffers[type] = buffer;
       glBindBuffer(convertBufferType(type), buffer);
+      state.stats.bufferBinds++;
     }
   }
 }
@@ -709,6 +794,8 @@ static void lovrGpuBindBlockBuffer(BlockType type, uint32_t buffer, int slot, si
     block->offset = offset;
     block->size = size;
     glBindBufferRange(target, slot, buffer, offset, size);
+    state.stats.bufferBinds++;
+    state.blockVersions[type][slot]++;
 
     // Binding to an indexed target also binds to the generic target
     BufferType bufferType = type == BLOCK_UNIFORM ? BUFFER_UNIFORM : BUFFER_SHADER_STORAGE;
@@ -724,11 +811,13 @@ static void lovrGpuBindTexture(Texture* texture, int slot) {
     lovrRetain(texture);
     lovrRelease(Texture, state.textures[slot]);
     state.textures[slot] = texture;
+    state.textureVersions[slot]++;
     if (state.activeTexture != slot) {
       glActiveTexture(GL_TEXTURE0 + slot);
       state.activeTexture = slot;
     }
     glBindTexture(texture->target, texture->id);
+    state.stats.textureBinds++;
   }
 }
 
@@ -753,11 +842,13 @@ static void lovrGpuBindImage(Image* image, int slot) {
     lovrRelease(Texture, state.images[slot].texture);
     glBindImageTexture(slot, texture->id, image->mipmap, layered, slice, glAccess, glFormat);
     memcpy(state.images + slot, image, sizeof(Image));
+    state.stats.textureBinds++;
+    state.imageVersions[slot]++;
   }
 }
 #endif
 
-static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
+static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, Buffer* instanceBuffer, size_t instanceOffset, int baseDivisor) {
   lovrGpuBindVertexArray(mesh);
 
   if (mesh->indexBuffer && mesh->indexCount > 0) {
@@ -793,6 +884,12 @@ static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
 
     mesh->locations[location] = i;
     lovrGpuBindBuffer(BUFFER_VERTEX, attribute->buffer->id);
+
+    // Taking over one of the instance locations invalidates the cached instance pointers
+    if (location >= LOVR_SHADER_INSTANCE_TRANSFORM && location < LOVR_SHADER_INSTANCE_TRANSFORM + 5) {
+      mesh->instanceGeneration = 0;
+    }
+
     GLenum type = convertAttributeType(attribute->type);
     GLvoid* offset = (GLvoid*) (intptr_t) attribute->offset;
 
@@ -803,6 +900,36 @@ static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
     }
   }
 
+  // Streamed instance data is a mat4 transform followed by a color.  The VAO remembers which buffer
+  // range the pointers were last set to, and the locations are marked as not belonging to any of the
+  // Mesh's attributes.  Buffers are identified by generation since GL reuses deleted buffer names.
+  if (instanceBuffer) {
+    bool respecify = mesh->instanceGeneration != instanceBuffer->generation || mesh->instanceOffset != instanceOffset;
+    GLsizei stride = 20 * sizeof(float);
+
+    if (respecify) {
+      lovrGpuBindBuffer(BUFFER_VERTEX, instanceBuffer->id);
+      mesh->instanceGeneration = instanceBuffer->generation;
+      mesh->instanceOffset = instanceOffset;
+    }
+
+    for (int i = 0; i < 5; i++) {
+      int location = LOVR_SHADER_INSTANCE_TRANSFORM + i;
+      enabledLocations |= (1 << location);
+
+      if (respecify) {
+        GLvoid* offset = (GLvoid*) (intptr_t) (instanceOffset + 4 * i * sizeof(float));
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, offset);
+        mesh->locations[location] = 0xff;
+      }
+
+      if (mesh->divisors[location] != baseDivisor) {
+        glVertexAttribDivisor(location, baseDivisor);
+        mesh->divisors[location] = baseDivisor;
+      }
+    }
+  }
+
   uint16_t diff = enabledLocations ^ mesh->enabledLocations;
   if (diff != 0) {
     for (uint32_t i = 0; i < MAX_ATTRIBUTES; i++) {
@@ -851,7 +978,7 @@ static void lovrGpuBindCanvas(Canvas* canvas, bool willDraw) {
     uint32_t slice = attachment->slice;
     uint32_t level = attachment->level;
 
-    if (canvas->flags.stereo && state.singlepass == MULTIVIEW) {
+    if (canvas->flags.stereo && state.singlepass == STEREO_MULTIVIEW) {
 #ifdef LOVR_WEBGL
       lovrThrow("Unreachable");
 #else
@@ -889,6 +1016,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   // Alpha Coverage
   if (state.alphaToCoverage != pipeline->alphaSampling) {
     state.alphaToCoverage = pipeline->alphaSampling;
+    state.stats.pipelineChanges++;
     if (state.alphaToCoverage) {
       glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
     } else {
@@ -900,6 +1028,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   if (state.blendMode != pipeline->blendMode || state.blendAlphaMode != pipeline->blendAlphaMode) {
     state.blendMode = pipeline->blendMode;
     state.blendAlphaMode = pipeline->blendAlphaMode;
+    state.stats.pipelineChanges++;
 
     if (state.blendMode == BLEND_NONE) {
       if (state.blendEnabled) {
@@ -961,12 +1090,14 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   // Color mask
   if (state.colorMask != pipeline->colorMask) {
     state.colorMask = pipeline->colorMask;
+    state.stats.pipelineChanges++;
     glColorMask(state.colorMask & 0x8, state.colorMask & 0x4, state.colorMask & 0x2, state.colorMask & 0x1);
   }
 
   // Culling
   if (state.culling != pipeline->culling) {
     state.culling = pipeline->culling;
+    state.stats.pipelineChanges++;
     if (state.culling) {
       glEnable(GL_CULL_FACE);
     } else {
@@ -978,6 +1109,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   bool updateDepthTest = pipeline->depthTest != state.depthTest;
   bool updateDepthWrite = state.depthWrite != (pipeline->depthWrite && !state.stencilWriting);
   if (updateDepthTest || updateDepthWrite) {
+    state.stats.pipelineChanges++;
     bool enable = state.depthTest != COMPARE_NONE || state.depthWrite;
 
     if (enable && !state.depthEnabled) {
@@ -1001,6 +1133,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   // Line width
   if (state.lineWidth != pipeline->lineWidth) {
     state.lineWidth = pipeline->lineWidth;
+    state.stats.pipelineChanges++;
     glLineWidth(state.lineWidth);
   }
 
@@ -1008,6 +1141,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   if (!state.stencilWriting && (state.stencilMode != pipeline->stencilMode || state.stencilValue != pipeline->stencilValue)) {
     state.stencilMode = pipeline->stencilMode;
     state.stencilValue = pipeline->stencilValue;
+    state.stats.pipelineChanges++;
     if (state.stencilMode != COMPARE_NONE) {
       if (!state.stencilEnabled) {
         state.stencilEnabled = true;
@@ -1036,6 +1170,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   // Winding
   if (state.winding != pipeline->winding) {
     state.winding = pipeline->winding;
+    state.stats.pipelineChanges++;
     glFrontFace(state.winding == WINDING_CLOCKWISE ? GL_CW : GL_CCW);
   }
 
@@ -1043,6 +1178,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 #ifdef LOVR_GL
   if (state.wireframe != pipeline->wireframe) {
     state.wireframe = pipeline->wireframe;
+    state.stats.pipelineChanges++;
     glPolygonMode(GL_FRONT_AND_BACK, state.wireframe ? GL_LINE : GL_FILL);
   }
 #endif
@@ -1051,130 +1187,194 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 static void lovrGpuBindShader(Shader* shader) {
   lovrGpuUseProgram(shader->program);
 
-  // Figure out if we need to wait for pending writes on resources to complete
-#ifndef LOVR_WEBGL
-  uint8_t flags = 0;
-  for (size_t i = 0; i < shader->blocks[BLOCK_COMPUTE].length; i++) {
-    UniformBlock* block = &shader->blocks[BLOCK_COMPUTE].data[i];
-    if (block->source && (block->source->incoherent >> BARRIER_BLOCK) & 1) {
-      flags |= 1 << BARRIER_BLOCK;
-      break;
+  // Each binding slot counts how many times it has changed.  Slots that changed since this shader
+  // last bound them (because of another shader or a texture upload) need to be bound again.
+  for (int slot = 0; slot < MAX_TEXTURES && (shader->textureSlots >> slot); slot++) {
+    if (shader->textureVersions[slot] != state.textureVersions[slot]) {
+      shader->dirtyTextures |= 1 << slot;
     }
   }
 
-  for (size_t i = 0; i < shader->uniforms.length; i++) {
-    Uniform* uniform = &shader->uniforms.data[i];
-    if (uniform->type == UNIFORM_SAMPLER) {
-      for (int j = 0; j < uniform->count; j++) {
-        Texture* texture = uniform->value.textures[j];
-        if (texture && texture->incoherent && (texture->incoherent >> BARRIER_UNIFORM_TEXTURE) & 1) {
+  for (int slot = 0; slot < MAX_IMAGES && (shader->imageSlots >> slot); slot++) {
+    if (shader->imageVersions[slot] != state.imageVersions[slot]) {
+      shader->dirtyImages |= 1 << slot;
+    }
+  }
+
+  for (BlockType type = BLOCK_UNIFORM; type <= BLOCK_COMPUTE; type++) {
+    for (size_t i = 0; i < shader->blocks[type].length; i++) {
+      int slot = shader->blocks[type].data[i].slot;
+      if (shader->blockVersions[type][slot] != state.blockVersions[type][slot]) {
+        shader->dirtyBlocks[type] |= 1 << i;
+      }
+    }
+  }
+
+  // Figure out if we need to wait for pending writes on resources to complete.  This only needs to
+  // look at the shader's resources when there are pending writes of a kind it could be affected by.
+#ifndef LOVR_WEBGL
+  uint8_t barriers = shader->barriers & state.incoherentMask;
+  if (barriers) {
+    uint8_t flags = 0;
+
+    if (barriers & (1 << BARRIER_BLOCK)) {
+      for (size_t i = 0; i < shader->blocks[BLOCK_COMPUTE].length; i++) {
+        UniformBlock* block = &shader->blocks[BLOCK_COMPUTE].data[i];
+        if (block->source && (block->source->incoherent >> BARRIER_BLOCK) & 1) {
+          flags |= 1 << BARRIER_BLOCK;
+          break;
+        }
+      }
+    }
+
+    if (barriers & (1 << BARRIER_UNIFORM_TEXTURE)) {
+      for (int slot = 0; slot < MAX_TEXTURES && (shader->textureSlots >> slot); slot++) {
+        Uniform* uniform = &shader->uniforms.data[shader->textureUniforms[slot]];
+        Texture* texture = uniform->value.textures[slot - uniform->baseSlot];
+        if (texture && (texture->incoherent >> BARRIER_UNIFORM_TEXTURE) & 1) {
           flags |= 1 << BARRIER_UNIFORM_TEXTURE;
-          if (flags & (1 << BARRIER_UNIFORM_IMAGE)) {
-            break;
-          }
+          break;
         }
       }
-    } else if (uniform->type == UNIFORM_IMAGE) {
-      for (int j = 0; j < uniform->count; j++) {
-        Texture* texture = uniform->value.images[j].texture;
-        if (texture && texture->incoherent && (texture->incoherent >> BARRIER_UNIFORM_IMAGE) & 1) {
+    }
+
+    if (barriers & (1 << BARRIER_UNIFORM_IMAGE)) {
+      for (int slot = 0; slot < MAX_IMAGES && (shader->imageSlots >> slot); slot++) {
+        Uniform* uniform = &shader->uniforms.data[shader->imageUniforms[slot]];
+        Texture* texture = uniform->value.images[slot - uniform->baseSlot].texture;
+        if (texture && (texture->incoherent >> BARRIER_UNIFORM_IMAGE) & 1) {
           flags |= 1 << BARRIER_UNIFORM_IMAGE;
-          if (flags & (1 << BARRIER_UNIFORM_TEXTURE)) {
-            break;
-          }
+          break;
         }
       }
     }
-  }
 
-  lovrGpuSync(flags);
+    lovrGpuSync(flags);
+  }
 #endif
 
-  // Bind uniforms
-  for (size_t i = 0; i < shader->uniforms.length; i++) {
-    Uniform* uniform = &shader->uniforms.data[i];
+  // Uniforms
+  for (size_t i = 0; i < (shader->uniforms.length + 63) / 64; i++) {
+    uint64_t dirty = shader->dirtyUniforms[i];
+    shader->dirtyUniforms[i] = 0;
 
-    if (uniform->type != UNIFORM_SAMPLER && uniform->type != UNIFORM_IMAGE && !uniform->dirty) {
-      continue;
-    }
+    for (size_t j = i * 64; dirty; j++, dirty >>= 1) {
+      if (!(dirty & 1)) {
+        continue;
+      }
 
-    uniform->dirty = false;
-    int count = uniform->count;
-    void* data = uniform->value.data;
+      Uniform* uniform = &shader->uniforms.data[j];
+      int count = uniform->count;
+      void* data = uniform->value.data;
+
+      switch (uniform->type) {
+        case UNIFORM_FLOAT:
+          switch (uniform->components) {
+            case 1: glUniform1fv(uniform->location, count, data); break;
+            case 2: glUniform2fv(uniform->location, count, data); break;
+            case 3: glUniform3fv(uniform->location, count, data); break;
+            case 4: glUniform4fv(uniform->location, count, data); break;
+          }
+          break;
 
-    switch (uniform->type) {
-      case UNIFORM_FLOAT:
-        switch (uniform->components) {
-          case 1: glUniform1fv(uniform->location, count, data); break;
-          case 2: glUniform2fv(uniform->location, count, data); break;
-          case 3: glUniform3fv(uniform->location, count, data); break;
-          case 4: glUniform4fv(uniform->location, count, data); break;
-        }
-        break;
+        case UNIFORM_INT:
+          switch (uniform->components) {
+            case 1: glUniform1iv(uniform->location, count, data); break;
+            case 2: glUniform2iv(uniform->location, count, data); break;
+            case 3: glUniform3iv(uniform->location, count, data); break;
+            case 4: glUniform4iv(uniform->location, count, data); break;
+          }
+          break;
 
-      case UNIFORM_INT:
-        switch (uniform->components) {
-          case 1: glUniform1iv(uniform->location, count, data); break;
-          case 2: glUniform2iv(uniform->location, count, data); break;
-          case 3: glUniform3iv(uniform->location, count, data); break;
-          case 4: glUniform4iv(uniform->location, count, data); break;
-        }
-        break;
+        case UNIFORM_MATRIX:
+          switch (uniform->components) {
+            case 2: glUniformMatrix2fv(uniform->location, count, GL_FALSE, data); break;
+            case 3: glUniformMatrix3fv(uniform->location, count, GL_FALSE, data); break;
+            case 4: glUniformMatrix4fv(uniform->location, count, GL_FALSE, data); break;
+          }
+          break;
 
-      case UNIFORM_MATRIX:
-        switch (uniform->components) {
-          case 2: glUniformMatrix2fv(uniform->location, count, GL_FALSE, data); break;
-          case 3: glUniformMatrix3fv(uniform->location, count, GL_FALSE, data); break;
-          case 4: glUniformMatrix4fv(uniform->location, count, GL_FALSE, data); break;
-        }
-        break;
+        default: break;
+      }
 
-      case UNIFORM_IMAGE:
+      state.stats.uniformUploads++;
+    }
+  }
+
+  // Images (writable images are marked as incoherent every time, even if they are already bound)
 #ifndef LOVR_WEBGL
-        for (int j = 0; j < count; j++) {
-          Image* image = &uniform->value.images[j];
-          Texture* texture = image->texture;
-          lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
-
-          // If the Shader can write to the texture, mark it as incoherent
-          if (texture && image->access != ACCESS_READ) {
-            for (Barrier barrier = BARRIER_BLOCK + 1; barrier < MAX_BARRIERS; barrier++) {
-              texture->incoherent |= 1 << barrier;
-              arr_push(&state.incoherents[barrier], texture);
-            }
-          }
+  uint8_t images = shader->dirtyImages | shader->writableImages;
+  for (int slot = 0; images; slot++, images >>= 1) {
+    if (!(images & 1)) {
+      continue;
+    }
 
-          lovrGpuBindImage(image, uniform->baseSlot + j);
-        }
+    Uniform* uniform = &shader->uniforms.data[shader->imageUniforms[slot]];
+    Image* image = &uniform->value.images[slot - uniform->baseSlot];
+    Texture* texture = image->texture;
+    lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
+
+    // If the Shader can write to the texture, mark it as incoherent
+    if (texture && image->access != ACCESS_READ) {
+      for (Barrier barrier = BARRIER_BLOCK + 1; barrier < MAX_BARRIERS; barrier++) {
+        texture->incoherent |= 1 << barrier;
+        arr_push(&state.incoherents[barrier], texture);
+        state.incoherentMask |= 1 << barrier;
+      }
+    }
+
+    lovrGpuBindImage(image, slot);
+    shader->imageVersions[slot] = state.imageVersions[slot];
+  }
 #endif
-        break;
+  shader->dirtyImages = 0;
 
-      case UNIFORM_SAMPLER:
-        for (int j = 0; j < count; j++) {
-          Texture* texture = uniform->value.textures[j];
-          lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
-          lovrAssert(!texture || (uniform->shadow == (texture->compareMode != COMPARE_NONE)), "Uniform '%s' requires a Texture with%s a compare mode", uniform->name, uniform->shadow ? "" : "out");
-          lovrGpuBindTexture(texture, uniform->baseSlot + j);
-        }
-        break;
+  // Textures
+  uint16_t textures = shader->dirtyTextures;
+  for (int slot = 0; textures; slot++, textures >>= 1) {
+    if (!(textures & 1)) {
+      continue;
     }
+
+    Uniform* uniform = &shader->uniforms.data[shader->textureUniforms[slot]];
+    Texture* texture = uniform->value.textures[slot - uniform->baseSlot];
+    lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
+    lovrAssert(!texture || (uniform->shadow == (texture->compareMode != COMPARE_NONE)), "Uniform '%s' requires a Texture with%s a compare mode", uniform->name, uniform->shadow ? "" : "out");
+    lovrGpuBindTexture(texture, slot);
+    shader->textureVersions[slot] = state.textureVersions[slot];
   }
+  shader->dirtyTextures = 0;
 
-  // Bind uniform blocks
+  // Uniform blocks.  Blocks that haven't changed are still unmapped if their buffer has new writes.
   for (BlockType type = BLOCK_UNIFORM; type <= BLOCK_COMPUTE; type++) {
+    uint8_t dirty = shader->dirtyBlocks[type] | (type == BLOCK_COMPUTE ? shader->writableBlocks : 0);
+    shader->dirtyBlocks[type] = 0;
+
     for (size_t i = 0; i < shader->blocks[type].length; i++) {
       UniformBlock* block = &shader->blocks[type].data[i];
-      if (block->source) {
+      Buffer* source = block->source;
+
+      if (source && (source->mapped || source->flushTo > source->flushFrom)) {
+        lovrBufferUnmap(source);
+      }
+
+      if (!((dirty >> i) & 1)) {
+        continue;
+      }
+
+      if (source) {
         if (type == BLOCK_COMPUTE && block->access != ACCESS_READ) {
-          block->source->incoherent |= (1 << BARRIER_BLOCK);
-          arr_push(&state.incoherents[BARRIER_BLOCK], block->source);
+          source->incoherent |= (1 << BARRIER_BLOCK);
+          arr_push(&state.incoherents[BARRIER_BLOCK], source);
+          state.incoherentMask |= 1 << BARRIER_BLOCK;
         }
 
-        lovrBufferUnmap(block->source);
-        lovrGpuBindBlockBuffer(type, block->source->id, block->slot, block->offset, block->size);
+        lovrGpuBindBlockBuffer(type, source->id, block->slot, block->offset, block->size);
       } else {
         lovrGpuBindBlockBuffer(type, 0, block->slot, 0, 0);
       }
+
+      shader->blockVersions[type][block->slot] = state.blockVersions[type][block->slot];
     }
   }
 }
@@ -1195,9 +1395,251 @@ static void lovrGpuSetViewports(float* viewport, uint32_t count) {
 #endif
 }
 
+// Texture streaming
+
+#ifndef LOVR_WEBGL
+// Copies data into the next staging buffer and leaves it bound as the pixel unpack buffer, so the
+// next texture upload reads from it.  Returns false if the buffer is still in use by the GPU.
+static bool lovrGpuStage(const void* data, size_t size) {
+  StagingBuffer* buffer = &state.stagingBuffers[state.stagingIndex];
+
+  if (buffer->fence) {
+    if (glClientWaitSync((GLsync) buffer->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      return false;
+    }
+
+    glDeleteSync((GLsync) buffer->fence);
+    buffer->fence = NULL;
+  }
+
+  if (!buffer->id) {
+    glGenBuffers(1, &buffer->id);
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id);
+
+  if (buffer->size < size) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    buffer->size = size;
+  }
+
+  void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+  memcpy(mapped, data, size);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  state.stats.bytesStreamed += size;
+  return true;
+}
+
+static void lovrGpuUnstage() {
+  state.stagingBuffers[state.stagingIndex].fence = lovrGpuLock();
+  state.stagingIndex = (state.stagingIndex + 1) % MAX_STAGING_BUFFERS;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Uploads the next piece of a stream, returning the number of bytes uploaded (0 if it has to wait).
+// Compressed textures have their whole mip chain, so they are uploaded one mipmap at a time starting
+// from the smallest.  Other textures already have a preview in a small mipmap and upload the full
+// size image a few rows at a time.
+static size_t lovrGpuStepStream(TextureStream* stream, size_t budget) {
+  Texture* texture = stream->texture;
+  TextureData* textureData = stream->slices[stream->slice];
+  GLenum binding = (texture->type == TEXTURE_CUBE) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + stream->slice : texture->target;
+
+  if (isTextureFormatCompressed(textureData->format)) {
+    Mipmap* m = &textureData->mipmaps[stream->level];
+    if (!lovrGpuStage(m->data, m->size)) {
+      return 0;
+    }
+
+    lovrGpuBindTexture(texture, 0);
+    GLenum glInternalFormat = convertTextureFormatInternal(textureData->format, texture->srgb);
+    glCompressedTexImage2D(binding, stream->level, glInternalFormat, m->width, m->height, 0, (GLsizei) m->size, NULL);
+    lovrGpuUnstage();
+
+    if (++stream->slice == stream->sliceCount) {
+      stream->slice = 0;
+      glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, stream->level);
+      texture->streaming = stream->level-- > 0;
+    }
+
+    return m->size;
+  }
+
+  size_t rowSize = textureData->blob->size / textureData->height;
+  uint32_t rowsLeft = textureData->height - stream->row;
+  uint32_t rows = budget / rowSize > 0 ? budget / rowSize : 1;
+  rows = MIN(rows, rowsLeft);
+
+  if (!lovrGpuStage((uint8_t*) textureData->blob->data + stream->row * rowSize, rows * rowSize)) {
+    return 0;
+  }
+
+  lovrGpuBindTexture(texture, 0);
+  GLenum glFormat = convertTextureFormat(textureData->format);
+  GLenum glType = convertTextureFormatType(textureData->format);
+  switch (texture->type) {
+    case TEXTURE_2D:
+    case TEXTURE_CUBE:
+      glTexSubImage2D(binding, 0, 0, stream->row, textureData->width, rows, glFormat, glType, NULL);
+      break;
+    case TEXTURE_ARRAY:
+    case TEXTURE_VOLUME:
+      glTexSubImage3D(binding, 0, 0, stream->row, stream->slice, textureData->width, rows, 1, glFormat, glType, NULL);
+      break;
+  }
+  lovrGpuUnstage();
+
+  stream->row += rows;
+  if (stream->row == textureData->height) {
+    stream->row = 0;
+    if (++stream->slice == stream->sliceCount) {
+      texture->streaming = false;
+      if (texture->mipmaps) {
+        glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, texture->mipmapCount - 1);
+        generateMipmaps(texture, texture->width);
+      }
+    }
+  }
+
+  return rows * rowSize;
+}
+#endif
+
+// Streams pending texture data, up to a fixed number of bytes per frame
+static void lovrGpuStreamTextures() {
+#ifndef LOVR_WEBGL
+  size_t budget = STREAM_BUDGET;
+  while (state.textureStreams.length > 0 && budget > 0) {
+    TextureStream* stream = &state.textureStreams.data[0];
+    size_t size = lovrGpuStepStream(stream, budget);
+
+    if (size == 0) {
+      break;
+    }
+
+    budget = size >= budget ? 0 : budget - size;
+
+    if (!stream->texture->streaming) {
+      for (uint32_t i = 0; i < stream->sliceCount; i++) {
+        lovrRelease(TextureData, stream->slices[i]);
+      }
+      lovrRelease(Texture, stream->texture);
+      free(stream->slices);
+      arr_splice(&state.textureStreams, 0, 1);
+    }
+  }
+#endif
+}
+
 // GPU
 
-void lovrGpuInit(void* (*getProcAddress)(const char*)) {
+#ifdef LOVR_GL
+// Whether one instanced draw is cheaper than a draw per eye depends a lot on the driver, so both are
+// timed with a workload shaped like lovrGpuDraw's: the plain mode changes the viewport and view
+// uniform for every draw, the instanced mode sets both viewports once.
+static StereoMode lovrGpuBenchmarkStereo() {
+  const char* vertexSource = ""
+    "uniform int lovrViewID; \n"
+    "void main() { \n"
+    "#ifdef INSTANCED_STEREO \n"
+    "  gl_ViewportIndex = gl_InstanceID % 2; \n"
+    "#endif \n"
+    "  vec2 uv = vec2(gl_VertexID & 1, gl_VertexID >> 1); \n"
+    "  gl_Position = vec4(uv * .5 + float(lovrViewID) * .001, 0., 1.); \n"
+    "}";
+
+  const char* fragmentSource = ""
+    "#version 150 \n"
+    "out vec4 color; \n"
+    "void main() { color = vec4(1.); }";
+
+  const char* singlepass[] = {
+    [STEREO_NONE] = "",
+    [STEREO_INSTANCED] = "#extension GL_AMD_vertex_shader_viewport_index : require\n#define INSTANCED_STEREO\n"
+  };
+
+  GLuint texture, framebuffer, vertexArray;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 128, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+
+  float viewports[2][4] = { { 0.f, 0.f, 128.f, 128.f }, { 128.f, 0.f, 128.f, 128.f } };
+  double times[2] = { 0., 0. };
+  StereoMode modes[2] = { STEREO_NONE, STEREO_INSTANCED };
+
+  for (int m = 0; m < 2; m++) {
+    const char* vertexSources[] = { "#version 150\n", singlepass[modes[m]], vertexSource };
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(vertexShader, 3, vertexSources, NULL);
+    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+    glCompileShader(vertexShader);
+    glCompileShader(fragmentShader);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      glDeleteProgram(program);
+      times[m] = HUGE_VAL;
+      continue;
+    }
+
+    glUseProgram(program);
+    GLint viewID = glGetUniformLocation(program, "lovrViewID");
+
+    // The first pass is a warmup
+    double start = 0.;
+    for (int pass = 0; pass <= 8; pass++) {
+      if (pass == 1) {
+        glFinish();
+        start = lovrPlatformGetTime();
+      }
+
+      if (modes[m] == STEREO_INSTANCED) {
+        glViewportArrayv(0, 2, &viewports[0][0]);
+        for (int i = 0; i < 256; i++) {
+          glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 2);
+        }
+      } else {
+        for (int i = 0; i < 256; i++) {
+          for (int eye = 0; eye < 2; eye++) {
+            glViewport(viewports[eye][0], viewports[eye][1], viewports[eye][2], viewports[eye][3]);
+            glUniform1i(viewID, eye);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+          }
+        }
+      }
+    }
+
+    glFinish();
+    times[m] = lovrPlatformGetTime() - start;
+    glDeleteProgram(program);
+  }
+
+  glUseProgram(0);
+  glBindVertexArray(0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteTextures(1, &texture);
+  return times[1] < times[0] ? STEREO_INSTANCED : STEREO_NONE;
+}
+#endif
+
+void lovrGpuInit(void* (*getProcAddress)(const char*), StereoMode stereo) {
 #ifdef LOVR_GL
   gladLoadGLLoader((GLADloadproc) getProcAddress);
 #elif defined(LOVR_GLES)
@@ -1208,9 +1650,29 @@ void lovrGpuInit(void* (*getProcAddress)(const char*)) {
   state.features.astc = GLAD_GL_ES_VERSION_3_2;
   state.features.compute = GLAD_GL_ES_VERSION_3_1 || GLAD_GL_ARB_compute_shader;
   state.features.dxt = GLAD_GL_EXT_texture_compression_s3tc;
+  state.features.indirect = GLAD_GL_ARB_multi_draw_indirect;
   state.features.instancedStereo = GLAD_GL_ARB_viewport_array && GLAD_GL_AMD_vertex_shader_viewport_index && GLAD_GL_ARB_fragment_layer_viewport;
   state.features.multiview = GLAD_GL_ES_VERSION_3_0 && GLAD_GL_OVR_multiview2 && GLAD_GL_OVR_multiview_multisampled_render_to_texture;
+  state.features.parallelCompile = GLAD_GL_KHR_parallel_shader_compile;
   state.features.timers = GLAD_GL_VERSION_3_3 || GLAD_GL_EXT_disjoint_timer_query;
+
+  if (state.features.parallelCompile) {
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+  }
+
+#ifdef LOVR_ENABLE_FILESYSTEM
+  // Program binaries are only valid for the driver that produced them, so the driver is part of the cache key
+  GLint binaryFormats = 0;
+  if (GLAD_GL_ES_VERSION_3_0 || GLAD_GL_ARB_get_program_binary) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+  }
+  state.programCache = binaryFormats > 0;
+  const char* driver[] = { (const char*) glGetString(GL_VENDOR), (const char*) glGetString(GL_RENDERER), (const char*) glGetString(GL_VERSION) };
+  for (size_t i = 0; i < sizeof(driver) / sizeof(driver[0]); i++) {
+    state.driverHash = (state.driverHash ^ (driver[i] ? hash64(driver[i], strlen(driver[i])) : 0)) * 0x100000001b3;
+  }
+#endif
+
 #ifdef LOVR_GL
   glEnable(GL_LINE_SMOOTH);
   glEnable(GL_PROGRAM_POINT_SIZE);
@@ -1219,12 +1681,27 @@ void lovrGpuInit(void* (*getProcAddress)(const char*)) {
 #endif
   glGetFloatv(GL_POINT_SIZE_RANGE, state.limits.pointSizes);
 
-  if (state.features.multiview) {
-    state.singlepass = MULTIVIEW;
+#ifdef LOVR_USE_OCULUS_MOBILE
+  // The Oculus Mobile swapchain is a 2 layer array texture that only multiview can render to
+  lovrAssert(stereo == STEREO_AUTO || stereo == STEREO_MULTIVIEW, "Oculus Mobile requires the multiview stereo mode");
+  stereo = STEREO_MULTIVIEW;
+#endif
+
+  // Explicitly requested modes are used if they're supported.  Otherwise multiview is preferred,
+  // since headset swapchains depend on it where it's available.
+  bool supported[] = { true, state.features.instancedStereo, state.features.multiview, false };
+  if (supported[stereo]) {
+    state.singlepass = stereo;
+  } else if (state.features.multiview) {
+    state.singlepass = STEREO_MULTIVIEW;
   } else if (state.features.instancedStereo) {
-    state.singlepass = INSTANCED_STEREO;
+#ifdef LOVR_GL
+    state.singlepass = stereo == STEREO_AUTO ? lovrGpuBenchmarkStereo() : STEREO_INSTANCED;
+#else
+    state.singlepass = STEREO_INSTANCED;
+#endif
   } else {
-    state.singlepass = NONE;
+    state.singlepass = STEREO_NONE;
   }
 #else
   glGetFloatv(GL_ALIASED_POINT_SIZE_RANGE, state.limits.pointSizes);
@@ -1301,6 +1778,9 @@ void lovrGpuInit(void* (*getProcAddress)(const char*)) {
   map_init(&state.timerMap, 4);
   state.queryPool.next = ~0u;
   state.activeTimer = ~0u;
+
+  map_init(&state.occlusionMap, 4);
+  state.occlusionPool.next = ~0u;
 }
 
 void lovrGpuDestroy() {
@@ -1314,10 +1794,27 @@ void lovrGpuDestroy() {
   for (int i = 0; i < MAX_BARRIERS; i++) {
     arr_free(&state.incoherents[i]);
   }
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    for (uint32_t j = 0; j < stream->sliceCount; j++) {
+      lovrRelease(TextureData, stream->slices[j]);
+    }
+    lovrRelease(Texture, stream->texture);
+    free(stream->slices);
+  }
+  arr_free(&state.textureStreams);
+  for (int i = 0; i < MAX_STAGING_BUFFERS; i++) {
+    glDeleteBuffers(1, &state.stagingBuffers[i].id);
+    lovrGpuDestroyLock(state.stagingBuffers[i].fence);
+  }
   glDeleteQueries(state.queryPool.count, state.queryPool.queries);
   free(state.queryPool.queries);
   arr_free(&state.timers);
   map_free(&state.timerMap);
+  glDeleteQueries(state.occlusionPool.count, state.occlusionPool.queries);
+  free(state.occlusionPool.queries);
+  arr_free(&state.occlusions);
+  map_free(&state.occlusionMap);
   memset(&state, 0, sizeof(state));
 }
 
@@ -1384,29 +1881,53 @@ void lovrGpuDiscard(Canvas* canvas, bool color, bool depth, bool stencil) {
 }
 
 void lovrGpuDraw(DrawCommand* draw) {
-  lovrAssert(state.singlepass != MULTIVIEW || draw->shader->multiview == draw->canvas->flags.stereo, "Shader and Canvas multiview settings must match!");
-  uint32_t viewportCount = (draw->canvas->flags.stereo && state.singlepass != MULTIVIEW) ? 2 : 1;
-  uint32_t drawCount = state.singlepass == NONE ? viewportCount : 1;
-  uint32_t instanceMultiplier = state.singlepass == INSTANCED_STEREO ? viewportCount : 1;
+  lovrAssert(state.singlepass != STEREO_MULTIVIEW || draw->shader->multiview == draw->canvas->flags.stereo, "Shader and Canvas multiview settings must match!");
+  uint32_t viewportCount = (draw->canvas->flags.stereo && state.singlepass != STEREO_MULTIVIEW) ? 2 : 1;
+  uint32_t drawCount = state.singlepass == STEREO_NONE ? viewportCount : 1;
+  uint32_t instanceMultiplier = state.singlepass == STEREO_INSTANCED ? viewportCount : 1;
   uint32_t viewportsPerDraw = instanceMultiplier;
   uint32_t instances = MAX(draw->instances, 1) * instanceMultiplier;
 
-  float w = state.singlepass == MULTIVIEW ? draw->canvas->width : draw->canvas->width / (float) viewportCount;
+  float w = state.singlepass == STEREO_MULTIVIEW ? draw->canvas->width : draw->canvas->width / (float) viewportCount;
   float h = draw->canvas->height;
   float viewports[2][4] = { { 0.f, 0.f, w, h }, { w, 0.f, w, h } };
-  lovrShaderSetInts(draw->shader, "lovrViewportCount", &(int) { viewportCount }, 0, 1);
+  lovrShaderSetIntsAt(draw->shader, draw->shader->builtins[BUILTIN_VIEWPORT_COUNT], &(int) { viewportCount }, 0, 1);
+  lovrShaderSetIntsAt(draw->shader, draw->shader->builtins[BUILTIN_INSTANCE_STREAM], &(int) { draw->instanceBuffer != NULL }, 0, 1);
 
   lovrGpuBindCanvas(draw->canvas, true);
   lovrGpuBindPipeline(&draw->pipeline);
-  lovrGpuBindMesh(draw->mesh, draw->shader, instanceMultiplier);
+  lovrGpuBindMesh(draw->mesh, draw->shader, draw->instanceBuffer, draw->instanceOffset, instanceMultiplier);
 
   for (uint32_t i = 0; i < drawCount; i++) {
     lovrGpuSetViewports(&viewports[i][0], viewportsPerDraw);
-    lovrShaderSetInts(draw->shader, "lovrViewID", &(int) { i }, 0, 1);
+    lovrShaderSetIntsAt(draw->shader, draw->shader->builtins[BUILTIN_VIEW_ID], &(int) { i }, 0, 1);
     lovrGpuBindShader(draw->shader);
 
     Mesh* mesh = draw->mesh;
     GLenum topology = convertTopology(draw->topology);
+
+#ifndef LOVR_WEBGL
+    // Commands written by a compute shader need a barrier before they can be consumed
+    if (draw->indirectBuffer) {
+      if ((draw->indirectBuffer->incoherent >> BARRIER_BLOCK) & 1) {
+        lovrGpuSync(1 << BARRIER_BLOCK);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+      }
+
+      lovrGpuBindBuffer(BUFFER_INDIRECT, draw->indirectBuffer->id);
+      lovrBufferUnmap(draw->indirectBuffer);
+      if (mesh->indexCount > 0) {
+        GLenum indexType = mesh->indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        glMultiDrawElementsIndirect(topology, indexType, NULL, draw->indirectCount, sizeof(IndirectCommand));
+      } else {
+        glMultiDrawArraysIndirect(topology, NULL, draw->indirectCount, sizeof(IndirectCommand));
+      }
+
+      state.stats.drawCalls++;
+      continue;
+    }
+#endif
+
     if (mesh->indexCount > 0) {
       GLenum indexType = mesh->indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
       GLvoid* offset = (GLvoid*) (mesh->indexOffset + draw->rangeStart * mesh->indexSize);
@@ -1427,10 +1948,18 @@ void lovrGpuDraw(DrawCommand* draw) {
   }
 }
 
+// Stats are reset before streaming textures, so the uploads and binds show up in the next frame
 void lovrGpuPresent() {
   state.stats.shaderSwitches = 0;
   state.stats.renderPasses = 0;
   state.stats.drawCalls = 0;
+  state.stats.streamStalls = 0;
+  state.stats.pipelineChanges = 0;
+  state.stats.bufferBinds = 0;
+  state.stats.textureBinds = 0;
+  state.stats.uniformUploads = 0;
+  state.stats.bytesStreamed = 0;
+  lovrGpuStreamTextures();
 }
 
 void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata) {
@@ -1461,38 +1990,50 @@ void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback call
   state.stencilMode = ~0; // Dirty
 }
 
-void lovrGpuDirtyTexture() {
-  lovrRelease(Texture, state.textures[state.activeTexture]);
-  state.textures[state.activeTexture] = NULL;
+// WebGL copies buffer contents when they're unmapped, so there is never anything to wait for
+void* lovrGpuLock() {
+#ifdef LOVR_WEBGL
+  return NULL;
+#else
+  return (void*) glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
 }
 
-void lovrGpuTick(const char* label) {
+void lovrGpuUnlock(void* lock) {
 #ifndef LOVR_WEBGL
-  lovrAssert(state.activeTimer == ~0u, "Attempt to start a new GPU timer while one is already active!");
-  QueryPool* pool = &state.queryPool;
-  uint64_t hash = hash64(label, strlen(label));
-  uint64_t index = map_get(&state.timerMap, hash);
-
-  // Create new timer
-  if (index == MAP_NIL) {
-    index = state.timers.length++;
-    map_set(&state.timerMap, hash, index);
-    arr_reserve(&state.timers, state.timers.length);
-    state.timers.data[index].head = ~0u;
-    state.timers.data[index].tail = ~0u;
+  if (!lock) return;
+  GLsync sync = (GLsync) lock;
+  if (glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED) {
+    state.stats.streamStalls++;
+    while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1E9) == GL_TIMEOUT_EXPIRED) {
+      continue;
+    }
   }
+#endif
+}
 
-  Timer* timer = &state.timers.data[index];
-  state.activeTimer = index;
+void lovrGpuDestroyLock(void* lock) {
+#ifndef LOVR_WEBGL
+  if (lock) glDeleteSync((GLsync) lock);
+#endif
+}
+
+void lovrGpuDirtyTexture() {
+  lovrRelease(Texture, state.textures[state.activeTexture]);
+  state.textures[state.activeTexture] = NULL;
+  state.textureVersions[state.activeTexture]++;
+}
 
-  // Expand pool if no unused timers are available.
-  // The pool manages one memory allocation split into two chunks.
-  // - The first chunk contains OpenGL query objects (GLuint).
-  // - The second chunk is a linked list of query indices (uint32_t), used for two purposes:
-  //   - For inactive queries, pool->chain[query] points to the next inactive query (freelist).
-  //   - For active queries, pool->chain[query] points to the next active query for that timer.
-  // When resizing the query pool allocation, the second half of the old allocation needs to be
-  // copied to the second half of the new allocation.
+#ifndef LOVR_WEBGL
+// The pool manages one memory allocation split into two chunks.
+// - The first chunk contains OpenGL query objects (GLuint).
+// - The second chunk is a linked list of query indices (uint32_t), used for two purposes:
+//   - For inactive queries, pool->chain[query] points to the next inactive query (freelist).
+//   - For active queries, pool->chain[query] points to the next active query for that timer.
+// When resizing the query pool allocation, the second half of the old allocation needs to be
+// copied to the second half of the new allocation.  A query object can only be used with one
+// target, so timers and occlusion queries have separate pools.
+static uint32_t lovrGpuAcquireQuery(QueryPool* pool) {
   if (pool->next == ~0u) {
     uint32_t n = pool->count;
     pool->count = n == 0 ? 4 : (n << 1);
@@ -1508,25 +2049,54 @@ void lovrGpuTick(const char* label) {
     pool->next = n;
   }
 
-  // Start query, update linked list pointers
   uint32_t query = pool->next;
-  glBeginQuery(GL_TIME_ELAPSED, pool->queries[query]);
-  if (timer->tail != ~0u) { pool->chain[timer->tail] = query; }
-  if (timer->head == ~0u) { timer->head = query; }
   pool->next = pool->chain[query];
   pool->chain[query] = ~0u;
-  timer->tail = query;
-#endif
+  return query;
 }
 
-double lovrGpuTock(const char* label) {
+static void lovrGpuReleaseQuery(QueryPool* pool, uint32_t query) {
+  pool->chain[query] = pool->next;
+  pool->next = query;
+}
+#endif
+
+void lovrGpuTick(const char* label) {
 #ifndef LOVR_WEBGL
+  lovrAssert(state.activeTimer == ~0u, "Attempt to start a new GPU timer while one is already active!");
   QueryPool* pool = &state.queryPool;
   uint64_t hash = hash64(label, strlen(label));
   uint64_t index = map_get(&state.timerMap, hash);
 
+  // Create new timer
   if (index == MAP_NIL) {
-    return 0.;
+    index = state.timers.length++;
+    map_set(&state.timerMap, hash, index);
+    arr_reserve(&state.timers, state.timers.length);
+    state.timers.data[index].head = ~0u;
+    state.timers.data[index].tail = ~0u;
+  }
+
+  Timer* timer = &state.timers.data[index];
+  state.activeTimer = index;
+
+  // Start query, update linked list pointers
+  uint32_t query = lovrGpuAcquireQuery(pool);
+  glBeginQuery(GL_TIME_ELAPSED, pool->queries[query]);
+  if (timer->tail != ~0u) { pool->chain[timer->tail] = query; }
+  if (timer->head == ~0u) { timer->head = query; }
+  timer->tail = query;
+#endif
+}
+
+double lovrGpuTock(const char* label) {
+#ifndef LOVR_WEBGL
+  QueryPool* pool = &state.queryPool;
+  uint64_t hash = hash64(label, strlen(label));
+  uint64_t index = map_get(&state.timerMap, hash);
+
+  if (index == MAP_NIL) {
+    return 0.;
   }
 
   Timer* timer = &state.timers.data[index];
@@ -1554,8 +2124,7 @@ double lovrGpuTock(const char* label) {
 
     // Update timer's head pointer and return the completed query back to the pool
     timer->head = pool->chain[query];
-    pool->chain[query] = pool->next;
-    pool->next = query;
+    lovrGpuReleaseQuery(pool, query);
 
     if (timer->head == ~0u) {
       timer->tail = ~0u;
@@ -1568,6 +2137,108 @@ double lovrGpuTock(const char* label) {
   return 0.;
 }
 
+#ifndef LOVR_WEBGL
+// Reads the results of an occlusion query's finished queries, oldest first.  The newest pending
+// query stays in the chain so conditional rendering can still use it.
+static void lovrGpuPollOcclusion(Occlusion* occlusion) {
+  QueryPool* pool = &state.occlusionPool;
+  while (occlusion->head != ~0u) {
+    uint32_t query = occlusion->head;
+
+    GLuint available;
+    glGetQueryObjectuiv(pool->queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available) {
+      break;
+    }
+
+    GLuint samples;
+    glGetQueryObjectuiv(pool->queries[query], GL_QUERY_RESULT, &samples);
+    occlusion->visible = samples > 0;
+    occlusion->head = pool->chain[query];
+    lovrGpuReleaseQuery(pool, query);
+  }
+
+  if (occlusion->head == ~0u) {
+    occlusion->tail = ~0u;
+  }
+}
+#endif
+
+// Renders the draws in the callback inside an occlusion query, and returns whether the most recent
+// finished query for the label had any visible samples.  Labels that haven't finished a query yet
+// are considered visible.
+bool lovrGpuOcclude(const char* label, StencilCallback callback, void* userdata) {
+#ifndef LOVR_WEBGL
+  lovrAssert(!state.occluding, "Occlusion queries can not be nested");
+  uint64_t hash = hash64(label, strlen(label));
+  uint64_t index = map_get(&state.occlusionMap, hash);
+
+  if (index == MAP_NIL) {
+    index = state.occlusions.length;
+    map_set(&state.occlusionMap, hash, index);
+    arr_push(&state.occlusions, ((Occlusion) { .head = ~0u, .tail = ~0u, .visible = true }));
+  }
+
+  Occlusion* occlusion = &state.occlusions.data[index];
+  lovrGpuPollOcclusion(occlusion);
+
+  QueryPool* pool = &state.occlusionPool;
+  uint32_t query = lovrGpuAcquireQuery(pool);
+  lovrGraphicsFlush();
+  glBeginQuery(GL_ANY_SAMPLES_PASSED, pool->queries[query]);
+  state.occluding = true;
+  callback(userdata);
+  lovrGraphicsFlush();
+  state.occluding = false;
+  glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+  if (occlusion->tail != ~0u) { pool->chain[occlusion->tail] = query; }
+  if (occlusion->head == ~0u) { occlusion->head = query; }
+  occlusion->tail = query;
+  return occlusion->visible;
+#else
+  callback(userdata);
+  return true;
+#endif
+}
+
+// Renders the draws in the callback only if the last occlusion query for the label was visible.
+// When the newest query is still pending, the GPU decides using that query without waiting for it
+// (it draws if the result isn't ready).  GLES has no conditional rendering, so it only uses the
+// last finished result.
+void lovrGpuConditional(const char* label, StencilCallback callback, void* userdata) {
+#ifndef LOVR_WEBGL
+  uint64_t hash = hash64(label, strlen(label));
+  uint64_t index = map_get(&state.occlusionMap, hash);
+
+  if (index == MAP_NIL) {
+    callback(userdata);
+    return;
+  }
+
+  Occlusion* occlusion = &state.occlusions.data[index];
+  lovrGpuPollOcclusion(occlusion);
+
+#ifdef LOVR_GL
+  if (occlusion->tail != ~0u) {
+    lovrGraphicsFlush();
+    glBeginConditionalRender(state.occlusionPool.queries[occlusion->tail], GL_QUERY_NO_WAIT);
+    callback(userdata);
+    lovrGraphicsFlush();
+    glEndConditionalRender();
+    return;
+  }
+#endif
+
+  if (occlusion->visible) {
+    callback(userdata);
+  }
+#else
+  callback(userdata);
+#endif
+}
+
 const GpuFeatures* lovrGpuGetFeatures() {
   return &state.features;
 }
@@ -1580,6 +2251,10 @@ const GpuStats* lovrGpuGetStats() {
   return &state.stats;
 }
 
+StereoMode lovrGpuGetStereoMode() {
+  return state.singlepass;
+}
+
 // Texture
 
 Texture* lovrTextureCreate(TextureType type, TextureData** slices, uint32_t sliceCount, bool srgb, bool mipmaps, uint32_t msaa) {
@@ -1715,6 +2390,7 @@ void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint
 void lovrTextureReplacePixels(Texture* texture, TextureData* textureData, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
   lovrGraphicsFlush();
   lovrAssert(texture->allocated, "Texture is not allocated");
+  lovrAssert(!texture->streaming, "Can not replace the pixels of a Texture that is still streaming");
 
 #ifndef LOVR_WEBGL
   if ((texture->incoherent >> BARRIER_TEXTURE) & 1) {
@@ -1765,18 +2441,104 @@ void lovrTextureReplacePixels(Texture* texture, TextureData* textureData, uint32
         break;
     }
 
+    state.stats.bytesStreamed += textureData->blob->size;
+
     if (texture->mipmaps) {
-#if defined(__APPLE__) || defined(LOVR_WEBGL) // glGenerateMipmap doesn't work on big cubemap textures on macOS
-      if (texture->type != TEXTURE_CUBE || width < 2048) {
-        glGenerateMipmap(texture->target);
-      } else {
-        glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, 0);
-      }
+      generateMipmaps(texture, width);
+    }
+  }
+}
+
+void lovrTextureStream(Texture* texture, TextureData** slices, uint32_t sliceCount) {
+#ifdef LOVR_WEBGL
+  bool streamable = false;
 #else
-      glGenerateMipmap(texture->target);
+  // Uncompressed textures sample a preview mipmap while they stream, so they need mipmaps
+  bool compressed = isTextureFormatCompressed(slices[0]->format);
+  bool streamable = texture->type != TEXTURE_VOLUME && !(compressed && texture->type == TEXTURE_ARRAY) && (compressed || texture->mipmapCount > 1);
 #endif
+
+  if (!streamable) {
+    for (uint32_t i = 0; i < sliceCount; i++) {
+      lovrTextureReplacePixels(texture, slices[i], 0, 0, i, 0);
+    }
+    return;
+  }
+
+#ifndef LOVR_WEBGL
+  lovrGraphicsFlush();
+  lovrAssert(texture->allocated, "Texture is not allocated");
+  lovrAssert(!texture->streaming, "Texture is already streaming");
+  lovrAssert(sliceCount == texture->depth, "Streamed textures must replace every slice");
+
+  if ((texture->incoherent >> BARRIER_TEXTURE) & 1) {
+    lovrGpuSync(1 << BARRIER_TEXTURE);
+  }
+
+  for (uint32_t i = 0; i < sliceCount; i++) {
+    lovrAssert(slices[i]->width == texture->width && slices[i]->height == texture->height, "Streamed texture slices must match the size of the Texture");
+    lovrAssert(compressed || slices[i]->blob->data, "Trying to stream Texture pixels with empty pixel data");
+    lovrRetain(slices[i]);
+  }
+
+  TextureStream stream = { .texture = texture, .slices = malloc(sliceCount * sizeof(TextureData*)), .sliceCount = sliceCount };
+  lovrAssert(stream.slices, "Out of memory");
+  memcpy(stream.slices, slices, sliceCount * sizeof(TextureData*));
+  lovrRetain(texture);
+  texture->streaming = true;
+  lovrGpuBindTexture(texture, 0);
+
+  // Compressed mipmaps get uploaded smallest first, and the base level is lowered as each one arrives
+  if (compressed) {
+    stream.level = slices[0]->mipmapCount - 1;
+    glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, stream.level);
+    glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, stream.level);
+    arr_push(&state.textureStreams, stream);
+    return;
+  }
+
+  // Otherwise, point sample a small mipmap right away so the Texture is usable while it streams
+  uint32_t level = 0;
+  while (level < texture->mipmapCount - 1 && ((MAX(texture->width, texture->height)) >> level) > STREAM_PREVIEW_SIZE) {
+    level++;
+  }
+
+  uint32_t width = lovrTextureGetWidth(texture, level);
+  uint32_t height = lovrTextureGetHeight(texture, level);
+  size_t pixelSize = slices[0]->blob->size / (slices[0]->width * slices[0]->height);
+  uint8_t* preview = malloc(width * height * pixelSize);
+  lovrAssert(preview, "Out of memory");
+
+  GLenum glFormat = convertTextureFormat(slices[0]->format);
+  GLenum glType = convertTextureFormatType(slices[0]->format);
+  for (uint32_t i = 0; i < sliceCount; i++) {
+    uint8_t* pixels = slices[i]->blob->data;
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++) {
+        uint32_t sx = x << level;
+        uint32_t sy = y << level;
+        memcpy(preview + (y * width + x) * pixelSize, pixels + (sy * slices[i]->width + sx) * pixelSize, pixelSize);
+      }
+    }
+
+    if (texture->type == TEXTURE_ARRAY) {
+      glTexSubImage3D(texture->target, level, 0, 0, i, width, height, 1, glFormat, glType, preview);
+    } else {
+      GLenum binding = (texture->type == TEXTURE_CUBE) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : texture->target;
+      glTexSubImage2D(binding, level, 0, 0, width, height, glFormat, glType, preview);
     }
   }
+
+  free(preview);
+  glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, level);
+  glTexParameteri(texture->target, GL_TEXTURE_MAX_LEVEL, level);
+
+  arr_push(&state.textureStreams, stream);
+#endif
+}
+
+bool lovrTextureIsStreaming(Texture* texture) {
+  return texture->streaming;
 }
 
 uint64_t lovrTextureGetId(Texture* texture) {
@@ -1888,7 +2650,7 @@ void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
 
 Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
   Canvas* canvas = lovrAlloc(Canvas);
-  if (flags.stereo && state.singlepass != MULTIVIEW) {
+  if (flags.stereo && state.singlepass != STEREO_MULTIVIEW) {
     width *= 2;
   }
 
@@ -1902,7 +2664,7 @@ Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
   if (flags.depth.enabled) {
     lovrAssert(isTextureFormatDepth(flags.depth.format), "Canvas depth buffer can't use a color TextureFormat");
     GLenum attachment = flags.depth.format == FORMAT_D24S8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
-    if (flags.stereo && state.singlepass == MULTIVIEW) {
+    if (flags.stereo && state.singlepass == STEREO_MULTIVIEW) {
       // Zero MSAA is intentional here, we attach it to the Canvas using legacy MSAA technique
       canvas->depth.texture = lovrTextureCreate(TEXTURE_ARRAY, NULL, 0, false, flags.mipmaps, 0);
       lovrTextureAllocate(canvas->depth.texture, width, height, 2, flags.depth.format);
@@ -1924,7 +2686,7 @@ Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
     }
   }
 
-  if (flags.msaa && (!flags.stereo || state.singlepass != MULTIVIEW)) {
+  if (flags.msaa && (!flags.stereo || state.singlepass != STEREO_MULTIVIEW)) {
     glGenFramebuffers(1, &canvas->resolveBuffer);
   }
 
@@ -1967,7 +2729,7 @@ void lovrCanvasResolve(Canvas* canvas) {
 
   // We don't need to resolve a multiview Canvas because it uses the legacy multisampling method in
   // which the driver does an implicit multisample resolve whenever the canvas textures are read.
-  if (canvas->flags.msaa && (!canvas->flags.stereo || state.singlepass != MULTIVIEW)) {
+  if (canvas->flags.msaa && (!canvas->flags.stereo || state.singlepass != STEREO_MULTIVIEW)) {
     uint32_t w = canvas->width;
     uint32_t h = canvas->height;
     glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas->framebuffer);
@@ -2112,6 +2874,7 @@ Buffer* lovrBufferCreate(size_t size, void* data, BufferType type, BufferUsage u
   buffer->readable = readable;
   buffer->type = type;
   buffer->usage = usage;
+  buffer->generation = ++state.bufferGeneration;
   glGenBuffers(1, &buffer->id);
   lovrGpuBindBuffer(type, buffer->id);
   GLenum glType = convertBufferType(type);
@@ -2184,13 +2947,16 @@ void lovrBufferUnmap(Buffer* buffer) {
     lovrGpuBindBuffer(buffer->type, buffer->id);
     void* data = (uint8_t*) buffer->data + buffer->flushFrom;
     glBufferSubData(convertBufferType(buffer->type), buffer->flushFrom, buffer->flushTo - buffer->flushFrom, data);
+    state.stats.bytesStreamed += buffer->flushTo - buffer->flushFrom;
   }
 #else
-  if (buffer->mapped || GLAD_GL_ARB_buffer_storage) {
+  // Persistently mapped buffers only need to be bound when there's a range to flush
+  if (buffer->mapped || (GLAD_GL_ARB_buffer_storage && buffer->flushTo > buffer->flushFrom)) {
     lovrGpuBindBuffer(buffer->type, buffer->id);
 
     if (buffer->flushTo > buffer->flushFrom) {
       glFlushMappedBufferRange(convertBufferType(buffer->type), buffer->flushFrom, buffer->flushTo - buffer->flushFrom);
+      state.stats.bytesStreamed += buffer->flushTo - buffer->flushFrom;
     }
 
     if (buffer->mapped) {
@@ -2232,7 +2998,11 @@ static GLuint compileShader(GLenum type, const char** sources, int* lengths, int
   GLuint shader = glCreateShader(type);
   glShaderSource(shader, count, sources, lengths);
   glCompileShader(shader);
+  return shader;
+}
 
+// Querying the status waits for the compile, so with parallel compilation this is put off until the shader is needed
+static void checkShader(GLuint shader) {
   int isShaderCompiled;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &isShaderCompiled);
   if (!isShaderCompiled) {
@@ -2241,6 +3011,8 @@ static GLuint compileShader(GLenum type, const char** sources, int* lengths, int
     char* log = malloc(logLength);
     lovrAssert(log, "Out of memory");
     glGetShaderInfoLog(shader, logLength, &logLength, log);
+    GLint type;
+    glGetShaderiv(shader, GL_SHADER_TYPE, &type);
     const char* name;
     switch (type) {
       case GL_VERTEX_SHADER: name = "vertex shader"; break;
@@ -2250,13 +3022,9 @@ static GLuint compileShader(GLenum type, const char** sources, int* lengths, int
     }
     lovrThrow("Could not compile %s:\n%s", name, log);
   }
-
-  return shader;
 }
 
-static GLuint linkProgram(GLuint program) {
-  glLinkProgram(program);
-
+static void checkProgram(GLuint program) {
   int isLinked;
   glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
   if (!isLinked) {
@@ -2267,8 +3035,76 @@ static GLuint linkProgram(GLuint program) {
     glGetProgramInfoLog(program, logLength, &logLength, log);
     lovrThrow("Could not link shader:\n%s", log);
   }
+}
 
-  return program;
+// Program binary cache, stored as shaders/<key>.bin in the save directory
+
+typedef struct {
+  uint64_t key;
+  uint32_t format;
+  uint32_t size;
+} ProgramBinaryHeader;
+
+static uint64_t hashSources(uint64_t hash, const char** sources, int* lengths, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    size_t length = lengths[i] < 0 ? strlen(sources[i]) : (size_t) lengths[i];
+    hash = (hash ^ hash64(sources[i], length)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+static bool loadProgramBinary(GLuint program, uint64_t key) {
+#if defined(LOVR_ENABLE_FILESYSTEM) && !defined(LOVR_WEBGL)
+  if (!state.programCache) {
+    return false;
+  }
+
+  char path[32];
+  snprintf(path, sizeof(path), "shaders/%016llx.bin", (unsigned long long) key);
+
+  size_t size;
+  ProgramBinaryHeader* header = lovrFilesystemRead(path, -1, &size);
+  if (!header) {
+    return false;
+  }
+
+  GLint isLinked = false;
+  if (size >= sizeof(*header) && header->key == key && header->size == size - sizeof(*header)) {
+    glProgramBinary(program, header->format, header + 1, header->size);
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+  }
+
+  free(header);
+  return isLinked;
+#else
+  return false;
+#endif
+}
+
+static void saveProgramBinary(GLuint program, uint64_t key) {
+#if defined(LOVR_ENABLE_FILESYSTEM) && !defined(LOVR_WEBGL)
+  if (!state.programCache) {
+    return;
+  }
+
+  GLint length;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  ProgramBinaryHeader* header = malloc(sizeof(*header) + length);
+  lovrAssert(header, "Out of memory");
+  header->key = key;
+  glGetProgramBinary(program, length, &length, &header->format, header + 1);
+  header->size = length;
+
+  char path[32];
+  snprintf(path, sizeof(path), "shaders/%016llx.bin", (unsigned long long) key);
+  lovrFilesystemCreateDirectory("shaders");
+  lovrFilesystemWrite(path, (const char*) header, sizeof(*header) + length, false);
+  free(header);
+#endif
 }
 
 static void lovrShaderSetupUniforms(Shader* shader) {
@@ -2384,7 +3220,6 @@ static void lovrShaderSetupUniforms(Shader* shader) {
 #endif
     uniform.textureType = getUniformTextureType(glType);
     uniform.baseSlot = uniform.type == UNIFORM_SAMPLER ? textureSlot : (uniform.type == UNIFORM_IMAGE ? imageSlot : -1);
-    uniform.dirty = false;
 
     int blockIndex;
     glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
@@ -2465,11 +3300,43 @@ static void lovrShaderSetupUniforms(Shader* shader) {
       offset += uniform.components * (uniform.type == UNIFORM_MATRIX ? uniform.components : 1);
     }
 
+    if (uniform.type == UNIFORM_SAMPLER) {
+      lovrAssert(textureSlot + uniform.count <= MAX_TEXTURES, "Shader uses too many textures, the max is %d", MAX_TEXTURES);
+      for (int j = 0; j < uniform.count; j++) {
+        shader->textureUniforms[textureSlot + j] = shader->uniforms.length;
+      }
+    } else if (uniform.type == UNIFORM_IMAGE) {
+      lovrAssert(imageSlot + uniform.count <= MAX_IMAGES, "Shader uses too many images, the max is %d", MAX_IMAGES);
+      for (int j = 0; j < uniform.count; j++) {
+        shader->imageUniforms[imageSlot + j] = shader->uniforms.length;
+      }
+    }
+
     map_set(&shader->uniformMap, hash64(uniform.name, length), shader->uniforms.length);
     arr_push(&shader->uniforms, uniform);
     textureSlot += uniform.type == UNIFORM_SAMPLER ? uniform.count : 0;
     imageSlot += uniform.type == UNIFORM_IMAGE ? uniform.count : 0;
   }
+
+  // Dirty tracking, everything gets bound the first time the shader is used
+  shader->dirtyUniforms = calloc((shader->uniforms.length + 63) / 64 + 1, sizeof(uint64_t));
+  lovrAssert(shader->dirtyUniforms, "Out of memory");
+  shader->textureSlots = shader->dirtyTextures = (1 << textureSlot) - 1;
+  shader->imageSlots = shader->dirtyImages = (1 << imageSlot) - 1;
+  shader->dirtyBlocks[BLOCK_UNIFORM] = (1 << shader->blocks[BLOCK_UNIFORM].length) - 1;
+  shader->dirtyBlocks[BLOCK_COMPUTE] = (1 << shader->blocks[BLOCK_COMPUTE].length) - 1;
+  shader->barriers = 0;
+  shader->barriers |= shader->blocks[BLOCK_COMPUTE].length > 0 ? (1 << BARRIER_BLOCK) : 0;
+  shader->barriers |= textureSlot > 0 ? (1 << BARRIER_UNIFORM_TEXTURE) : 0;
+  shader->barriers |= imageSlot > 0 ? (1 << BARRIER_UNIFORM_IMAGE) : 0;
+
+  // Builtins (the maps are read directly, the handle getters would try to resolve the shader again)
+  for (int i = 0; i < MAX_BUILTINS; i++) {
+    const char* name = lovrShaderBuiltinUniforms[i];
+    map_t* map = i < BUILTIN_FIRST_BLOCK ? &shader->uniformMap : &shader->blockMap;
+    uint64_t index = map_get(map, hash64(name, strlen(name)));
+    shader->builtins[i] = index == MAP_NIL ? LOVR_UNIFORM_NONE : (UniformHandle) index;
+  }
 }
 
 static char* lovrShaderGetFlagCode(ShaderFlag* flags, uint32_t flagCount) {
@@ -2507,7 +3374,56 @@ static char* lovrShaderGetFlagCode(ShaderFlag* flags, uint32_t flagCount) {
   return code;
 }
 
-Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+// Finishes creating a shader once its program is linked.  Shaders compiled in the background are
+// resolved lazily, the first time anything needs to know about their uniforms or attributes.
+static void lovrShaderResolve(Shader* shader) {
+  if (shader->ready) {
+    return;
+  }
+
+  uint32_t program = shader->program;
+
+  if (shader->stages[0]) {
+    checkShader(shader->stages[0]);
+    checkShader(shader->stages[1]);
+    checkProgram(program);
+    glDetachShader(program, shader->stages[0]);
+    glDeleteShader(shader->stages[0]);
+    glDetachShader(program, shader->stages[1]);
+    glDeleteShader(shader->stages[1]);
+    shader->stages[0] = shader->stages[1] = 0;
+    saveProgramBinary(program, shader->cacheKey);
+  }
+
+  if (shader->type == SHADER_GRAPHICS) {
+
+    // Generic attributes
+    lovrGpuUseProgram(program);
+    glVertexAttrib4fv(LOVR_SHADER_VERTEX_COLOR, (float[4]) { 1., 1., 1., 1. });
+    glVertexAttribI4uiv(LOVR_SHADER_BONES, (uint32_t[4]) { 0., 0., 0., 0. });
+    glVertexAttrib4fv(LOVR_SHADER_BONE_WEIGHTS, (float[4]) { 1., 0., 0., 0. });
+    glVertexAttribI4ui(LOVR_SHADER_DRAW_ID, 0, 0, 0, 0);
+  }
+
+  lovrShaderSetupUniforms(shader);
+
+  // Attribute cache
+  int32_t attributeCount;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+  map_init(&shader->attributes, 0);
+  for (int i = 0; i < attributeCount; i++) {
+    char name[LOVR_MAX_ATTRIBUTE_LENGTH];
+    GLint size;
+    GLenum type;
+    GLsizei length;
+    glGetActiveAttrib(program, i, LOVR_MAX_ATTRIBUTE_LENGTH, &length, &size, &type, name);
+    map_set(&shader->attributes, hash64(name, length), glGetAttribLocation(program, name));
+  }
+
+  shader->ready = true;
+}
+
+static Shader* lovrShaderInitGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview, bool deferred, bool instanceStream) {
   Shader* shader = lovrAlloc(Shader);
 #if defined(LOVR_WEBGL) || defined(LOVR_GLES)
   const char* version = "#version 300 es\n";
@@ -2516,86 +3432,100 @@ Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLengt
 #endif
 
   const char* singlepass[2] = { "", "" };
-  if (multiview && state.singlepass == MULTIVIEW) {
+  if (multiview && state.singlepass == STEREO_MULTIVIEW) {
     singlepass[0] = singlepass[1] = "#extension GL_OVR_multiview2 : require\n#define MULTIVIEW\n";
-  } else if (state.singlepass == INSTANCED_STEREO) {
+  } else if (state.singlepass == STEREO_INSTANCED) {
     singlepass[0] = "#extension GL_AMD_vertex_shader_viewport_index : require\n""#define INSTANCED_STEREO\n";
     singlepass[1] = "#extension GL_ARB_fragment_layer_viewport : require\n""#define INSTANCED_STEREO\n";
   }
 
   char* flagSource = lovrShaderGetFlagCode(flags, flagCount);
 
-  // Vertex
+  // The size of the transform and color blocks depends on the uniform block size limit
+  char maxDraws[32];
+  snprintf(maxDraws, sizeof(maxDraws), "#define MAX_DRAWS %u\n", lovrGraphicsGetMaxDraws());
+
+  // Streamed instance attributes take up 5 locations, so only the default shaders declare them unless
+  // a shader asks for them with the instanceStream flag
+  const char* instancing = instanceStream ? "#define FLAG_instanceStream\n" : "";
+
   vertexSource = vertexSource == NULL ? lovrUnlitVertexShader : vertexSource;
-  const char* vertexSources[] = { version, singlepass[0], flagSource ? flagSource : "", lovrShaderVertexPrefix, vertexSource, lovrShaderVertexSuffix };
-  int vertexSourceLengths[] = { -1, -1, -1, -1, vertexSourceLength, -1 };
+  const char* vertexSources[] = { version, singlepass[0], flagSource ? flagSource : "", instancing, maxDraws, lovrShaderVertexPrefix, vertexSource, lovrShaderVertexSuffix };
+  int vertexSourceLengths[] = { -1, -1, -1, -1, -1, -1, vertexSourceLength, -1 };
   size_t vertexSourceCount = sizeof(vertexSources) / sizeof(vertexSources[0]);
-  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSources, vertexSourceLengths, vertexSourceCount);
 
-  // Fragment
   fragmentSource = fragmentSource == NULL ? lovrUnlitFragmentShader : fragmentSource;
   const char* fragmentSources[] = { version, singlepass[1], flagSource ? flagSource : "", lovrShaderFragmentPrefix, fragmentSource, lovrShaderFragmentSuffix };
   int fragmentSourceLengths[] = { -1, -1, -1, -1, fragmentSourceLength, -1 };
   size_t fragmentSourceCount = sizeof(fragmentSources) / sizeof(fragmentSources[0]);
-  GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
 
-  free(flagSource);
+  // The full sources already include the flags and the stereo mode, but multiview also changes how
+  // the shader can be used so it is mixed in explicitly
+  uint64_t key = (state.driverHash ^ multiview) * 0x100000001b3;
+  key = hashSources(key, vertexSources, vertexSourceLengths, vertexSourceCount);
+  key = hashSources(key, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
 
-  // Link
   uint32_t program = glCreateProgram();
-  glAttachShader(program, vertexShader);
-  glAttachShader(program, fragmentShader);
-  glBindAttribLocation(program, LOVR_SHADER_POSITION, "lovrPosition");
-  glBindAttribLocation(program, LOVR_SHADER_NORMAL, "lovrNormal");
-  glBindAttribLocation(program, LOVR_SHADER_TEX_COORD, "lovrTexCoord");
-  glBindAttribLocation(program, LOVR_SHADER_VERTEX_COLOR, "lovrVertexColor");
-  glBindAttribLocation(program, LOVR_SHADER_TANGENT, "lovrTangent");
-  glBindAttribLocation(program, LOVR_SHADER_BONES, "lovrBones");
-  glBindAttribLocation(program, LOVR_SHADER_BONE_WEIGHTS, "lovrBoneWeights");
-  glBindAttribLocation(program, LOVR_SHADER_DRAW_ID, "lovrDrawID");
-  linkProgram(program);
-  glDetachShader(program, vertexShader);
-  glDeleteShader(vertexShader);
-  glDetachShader(program, fragmentShader);
-  glDeleteShader(fragmentShader);
-  shader->program = program;
-  shader->type = SHADER_GRAPHICS;
-
-  // Generic attributes
-  lovrGpuUseProgram(program);
-  glVertexAttrib4fv(LOVR_SHADER_VERTEX_COLOR, (float[4]) { 1., 1., 1., 1. });
-  glVertexAttribI4uiv(LOVR_SHADER_BONES, (uint32_t[4]) { 0., 0., 0., 0. });
-  glVertexAttrib4fv(LOVR_SHADER_BONE_WEIGHTS, (float[4]) { 1., 0., 0., 0. });
-  glVertexAttribI4ui(LOVR_SHADER_DRAW_ID, 0, 0, 0, 0);
-
-  lovrShaderSetupUniforms(shader);
+  if (!loadProgramBinary(program, key)) {
+    glDeleteProgram(program);
+    program = glCreateProgram();
+
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSources, vertexSourceLengths, vertexSourceCount);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
+
+    // Link
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, LOVR_SHADER_POSITION, "lovrPosition");
+    glBindAttribLocation(program, LOVR_SHADER_NORMAL, "lovrNormal");
+    glBindAttribLocation(program, LOVR_SHADER_TEX_COORD, "lovrTexCoord");
+    glBindAttribLocation(program, LOVR_SHADER_VERTEX_COLOR, "lovrVertexColor");
+    glBindAttribLocation(program, LOVR_SHADER_TANGENT, "lovrTangent");
+    glBindAttribLocation(program, LOVR_SHADER_BONES, "lovrBones");
+    glBindAttribLocation(program, LOVR_SHADER_BONE_WEIGHTS, "lovrBoneWeights");
+    glBindAttribLocation(program, LOVR_SHADER_DRAW_ID, "lovrDrawID");
+    glBindAttribLocation(program, LOVR_SHADER_INSTANCE_TRANSFORM, "lovrInstanceTransform");
+    glBindAttribLocation(program, LOVR_SHADER_INSTANCE_COLOR, "lovrInstanceColor");
+#ifndef LOVR_WEBGL
+    if (state.programCache) {
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+#endif
+    glLinkProgram(program);
 
-  // Attribute cache
-  int32_t attributeCount;
-  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
-  map_init(&shader->attributes, 0);
-  for (int i = 0; i < attributeCount; i++) {
-    char name[LOVR_MAX_ATTRIBUTE_LENGTH];
-    GLint size;
-    GLenum type;
-    GLsizei length;
-    glGetActiveAttrib(program, i, LOVR_MAX_ATTRIBUTE_LENGTH, &length, &size, &type, name);
-    map_set(&shader->attributes, hash64(name, length), glGetAttribLocation(program, name));
+    shader->stages[0] = vertexShader;
+    shader->stages[1] = fragmentShader;
+    shader->cacheKey = key;
   }
 
+  free(flagSource);
+
+  shader->program = program;
+  shader->type = SHADER_GRAPHICS;
   shader->multiview = multiview;
 
+  if (!deferred) {
+    lovrShaderResolve(shader);
+  }
+
   return shader;
 }
 
+Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+  return lovrShaderInitGraphics(vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength, flags, flagCount, multiview, false, false);
+}
+
+// Default shaders never fail to compile, so when the driver can compile in the background there's
+// no reason to wait for them here
 Shader* lovrShaderCreateDefault(DefaultShader type, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+  bool deferred = state.features.parallelCompile;
   switch (type) {
-    case SHADER_UNLIT: return lovrShaderCreateGraphics(NULL, -1, NULL, -1, flags, flagCount, multiview);
-    case SHADER_STANDARD: return lovrShaderCreateGraphics(lovrStandardVertexShader, -1, lovrStandardFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_CUBE: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrCubeFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_PANO: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrPanoFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_FONT: return lovrShaderCreateGraphics(NULL, -1, lovrFontFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_FILL: return lovrShaderCreateGraphics(lovrFillVertexShader, -1, NULL, -1, flags, flagCount, multiview);
+    case SHADER_UNLIT: return lovrShaderInitGraphics(NULL, -1, NULL, -1, flags, flagCount, multiview, deferred, true);
+    case SHADER_STANDARD: return lovrShaderInitGraphics(lovrStandardVertexShader, -1, lovrStandardFragmentShader, -1, flags, flagCount, multiview, deferred, true);
+    case SHADER_CUBE: return lovrShaderInitGraphics(lovrCubeVertexShader, -1, lovrCubeFragmentShader, -1, flags, flagCount, multiview, deferred, true);
+    case SHADER_PANO: return lovrShaderInitGraphics(lovrCubeVertexShader, -1, lovrPanoFragmentShader, -1, flags, flagCount, multiview, deferred, true);
+    case SHADER_FONT: return lovrShaderInitGraphics(NULL, -1, lovrFontFragmentShader, -1, flags, flagCount, multiview, deferred, true);
+    case SHADER_FILL: return lovrShaderInitGraphics(lovrFillVertexShader, -1, NULL, -1, flags, flagCount, multiview, deferred, true);
     default: lovrThrow("Unknown default shader type"); return NULL;
   }
 }
@@ -2612,14 +3542,16 @@ Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flag
   size_t count = sizeof(sources) / sizeof(sources[0]);
   GLuint computeShader = compileShader(GL_COMPUTE_SHADER, sources, lengths, count);
   free(flagSource);
+  checkShader(computeShader);
   GLuint program = glCreateProgram();
   glAttachShader(program, computeShader);
-  linkProgram(program);
+  glLinkProgram(program);
+  checkProgram(program);
   glDetachShader(program, computeShader);
   glDeleteShader(computeShader);
   shader->program = program;
   shader->type = SHADER_COMPUTE;
-  lovrShaderSetupUniforms(shader);
+  lovrShaderResolve(shader);
 #endif
   return shader;
 }
@@ -2627,6 +3559,10 @@ Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flag
 void lovrShaderDestroy(void* ref) {
   Shader* shader = ref;
   lovrGraphicsFlushShader(shader);
+  if (shader->stages[0]) {
+    glDeleteShader(shader->stages[0]);
+    glDeleteShader(shader->stages[1]);
+  }
   glDeleteProgram(shader->program);
   for (size_t i = 0; i < shader->uniforms.length; i++) {
     free(shader->uniforms.data[i].value.data);
@@ -2636,6 +3572,7 @@ void lovrShaderDestroy(void* ref) {
       lovrRelease(Buffer, shader->blocks[type].data[i].source);
     }
   }
+  free(shader->dirtyUniforms);
   arr_free(&shader->uniforms);
   arr_free(&shader->blocks[BLOCK_UNIFORM]);
   arr_free(&shader->blocks[BLOCK_COMPUTE]);
@@ -2649,77 +3586,119 @@ ShaderType lovrShaderGetType(Shader* shader) {
 }
 
 int lovrShaderGetAttributeLocation(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
   uint64_t location = map_get(&shader->attributes, hash64(name, strlen(name)));
   return location == MAP_NIL ? -1 : (int) location;
 }
 
 bool lovrShaderHasUniform(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
   return map_get(&shader->uniformMap, hash64(name, strlen(name))) != MAP_NIL;
 }
 
 bool lovrShaderHasBlock(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
   return map_get(&shader->blockMap, hash64(name, strlen(name))) != MAP_NIL;
 }
 
 const Uniform* lovrShaderGetUniform(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
   uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
   return index == MAP_NIL ? NULL : &shader->uniforms.data[index];
 }
 
-static void lovrShaderSetUniform(Shader* shader, const char* name, UniformType type, void* data, int start, int count, int size, const char* debug) {
+UniformHandle lovrShaderGetUniformHandle(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
   uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
-  if (index == MAP_NIL) {
+  return index == MAP_NIL ? LOVR_UNIFORM_NONE : (UniformHandle) index;
+}
+
+UniformHandle lovrShaderGetBlockHandle(Shader* shader, const char* name) {
+  lovrShaderResolve(shader);
+  uint64_t id = map_get(&shader->blockMap, hash64(name, strlen(name)));
+  return id == MAP_NIL ? LOVR_UNIFORM_NONE : (UniformHandle) id;
+}
+
+UniformHandle lovrShaderGetBuiltin(Shader* shader, BuiltinUniform builtin) {
+  lovrShaderResolve(shader);
+  return shader->builtins[builtin];
+}
+
+const Uniform* lovrShaderGetUniformAt(Shader* shader, UniformHandle handle) {
+  lovrShaderResolve(shader);
+  return handle < shader->uniforms.length ? &shader->uniforms.data[handle] : NULL;
+}
+
+static void lovrShaderSetUniform(Shader* shader, UniformHandle handle, UniformType type, void* data, int start, int count, int size, const char* debug) {
+  if (handle == LOVR_UNIFORM_NONE) {
     return;
   }
 
-  Uniform* uniform = &shader->uniforms.data[index];
-  lovrAssert(uniform->type == type, "Unable to send %ss to uniform %s", debug, name);
-  lovrAssert((start + count) * size <= uniform->size, "Too many %ss for uniform %s, maximum is %d", debug, name, uniform->size / size);
+  Uniform* uniform = &shader->uniforms.data[handle];
+  lovrAssert(uniform->type == type, "Unable to send %ss to uniform %s", debug, uniform->name);
+  lovrAssert((start + count) * size <= uniform->size, "Too many %ss for uniform %s, maximum is %d", debug, uniform->name, uniform->size / size);
 
   void* dest = uniform->value.bytes + start * size;
   if (memcmp(dest, data, count * size)) {
     lovrGraphicsFlushShader(shader);
     memcpy(dest, data, count * size);
-    uniform->dirty = true;
+
+    switch (type) {
+      case UNIFORM_SAMPLER:
+        shader->dirtyTextures |= ((1 << count) - 1) << (uniform->baseSlot + start);
+        break;
+
+      case UNIFORM_IMAGE:
+        shader->dirtyImages |= ((1 << count) - 1) << (uniform->baseSlot + start);
+        for (int i = start; i < start + count; i++) {
+          uint8_t bit = 1 << (uniform->baseSlot + i);
+          bool writable = uniform->value.images[i].texture && uniform->value.images[i].access != ACCESS_READ;
+          shader->writableImages = writable ? (shader->writableImages | bit) : (shader->writableImages & ~bit);
+        }
+        break;
+
+      default:
+        shader->dirtyUniforms[handle / 64] |= 1ull << (handle % 64);
+        break;
+    }
   }
 }
 
-void lovrShaderSetFloats(Shader* shader, const char* name, float* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, data, start, count, sizeof(float), "float");
+void lovrShaderSetFloatsAt(Shader* shader, UniformHandle handle, float* data, int start, int count) {
+  lovrShaderSetUniform(shader, handle, UNIFORM_FLOAT, data, start, count, sizeof(float), "float");
 }
 
-void lovrShaderSetInts(Shader* shader, const char* name, int* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_INT, data, start, count, sizeof(int), "int");
+void lovrShaderSetIntsAt(Shader* shader, UniformHandle handle, int* data, int start, int count) {
+  lovrShaderSetUniform(shader, handle, UNIFORM_INT, data, start, count, sizeof(int), "int");
 }
 
-void lovrShaderSetMatrices(Shader* shader, const char* name, float* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_MATRIX, data, start, count, sizeof(float), "float");
+void lovrShaderSetMatricesAt(Shader* shader, UniformHandle handle, float* data, int start, int count) {
+  lovrShaderSetUniform(shader, handle, UNIFORM_MATRIX, data, start, count, sizeof(float), "float");
 }
 
-void lovrShaderSetTextures(Shader* shader, const char* name, Texture** data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_SAMPLER, data, start, count, sizeof(Texture*), "texture");
+void lovrShaderSetTexturesAt(Shader* shader, UniformHandle handle, Texture** data, int start, int count) {
+  lovrShaderSetUniform(shader, handle, UNIFORM_SAMPLER, data, start, count, sizeof(Texture*), "texture");
 }
 
-void lovrShaderSetImages(Shader* shader, const char* name, Image* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_IMAGE, data, start, count, sizeof(Image), "image");
+void lovrShaderSetImagesAt(Shader* shader, UniformHandle handle, Image* data, int start, int count) {
+  lovrShaderSetUniform(shader, handle, UNIFORM_IMAGE, data, start, count, sizeof(Image), "image");
 }
 
-void lovrShaderSetColor(Shader* shader, const char* name, Color color) {
+void lovrShaderSetColorAt(Shader* shader, UniformHandle handle, Color color) {
   color.r = lovrMathGammaToLinear(color.r);
   color.g = lovrMathGammaToLinear(color.g);
   color.b = lovrMathGammaToLinear(color.b);
-  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, (float*) &color, 0, 4, sizeof(float), "float");
+  lovrShaderSetUniform(shader, handle, UNIFORM_FLOAT, (float*) &color, 0, 4, sizeof(float), "float");
 }
 
-void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
-  uint64_t id = map_get(&shader->blockMap, hash64(name, strlen(name)));
-  if (id == MAP_NIL) return;
+void lovrShaderSetBlockAt(Shader* shader, UniformHandle handle, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  if (handle == LOVR_UNIFORM_NONE) return;
 
-  int type = id & 1;
-  int index = id >> 1;
+  int type = handle & 1;
+  int index = handle >> 1;
   UniformBlock* block = &shader->blocks[type].data[index];
 
-  if (block->source != buffer || block->offset != offset || block->size != size) {
+  if (block->source != buffer || block->offset != offset || block->size != size || block->access != access) {
     lovrGraphicsFlushShader(shader);
     lovrRetain(buffer);
     lovrRelease(Buffer, block->source);
@@ -2727,9 +3706,44 @@ void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t
     block->source = buffer;
     block->offset = offset;
     block->size = size;
+    shader->dirtyBlocks[type] |= 1 << index;
+
+    if (type == BLOCK_COMPUTE) {
+      uint8_t bit = 1 << index;
+      bool writable = buffer && access != ACCESS_READ;
+      shader->writableBlocks = writable ? (shader->writableBlocks | bit) : (shader->writableBlocks & ~bit);
+    }
   }
 }
 
+void lovrShaderSetFloats(Shader* shader, const char* name, float* data, int start, int count) {
+  lovrShaderSetFloatsAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetInts(Shader* shader, const char* name, int* data, int start, int count) {
+  lovrShaderSetIntsAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetMatrices(Shader* shader, const char* name, float* data, int start, int count) {
+  lovrShaderSetMatricesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetTextures(Shader* shader, const char* name, Texture** data, int start, int count) {
+  lovrShaderSetTexturesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetImages(Shader* shader, const char* name, Image* data, int start, int count) {
+  lovrShaderSetImagesAt(shader, lovrShaderGetUniformHandle(shader, name), data, start, count);
+}
+
+void lovrShaderSetColor(Shader* shader, const char* name, Color color) {
+  lovrShaderSetColorAt(shader, lovrShaderGetUniformHandle(shader, name), color);
+}
+
+void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  lovrShaderSetBlockAt(shader, lovrShaderGetBlockHandle(shader, name), buffer, offset, size, access);
+}
+
 // ShaderBlock
 
 // Calculates uniform size and byte offsets using std140 rules, returning the total buffer size
@@ -0,0 +1,245 @@
+#include "graphics/scene.h"
+#include "graphics/buffer.h"
+#include "graphics/mesh.h"
+#include "math/math.h"
+#include "core/maf.h"
+#include "core/ref.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Each frame's buffers keep their own range of objects that changed since they were last uploaded
+static void markDirty(Scene* scene, uint32_t from, uint32_t to) {
+  for (uint32_t i = 0; i < SCENE_FRAMES; i++) {
+    scene->frames[i].dirtyFrom = MIN(scene->frames[i].dirtyFrom, from);
+    scene->frames[i].dirtyTo = MAX(scene->frames[i].dirtyTo, to);
+  }
+}
+
+static void upload(Buffer* buffer, void* data, size_t offset, size_t size) {
+  memcpy(lovrBufferMap(buffer, offset), (uint8_t*) data + offset, size);
+  lovrBufferFlush(buffer, offset, size);
+  lovrBufferUnmap(buffer);
+}
+
+Scene* lovrSceneInit(Scene* scene, Mesh* mesh, uint32_t capacity) {
+  lovrAssert(capacity > 0, "Scene capacity must be positive");
+  scene->mesh = mesh;
+  lovrRetain(mesh);
+  scene->capacity = capacity;
+  scene->culling = true;
+  scene->instanceData = malloc(capacity * sizeof(SceneInstance));
+  scene->boundsData = malloc(capacity * 4 * sizeof(float));
+  scene->commandData = malloc(capacity * sizeof(IndirectCommand));
+  lovrAssert(scene->instanceData && scene->boundsData && scene->commandData, "Out of memory");
+
+  // Without indirect draws the objects are drawn one at a time from the instance buffer, and culled
+  // on the CPU.  Culling on the GPU also needs compute shaders.
+  const GpuFeatures* features = lovrGpuGetFeatures();
+  for (uint32_t i = 0; i < SCENE_FRAMES; i++) {
+    SceneFrame* frame = &scene->frames[i];
+    frame->dirtyFrom = ~0u;
+    frame->instances = lovrBufferCreate(capacity * sizeof(SceneInstance), NULL, BUFFER_VERTEX, USAGE_DYNAMIC, false);
+
+    if (features->indirect) {
+      frame->commands = lovrBufferCreate(capacity * sizeof(IndirectCommand), NULL, BUFFER_INDIRECT, USAGE_DYNAMIC, false);
+
+      if (features->compute) {
+        frame->bounds = lovrBufferCreate(capacity * 4 * sizeof(float), NULL, BUFFER_SHADER_STORAGE, USAGE_DYNAMIC, false);
+      }
+    }
+  }
+
+  return scene;
+}
+
+void lovrSceneDestroy(void* ref) {
+  Scene* scene = ref;
+  for (uint32_t i = 0; i < SCENE_FRAMES; i++) {
+    lovrGpuDestroyLock(scene->frames[i].lock);
+    lovrRelease(Buffer, scene->frames[i].instances);
+    lovrRelease(Buffer, scene->frames[i].bounds);
+    lovrRelease(Buffer, scene->frames[i].commands);
+  }
+  lovrRelease(Mesh, scene->mesh);
+  free(scene->instanceData);
+  free(scene->boundsData);
+  free(scene->commandData);
+}
+
+Mesh* lovrSceneGetMesh(Scene* scene) {
+  return scene->mesh;
+}
+
+uint32_t lovrSceneGetCount(Scene* scene) {
+  return scene->count;
+}
+
+uint32_t lovrSceneGetCapacity(Scene* scene) {
+  return scene->capacity;
+}
+
+uint32_t lovrSceneAdd(Scene* scene, float* transform, Color color, uint32_t start, uint32_t count, float* bounds) {
+  lovrAssert(scene->count < scene->capacity, "Scene is full (it can hold %d objects)", scene->capacity);
+  uint32_t index = scene->count++;
+
+  SceneInstance* instance = &scene->instanceData[index];
+  if (transform) {
+    mat4_init(instance->transform, transform);
+  } else {
+    mat4_identity(instance->transform);
+  }
+
+  lovrSceneSetColor(scene, index, color);
+
+  // Objects without bounds have a negative radius and are never culled
+  float* sphere = scene->boundsData + 4 * index;
+  if (bounds) {
+    memcpy(sphere, bounds, 4 * sizeof(float));
+  } else {
+    sphere[0] = sphere[1] = sphere[2] = 0.f;
+    sphere[3] = -1.f;
+  }
+
+  scene->commandData[index] = (IndirectCommand) {
+    .count = count,
+    .start = start,
+    .baseInstance = index
+  };
+
+  markDirty(scene, index, index + 1);
+  return index;
+}
+
+void lovrSceneClear(Scene* scene) {
+  scene->count = 0;
+  for (uint32_t i = 0; i < SCENE_FRAMES; i++) {
+    scene->frames[i].dirtyFrom = ~0u;
+    scene->frames[i].dirtyTo = 0;
+  }
+}
+
+void lovrSceneSetTransform(Scene* scene, uint32_t index, float* transform) {
+  lovrAssert(index < scene->count, "Invalid Scene object index: %d", index + 1);
+  mat4_init(scene->instanceData[index].transform, transform);
+  markDirty(scene, index, index + 1);
+}
+
+Color lovrSceneGetColor(Scene* scene, uint32_t index) {
+  lovrAssert(index < scene->count, "Invalid Scene object index: %d", index + 1);
+  Color color = scene->instanceData[index].color;
+  color.r = lovrMathLinearToGamma(color.r);
+  color.g = lovrMathLinearToGamma(color.g);
+  color.b = lovrMathLinearToGamma(color.b);
+  return color;
+}
+
+void lovrSceneSetColor(Scene* scene, uint32_t index, Color color) {
+  lovrAssert(index < scene->count, "Invalid Scene object index: %d", index + 1);
+  color.r = lovrMathGammaToLinear(color.r);
+  color.g = lovrMathGammaToLinear(color.g);
+  color.b = lovrMathGammaToLinear(color.b);
+  scene->instanceData[index].color = color;
+  markDirty(scene, index, index + 1);
+}
+
+bool lovrSceneIsCullingEnabled(Scene* scene) {
+  return scene->culling;
+}
+
+// The culling shader overwrites the instance counts of the commands, so they're restored when
+// culling gets turned off
+void lovrSceneSetCullingEnabled(Scene* scene, bool culling) {
+  if (scene->culling && !culling && scene->count > 0) {
+    markDirty(scene, 0, scene->count);
+  }
+
+  scene->culling = culling;
+}
+
+// Tests the bounding sphere of an object against each group of 6 frustum planes, the object is
+// visible if it isn't completely behind one of the planes of any group
+bool lovrSceneIsVisible(Scene* scene, uint32_t index, float planes[][4], uint32_t planeCount) {
+  float* sphere = scene->boundsData + 4 * index;
+  if (sphere[3] < 0.f) {
+    return true;
+  }
+
+  float* m = scene->instanceData[index].transform;
+  float center[4] = { sphere[0], sphere[1], sphere[2], 1.f };
+  mat4_transform(m, center);
+  float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+  float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+  float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+  float scale = MAX(sx, sy);
+  scale = MAX(scale, sz);
+  float radius = sphere[3] * sqrtf(scale);
+
+  for (uint32_t i = 0; i < planeCount; i += 6) {
+    bool inside = true;
+    for (uint32_t j = i; j < i + 6 && inside; j++) {
+      float* p = planes[j];
+      inside = p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3] >= -radius;
+    }
+
+    if (inside) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Uploads changed objects and returns the buffers to draw with.  If anything changed since the
+// current frame's buffers were uploaded, the next frame's buffers are updated instead, which only
+// waits for the draw that used them SCENE_FRAMES draws ago.  Each command draws the number of
+// instances needed for one object (more than one when rendering both eyes with instancing).
+// Non-indexed commands have their base instance in the fourth field.
+SceneFrame* lovrSceneSync(Scene* scene, uint32_t multiplier) {
+  bool indexed = lovrMeshGetIndexCount(scene->mesh) > 0;
+  if ((multiplier != scene->multiplier || indexed != scene->indexed) && scene->count > 0) {
+    markDirty(scene, 0, scene->count);
+  }
+
+  scene->multiplier = multiplier;
+  scene->indexed = indexed;
+
+  SceneFrame* frame = &scene->frames[scene->frame];
+  if (frame->dirtyFrom >= frame->dirtyTo) {
+    return frame;
+  }
+
+  scene->frame = (scene->frame + 1) % SCENE_FRAMES;
+  frame = &scene->frames[scene->frame];
+
+  lovrGpuUnlock(frame->lock);
+  lovrGpuDestroyLock(frame->lock);
+  frame->lock = NULL;
+
+  uint32_t from = frame->dirtyFrom;
+  uint32_t count = frame->dirtyTo - frame->dirtyFrom;
+  upload(frame->instances, scene->instanceData, from * sizeof(SceneInstance), count * sizeof(SceneInstance));
+
+  if (frame->bounds) {
+    upload(frame->bounds, scene->boundsData, from * 4 * sizeof(float), count * 4 * sizeof(float));
+  }
+
+  if (frame->commands) {
+    for (uint32_t i = from; i < frame->dirtyTo; i++) {
+      scene->commandData[i].instances = multiplier;
+      scene->commandData[i].baseVertex = indexed ? 0 : i;
+    }
+
+    upload(frame->commands, scene->commandData, from * sizeof(IndirectCommand), count * sizeof(IndirectCommand));
+  }
+
+  frame->dirtyFrom = ~0u;
+  frame->dirtyTo = 0;
+  return frame;
+}
+
+void lovrSceneLock(Scene* scene) {
+  SceneFrame* frame = &scene->frames[scene->frame];
+  lovrGpuDestroyLock(frame->lock);
+  frame->lock = lovrGpuLock();
+}
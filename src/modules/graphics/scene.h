@@ -0,0 +1,62 @@
+#include "graphics/graphics.h"
+#include "core/util.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+struct Buffer;
+struct Mesh;
+
+// A Scene keeps the transforms, colors, bounds, and draw ranges of many objects that share a Mesh
+// in GPU buffers, so they can all be submitted with one indirect draw.  Object transforms are in
+// world space.  Changes are kept on the CPU and uploaded the next time the Scene is drawn.  The GPU
+// buffers are repeated for a few frames, so changing the Scene every frame doesn't have to wait for
+// the previous draw to finish reading them.
+
+#define SCENE_FRAMES 3
+
+typedef struct {
+  float transform[16];
+  Color color;
+} SceneInstance;
+
+typedef struct {
+  struct Buffer* instances;
+  struct Buffer* bounds;
+  struct Buffer* commands;
+  uint32_t dirtyFrom;
+  uint32_t dirtyTo;
+  void* lock;
+} SceneFrame;
+
+typedef struct Scene {
+  struct Mesh* mesh;
+  SceneFrame frames[SCENE_FRAMES];
+  uint32_t frame;
+  SceneInstance* instanceData;
+  float* boundsData;
+  IndirectCommand* commandData;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t multiplier;
+  bool indexed;
+  bool culling;
+} Scene;
+
+Scene* lovrSceneInit(Scene* scene, struct Mesh* mesh, uint32_t capacity);
+#define lovrSceneCreate(...) lovrSceneInit(lovrAlloc(Scene), __VA_ARGS__)
+void lovrSceneDestroy(void* ref);
+struct Mesh* lovrSceneGetMesh(Scene* scene);
+uint32_t lovrSceneGetCount(Scene* scene);
+uint32_t lovrSceneGetCapacity(Scene* scene);
+uint32_t lovrSceneAdd(Scene* scene, float* transform, Color color, uint32_t start, uint32_t count, float* bounds);
+void lovrSceneClear(Scene* scene);
+void lovrSceneSetTransform(Scene* scene, uint32_t index, float* transform);
+Color lovrSceneGetColor(Scene* scene, uint32_t index);
+void lovrSceneSetColor(Scene* scene, uint32_t index, Color color);
+bool lovrSceneIsCullingEnabled(Scene* scene);
+void lovrSceneSetCullingEnabled(Scene* scene, bool culling);
+bool lovrSceneIsVisible(Scene* scene, uint32_t index, float planes[][4], uint32_t planeCount);
+SceneFrame* lovrSceneSync(Scene* scene, uint32_t multiplier);
+void lovrSceneLock(Scene* scene);
@@ -86,7 +86,6 @@ typedef struct Uniform {
   int baseSlot;
   bool shadow;
   bool image;
-  bool dirty;
 } Uniform;
 
 typedef arr_t(Uniform) arr_uniform_t;
@@ -102,6 +101,38 @@ typedef struct {
 
 typedef arr_t(UniformBlock) arr_block_t;
 
+// Uniforms and blocks can be resolved to a handle once and set using the handle afterwards, which
+// avoids hashing their names every time.  Handles are valid for the lifetime of the Shader.
+typedef uint32_t UniformHandle;
+#define LOVR_UNIFORM_NONE (~0u)
+
+// Uniforms and blocks set by LÖVR, their handles are resolved when the Shader is created
+typedef enum {
+  BUILTIN_VIEWPORT_COUNT,
+  BUILTIN_VIEW_ID,
+  BUILTIN_INSTANCE_STREAM,
+  BUILTIN_POINT_SIZE,
+  BUILTIN_POSE,
+  BUILTIN_SKYBOX_TEXTURE,
+  BUILTIN_MATERIAL_TRANSFORM,
+  BUILTIN_METALNESS,
+  BUILTIN_ROUGHNESS,
+  BUILTIN_DIFFUSE_COLOR,
+  BUILTIN_EMISSIVE_COLOR,
+  BUILTIN_DIFFUSE_TEXTURE,
+  BUILTIN_EMISSIVE_TEXTURE,
+  BUILTIN_METALNESS_TEXTURE,
+  BUILTIN_ROUGHNESS_TEXTURE,
+  BUILTIN_OCCLUSION_TEXTURE,
+  BUILTIN_NORMAL_TEXTURE,
+  BUILTIN_MODEL_BLOCK,
+  BUILTIN_COLOR_BLOCK,
+  BUILTIN_FRAME_BLOCK,
+  MAX_BUILTINS
+} BuiltinUniform;
+
+#define BUILTIN_FIRST_BLOCK BUILTIN_MODEL_BLOCK
+
 // Shader
 
 typedef struct Shader Shader;
@@ -121,6 +152,17 @@ void lovrShaderSetTextures(Shader* shader, const char* name, struct Texture** da
 void lovrShaderSetImages(Shader* shader, const char* name, Image* data, int start, int count);
 void lovrShaderSetColor(Shader* shader, const char* name, Color color);
 void lovrShaderSetBlock(Shader* shader, const char* name, struct Buffer* buffer, size_t offset, size_t size, UniformAccess access);
+UniformHandle lovrShaderGetUniformHandle(Shader* shader, const char* name);
+UniformHandle lovrShaderGetBlockHandle(Shader* shader, const char* name);
+UniformHandle lovrShaderGetBuiltin(Shader* shader, BuiltinUniform builtin);
+const Uniform* lovrShaderGetUniformAt(Shader* shader, UniformHandle handle);
+void lovrShaderSetFloatsAt(Shader* shader, UniformHandle handle, float* data, int start, int count);
+void lovrShaderSetIntsAt(Shader* shader, UniformHandle handle, int* data, int start, int count);
+void lovrShaderSetMatricesAt(Shader* shader, UniformHandle handle, float* data, int start, int count);
+void lovrShaderSetTexturesAt(Shader* shader, UniformHandle handle, struct Texture** data, int start, int count);
+void lovrShaderSetImagesAt(Shader* shader, UniformHandle handle, Image* data, int start, int count);
+void lovrShaderSetColorAt(Shader* shader, UniformHandle handle, Color color);
+void lovrShaderSetBlockAt(Shader* shader, UniformHandle handle, struct Buffer* buffer, size_t offset, size_t size, UniformAccess access);
 
 // ShaderBlock
 
@@ -20,6 +20,8 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 void lovrTextureDestroy(void* ref);
 void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint32_t depth, TextureFormat format);
 void lovrTextureReplacePixels(Texture* texture, struct TextureData* data, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap);
+void lovrTextureStream(Texture* texture, struct TextureData** slices, uint32_t sliceCount);
+bool lovrTextureIsStreaming(Texture* texture);
 uint64_t lovrTextureGetId(Texture* texture);
 uint32_t lovrTextureGetWidth(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetHeight(Texture* texture, uint32_t mipmap);
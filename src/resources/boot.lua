@@ -111,7 +111,8 @@ function lovr.boot()
       msaa = 0,
       title = 'LÖVR',
       icon = nil,
-      vsync = 1
+      vsync = 1,
+      stereo = 'auto'
     }
   }
 
@@ -3,10 +3,13 @@
 const char* lovrShaderVertexPrefix = ""
 "#define VERTEX VERTEX \n"
 "#define MAX_BONES 48 \n"
-"#define MAX_DRAWS 256 \n"
 "#define lovrView lovrViews[lovrViewID] \n"
 "#define lovrProjection lovrProjections[lovrViewID] \n"
+"#ifdef FLAG_instanceStream \n"
+"#define lovrModel (lovrInstanceStream != 0 ? lovrInstanceTransform : lovrModels[lovrDrawID]) \n"
+"#else \n"
 "#define lovrModel lovrModels[lovrDrawID] \n"
+"#endif \n"
 "#define lovrTransform (lovrView * lovrModel) \n"
 "#ifdef FLAG_uniformScale \n"
 "#define lovrNormalMatrix mat3(lovrModel) \n"
@@ -35,7 +38,17 @@ const char* lovrShaderVertexPrefix = ""
 "in uvec4 lovrBones; \n"
 "in vec4 lovrBoneWeights; \n"
 "in uint lovrDrawID; \n"
+"#ifdef FLAG_instanceStream \n"
+"in mat4 lovrInstanceTransform; \n"
+"in vec4 lovrInstanceColor; \n"
+"uniform lowp int lovrInstanceStream; \n"
+"#endif \n"
+"#ifdef FLAG_textureArrays \n"
+"in float lovrMaterialLayer; \n"
+"out vec3 texCoord; \n"
+"#else \n"
 "out vec2 texCoord; \n"
+"#endif \n"
 "out vec4 vertexColor; \n"
 "out vec4 lovrGraphicsColor; \n"
 "layout(std140) uniform lovrModelBlock { mat4 lovrModels[MAX_DRAWS]; }; \n"
@@ -57,9 +70,17 @@ const char* lovrShaderVertexPrefix = ""
 
 const char* lovrShaderVertexSuffix = ""
 "void main() { \n"
+"#ifdef FLAG_textureArrays \n"
+"  texCoord = vec3((lovrMaterialTransform * vec3(lovrTexCoord, 1.)).xy, lovrMaterialLayer); \n"
+"#else \n"
 "  texCoord = (lovrMaterialTransform * vec3(lovrTexCoord, 1.)).xy; \n"
+"#endif \n"
 "  vertexColor = lovrVertexColor; \n"
+"#ifdef FLAG_instanceStream \n"
+"  lovrGraphicsColor = lovrInstanceStream != 0 ? lovrInstanceColor : lovrColors[lovrDrawID]; \n"
+"#else \n"
 "  lovrGraphicsColor = lovrColors[lovrDrawID]; \n"
+"#endif \n"
 "#if defined INSTANCED_STEREO \n"
 "  gl_ViewportIndex = gl_InstanceID % lovrViewportCount; \n"
 "#endif \n"
@@ -79,7 +100,14 @@ const char* lovrShaderFragmentPrefix = ""
 "precision mediump float; \n"
 "precision mediump int; \n"
 "#endif \n"
-"in vec2 texCoord; \n"
+"#ifdef FLAG_textureArrays \n"
+"#define lovrMaterialSampler sampler2DArray \n"
+"#define lovrMaterialCoord vec3 \n"
+"#else \n"
+"#define lovrMaterialSampler sampler2D \n"
+"#define lovrMaterialCoord vec2 \n"
+"#endif \n"
+"in lovrMaterialCoord texCoord; \n"
 "in vec4 vertexColor; \n"
 "in vec4 lovrGraphicsColor; \n"
 "out vec4 lovrCanvas[gl_MaxDrawBuffers]; \n"
@@ -87,12 +115,12 @@ const char* lovrShaderFragmentPrefix = ""
 "uniform float lovrRoughness; \n"
 "uniform vec4 lovrDiffuseColor; \n"
 "uniform vec4 lovrEmissiveColor; \n"
-"uniform sampler2D lovrDiffuseTexture; \n"
-"uniform sampler2D lovrEmissiveTexture; \n"
-"uniform sampler2D lovrMetalnessTexture; \n"
-"uniform sampler2D lovrRoughnessTexture; \n"
-"uniform sampler2D lovrOcclusionTexture; \n"
-"uniform sampler2D lovrNormalTexture; \n"
+"uniform lovrMaterialSampler lovrDiffuseTexture; \n"
+"uniform lovrMaterialSampler lovrEmissiveTexture; \n"
+"uniform lovrMaterialSampler lovrMetalnessTexture; \n"
+"uniform lovrMaterialSampler lovrRoughnessTexture; \n"
+"uniform lovrMaterialSampler lovrOcclusionTexture; \n"
+"uniform lovrMaterialSampler lovrNormalTexture; \n"
 "uniform lowp int lovrViewportCount; \n"
 "#if defined MULTIVIEW \n"
 "#define lovrViewID gl_ViewID_OVR \n"
@@ -153,7 +181,7 @@ const char* lovrUnlitVertexShader = ""
 "}";
 
 const char* lovrUnlitFragmentShader = ""
-"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"vec4 color(vec4 graphicsColor, lovrMaterialSampler image, lovrMaterialCoord uv) { \n"
 "  return lovrGraphicsColor * lovrVertexColor * lovrDiffuseColor * texture(lovrDiffuseTexture, lovrTexCoord); \n"
 "}";
 
@@ -209,7 +237,7 @@ const char* lovrStandardFragmentShader = ""
 "vec2 prefilteredBRDF(float NoV, float roughness); \n"
 "vec3 tonemap_ACES(vec3 color); \n"
 
-"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"vec4 color(vec4 graphicsColor, lovrMaterialSampler image, lovrMaterialCoord uv) { \n"
 "  vec3 result = vec3(0.); \n"
 
 // Parameters
@@ -360,23 +388,58 @@ const char* lovrFillVertexShader = ""
 "  return lovrVertex; \n"
 "}";
 
-const char* lovrShaderScalarUniforms[] = {
-  "lovrMetalness",
-  "lovrRoughness"
-};
+const char* lovrSceneCullShader = ""
+"layout(local_size_x = 64) in; \n"
+"struct SceneInstance { mat4 transform; vec4 color; }; \n"
+"layout(std430) readonly buffer lovrSceneInstances { SceneInstance instances[]; }; \n"
+"layout(std430) readonly buffer lovrSceneBounds { vec4 bounds[]; }; \n"
+"layout(std430) buffer lovrSceneCommands { uint commands[]; }; \n"
+"uniform vec4 lovrScenePlanes[12]; \n"
+"uniform int lovrScenePlaneCount; \n"
+"uniform int lovrSceneCount; \n"
+"uniform int lovrSceneMultiplier; \n"
+"void compute() { \n"
+"  int i = int(gl_GlobalInvocationID.x); \n"
+"  if (i >= lovrSceneCount) return; \n"
+"  vec4 sphere = bounds[i]; \n"
+"  bool visible = sphere.w < 0.; \n"
+"  if (!visible) { \n"
+"    mat4 m = instances[i].transform; \n"
+"    vec3 center = (m * vec4(sphere.xyz, 1.)).xyz; \n"
+"    float scale = max(max(dot(m[0].xyz, m[0].xyz), dot(m[1].xyz, m[1].xyz)), dot(m[2].xyz, m[2].xyz)); \n"
+"    float radius = sphere.w * sqrt(scale); \n"
+"    for (int v = 0; v < lovrScenePlaneCount && !visible; v += 6) { \n"
+"      bool inside = true; \n"
+"      for (int p = v; p < v + 6; p++) { \n"
+"        inside = inside && dot(lovrScenePlanes[p].xyz, center) + lovrScenePlanes[p].w >= -radius; \n"
+"      } \n"
+"      visible = inside; \n"
+"    } \n"
+"  } \n"
+"  commands[5 * i + 1] = visible ? uint(lovrSceneMultiplier) : 0u; \n"
+"}";
 
-const char* lovrShaderColorUniforms[] = {
+const char* lovrShaderBuiltinUniforms[] = {
+  "lovrViewportCount",
+  "lovrViewID",
+  "lovrInstanceStream",
+  "lovrPointSize",
+  "lovrPose",
+  "lovrSkyboxTexture",
+  "lovrMaterialTransform",
+  "lovrMetalness",
+  "lovrRoughness",
   "lovrDiffuseColor",
-  "lovrEmissiveColor"
-};
-
-const char* lovrShaderTextureUniforms[] = {
+  "lovrEmissiveColor",
   "lovrDiffuseTexture",
   "lovrEmissiveTexture",
   "lovrMetalnessTexture",
   "lovrRoughnessTexture",
   "lovrOcclusionTexture",
-  "lovrNormalTexture"
+  "lovrNormalTexture",
+  "lovrModelBlock",
+  "lovrColorBlock",
+  "lovrFrameBlock"
 };
 
 const char* lovrShaderAttributeNames[] = {
@@ -15,8 +15,7 @@ extern const char* lovrCubeFragmentShader;
 extern const char* lovrPanoFragmentShader;
 extern const char* lovrFontFragmentShader;
 extern const char* lovrFillVertexShader;
+extern const char* lovrSceneCullShader;
 
-extern const char* lovrShaderScalarUniforms[];
-extern const char* lovrShaderColorUniforms[];
-extern const char* lovrShaderTextureUniforms[];
+extern const char* lovrShaderBuiltinUniforms[];
 extern const char* lovrShaderAttributeNames[];